@@ -0,0 +1,110 @@
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmark.h"
+#include "vv/GLStateCache.h"
+
+namespace vv
+{
+  static GLFWwindow *context_window = nullptr;
+
+  /////////////////////////////////////////////////////////////////////// public
+  BenchmarkTimings::BenchmarkTimings(std::string label) :
+    label_(label)
+  {
+  }
+
+
+  void BenchmarkTimings::add(double time)
+  {
+    times_.push_back(time);
+  }
+
+
+  void BenchmarkTimings::clear()
+  {
+    times_.clear();
+  }
+
+
+  double BenchmarkTimings::getMedian() const
+  {
+    if (times_.empty()) return 0.0;
+
+    std::vector<double> sorted(times_);
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[sorted.size() / 2];
+  }
+
+
+  void BenchmarkTimings::report() const
+  {
+    if (times_.empty())
+    {
+      std::cout << "  " << label_ << ": no samples\n";
+      return;
+    }
+
+    double total = 0.0;
+    for (auto time : times_)
+      total += time;
+
+    std::cout << "  " << label_ << ": median " << getMedian() << " ms, mean " << total / times_.size()
+              << " ms, min " << *std::min_element(times_.begin(), times_.end())
+              << " ms, max " << *std::max_element(times_.begin(), times_.end()) << " ms ("
+              << times_.size() << " samples)\n";
+  }
+
+
+  size_t benchmarkArgument(const std::vector<std::string> &arguments, size_t index, size_t fallback)
+  {
+    if (index >= arguments.size()) return fallback;
+
+    long value = std::strtol(arguments[index].c_str(), nullptr, 10);
+    return (value > 0) ? (size_t)value : fallback;
+  }
+
+
+  bool createBenchmarkContext(int major, int minor)
+  {
+    if (context_window) return true;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+    context_window = glfwCreateWindow(64, 64, "Virtual Vista Benchmark", nullptr, nullptr);
+    if (!context_window)
+    {
+      std::cerr << "ERROR: Could not create a " << major << "." << minor << " context.\n";
+      return false;
+    }
+
+    glfwMakeContextCurrent(context_window);
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+    {
+      std::cerr << "ERROR: Failed to initialize OpenGL context.\n";
+      destroyBenchmarkContext();
+      return false;
+    }
+
+    GLStateCache::instance()->invalidate();
+    return true;
+  }
+
+
+  void destroyBenchmarkContext()
+  {
+    if (!context_window) return;
+
+    glfwDestroyWindow(context_window);
+    context_window = nullptr;
+  }
+} // namespace vv
\ No newline at end of file
@@ -0,0 +1,52 @@
+
+#ifndef VIRTUALVISTA_BENCHMARK_H
+#define VIRTUALVISTA_BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+namespace vv
+{
+  /* Gets the arguments following the benchmark name, false if it could not run */
+  typedef bool (*BenchmarkFunction)(const std::vector<std::string> &arguments);
+
+  struct Benchmark
+  {
+    const char *name;
+    const char *usage;
+    BenchmarkFunction function;
+  };
+
+  /* Collects one time per iteration, in milliseconds */
+  class BenchmarkTimings
+  {
+  public:
+    BenchmarkTimings(std::string label);
+
+    void add(double time);
+    void clear();
+    double getMedian() const;
+
+    /* Median, mean, min and max on one line */
+    void report() const;
+
+  private:
+    std::string label_;
+    std::vector<double> times_;
+  };
+
+  /* Numeric argument at index, fallback when it is missing or not a positive number */
+  size_t benchmarkArgument(const std::vector<std::string> &arguments, size_t index, size_t fallback);
+
+  /* Hidden window with a core profile context current on the calling thread */
+  bool createBenchmarkContext(int major, int minor);
+  void destroyBenchmarkContext();
+
+  bool benchmarkSkinning(const std::vector<std::string> &arguments);
+  bool benchmarkParticles(const std::vector<std::string> &arguments);
+  bool benchmarkSpatialQueries(const std::vector<std::string> &arguments);
+  bool benchmarkObjImport(const std::vector<std::string> &arguments);
+  bool benchmarkIndirect(const std::vector<std::string> &arguments);
+}
+
+#endif // VIRTUALVISTA_BENCHMARK_H
\ No newline at end of file
@@ -0,0 +1,278 @@
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Benchmark.h"
+#include "vv/Frustum.h"
+#include "vv/GLRenderBackend.h"
+#include "vv/GLStateCache.h"
+#include "vv/IndirectRenderer.h"
+#include "vv/RenderQueue.h"
+#include "vv/Settings.h"
+#include "vv/ShaderVariantCache.h"
+#include "vv/ThreadPool.h"
+#include "vv/Time.h"
+#include "vv/VirtualVista.h"
+
+namespace vv
+{
+  static const GLuint BOX_INDICES = 36;
+  static const float WORLD_EXTENT = 200.0f;
+  static const float FAR_CLIP = 4.0f * WORLD_EXTENT;
+
+  /* Away from unit 0, where the fragment shader's 2d samplers sit by default. Two sampler
+     types on one unit fail every draw. */
+  static const GLuint TRANSFORM_UNIT = 8;
+
+  /* Every mesh is a box of its own size, all of them share one vertex array */
+  struct BenchmarkGeometry
+  {
+    GLuint vao;
+    GLuint vertex_buffer;
+    GLuint index_buffer;
+    std::vector<glm::vec3> half_sizes;
+  };
+
+
+  static void createGeometry(BenchmarkGeometry &geometry, size_t mesh_count)
+  {
+    std::vector<float> vertices;
+    std::vector<GLuint> indices;
+    static const GLuint FACES[BOX_INDICES] =
+    {
+      0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+      2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5
+    };
+
+    for (size_t mesh = 0; mesh < mesh_count; ++mesh)
+    {
+      glm::vec3 half_size(0.5f + 0.1f * (mesh % 4), 0.5f + 0.1f * (mesh % 3), 0.5f + 0.1f * (mesh % 5));
+      geometry.half_sizes.push_back(half_size);
+
+      // indices stay absolute so both paths draw with a base vertex of zero
+      GLuint base = (GLuint)(vertices.size() / 8);
+      for (int corner = 0; corner < 8; ++corner)
+      {
+        glm::vec3 direction((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+        glm::vec3 position = direction * half_size;
+        glm::vec3 normal = direction * 0.57735f;
+        float vertex[8] = { position.x, position.y, position.z, normal.x, normal.y, normal.z,
+                            (corner & 1) ? 1.0f : 0.0f, (corner & 2) ? 1.0f : 0.0f };
+        vertices.insert(vertices.end(), vertex, vertex + 8);
+      }
+
+      for (GLuint i = 0; i < BOX_INDICES; ++i)
+        indices.push_back(base + FACES[i]);
+    }
+
+    GLStateCache *cache = GLStateCache::instance();
+    glGenVertexArrays(1, &geometry.vao);
+    glGenBuffers(1, &geometry.vertex_buffer);
+    glGenBuffers(1, &geometry.index_buffer);
+
+    cache->bindVertexArray(geometry.vao);
+    cache->bindBuffer(GL_ARRAY_BUFFER, geometry.vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+    for (GLuint attribute = 0; attribute < 3; ++attribute)
+      glEnableVertexAttribArray(attribute);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (GLvoid *)0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (GLvoid *)(3 * sizeof(float)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (GLvoid *)(6 * sizeof(float)));
+    cache->bindVertexArray(0);
+  }
+
+
+  static void destroyGeometry(BenchmarkGeometry &geometry)
+  {
+    GLStateCache *cache = GLStateCache::instance();
+    cache->onDeleteVertexArray(geometry.vao);
+    cache->onDeleteBuffer(geometry.vertex_buffer);
+    cache->onDeleteBuffer(geometry.index_buffer);
+    glDeleteVertexArrays(1, &geometry.vao);
+    glDeleteBuffers(1, &geometry.vertex_buffer);
+    glDeleteBuffers(1, &geometry.index_buffer);
+  }
+
+
+  /////////////////////////////////////////////////////////////////////// public
+  bool benchmarkIndirect(const std::vector<std::string> &arguments)
+  {
+    size_t instance_count = benchmarkArgument(arguments, 0, 100000);
+    size_t frames = benchmarkArgument(arguments, 1, 100);
+    size_t mesh_count = std::min(benchmarkArgument(arguments, 2, 16), (size_t)0xffff);
+
+    // without 4.3 only the render queue half can run
+    bool indirect = createBenchmarkContext(4, 3) && IndirectRenderer::isSupported();
+    if (!indirect && !createBenchmarkContext(3, 3))
+      return false;
+
+    ShaderVariantCache lighting(Settings::instance()->getShaderLocation(), "lighting");
+    Shader *queue_shader = lighting.init() ? lighting.getVariant(ShaderVariantCache::makeKey(1, 0)) : nullptr;
+    Shader *indirect_shader = indirect ? lighting.getVariant(ShaderVariantCache::makeKey(1, SHADER_FEATURE_INDIRECT)) : nullptr;
+    if (!queue_shader)
+    {
+      std::cerr << "ERROR: The lighting shader did not build.\n";
+      return false;
+    }
+
+    BenchmarkGeometry geometry;
+    createGeometry(geometry, mesh_count);
+
+    GLRenderBackend backend;
+    uint32_t queue_shader_id = backend.registerShader(queue_shader);
+    uint32_t model_uniform = backend.registerUniform("model");
+    uint32_t view_uniform = backend.registerUniform("view");
+    uint32_t projection_uniform = backend.registerUniform("projection");
+    std::vector<uint32_t> queue_meshes(mesh_count);
+    for (size_t mesh = 0; mesh < mesh_count; ++mesh)
+      queue_meshes[mesh] = backend.registerMesh(geometry.vao, BOX_INDICES);
+
+    IndirectRenderer *indirect_renderer = nullptr;
+    if (indirect && indirect_shader)
+    {
+      indirect_renderer = new IndirectRenderer;
+      if (!indirect_renderer->init())
+        SAFE_DELETE(indirect_renderer);
+    }
+
+    std::vector<uint32_t> indirect_meshes(mesh_count);
+    if (indirect_renderer)
+    {
+      for (size_t mesh = 0; mesh < mesh_count; ++mesh)
+        indirect_meshes[mesh] = indirect_renderer->registerMesh(geometry.vao, (GLuint)(mesh * BOX_INDICES), BOX_INDICES);
+    }
+
+    // a fixed random field of boxes, the camera sees part of it
+    uint32_t random_state = 0x9e3779b9u;
+    std::vector<glm::mat4> models(instance_count);
+    std::vector<AABB> bounds(instance_count);
+    std::vector<uint32_t> kinds(instance_count);
+    for (size_t i = 0; i < instance_count; ++i)
+    {
+      glm::vec3 position;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        position[axis] = WORLD_EXTENT * (2.0f * (random_state >> 8) / 16777216.0f - 1.0f);
+      }
+
+      kinds[i] = (uint32_t)(i % mesh_count);
+      models[i] = glm::translate(glm::mat4(1.0f), position);
+      bounds[i] = AABB(position - geometry.half_sizes[kinds[i]], position + geometry.half_sizes[kinds[i]]);
+
+      if (indirect_renderer)
+        indirect_renderer->addInstance(indirect_meshes[kinds[i]], models[i], bounds[i]);
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, WORLD_EXTENT), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, FAR_CLIP);
+    glm::mat4 view_projection = projection * view;
+
+    std::cout << "  " << instance_count << " instances of " << mesh_count << " meshes, " << frames << " frames, "
+              << ThreadPool::instance()->getWorkerCount() << " workers"
+              << (indirect_renderer ? "" : ", no 4.3 context so the indirect path is skipped") << "\n";
+
+    glEnable(GL_DEPTH_TEST);
+
+    // cpu frustum culling, recording, sorting and submitting one draw per visible instance
+    RenderQueue queue(ThreadPool::instance()->getWorkerCount() + 1);
+    BenchmarkTimings queue_cpu_timings("render queue cpu");
+    BenchmarkTimings queue_frame_timings("render queue frame");
+    size_t visible = 0;
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+      double start_time = Time::current();
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+      Frustum frustum(view_projection);
+      const size_t buffer_count = queue.getBufferCount();
+      const size_t slice = (instance_count + buffer_count - 1) / buffer_count;
+      ThreadPool::instance()->parallelFor(buffer_count, 1, [&](size_t begin, size_t end)
+      {
+        for (size_t b = begin; b < end; ++b)
+        {
+          CommandBuffer &buffer = queue.getBuffer(b);
+          if (b == 0)
+          {
+            // the lowest key this shader can have, so these run before any of its draws
+            SortKey frame_key = makeSortKey(PASS_OPAQUE, queue_shader_id, 0, 0, 0.0f);
+            buffer.bindMaterial(frame_key, queue_shader_id, 0);
+            buffer.setUniform(frame_key, view_uniform, view);
+            buffer.setUniform(frame_key, projection_uniform, projection);
+          }
+
+          size_t last = std::min(instance_count, (b + 1) * slice);
+          for (size_t i = b * slice; i < last; ++i)
+          {
+            if (!frustum.intersects(bounds[i])) continue;
+
+            glm::vec4 view_position = view * models[i][3];
+            SortKey key = makeSortKey(PASS_OPAQUE, queue_shader_id, 0, queue_meshes[kinds[i]],
+                                      -view_position.z / FAR_CLIP);
+            buffer.setUniform(key, model_uniform, models[i]);
+            buffer.draw(key, queue_meshes[kinds[i]], 1, kinds[i] * BOX_INDICES, BOX_INDICES);
+          }
+        }
+      });
+
+      queue.sort();
+      queue.submit(backend);
+      visible = queue.getStats().draws;
+      queue.reset();
+
+      queue_cpu_timings.add(Time::current() - start_time);
+      glFinish();
+      queue_frame_timings.add(Time::current() - start_time);
+    }
+
+    std::cout << "  " << visible << " instances survive the frustum\n";
+    queue_cpu_timings.report();
+    queue_frame_timings.report();
+
+    if (indirect_renderer)
+    {
+      GLint view_location = indirect_shader->getUniformLocation("view");
+      GLint projection_location = indirect_shader->getUniformLocation("projection");
+      GLint transforms_location = indirect_shader->getUniformLocation("instance_transforms");
+
+      BenchmarkTimings indirect_cpu_timings("indirect cpu");
+      BenchmarkTimings indirect_frame_timings("indirect frame");
+      for (size_t frame = 0; frame < frames; ++frame)
+      {
+        double start_time = Time::current();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        indirect_renderer->cull(view_projection);
+        indirect_shader->useProgram();
+        glUniformMatrix4fv(view_location, 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(projection_location, 1, GL_FALSE, glm::value_ptr(projection));
+        glUniform1i(transforms_location, TRANSFORM_UNIT);
+        indirect_renderer->bindTransforms(TRANSFORM_UNIT);
+        indirect_renderer->draw();
+
+        indirect_cpu_timings.add(Time::current() - start_time);
+        glFinish();
+        indirect_frame_timings.add(Time::current() - start_time);
+      }
+
+      indirect_cpu_timings.report();
+      indirect_frame_timings.report();
+      std::cout << "  " << indirect_renderer->getStats().batches << " multi draw calls per frame, "
+                << queue_cpu_timings.getMedian() / std::max(indirect_cpu_timings.getMedian(), 1e-6)
+                << "x less cpu time than the render queue\n";
+    }
+
+    SAFE_DELETE(indirect_renderer);
+    destroyGeometry(geometry);
+    return true;
+  }
+} // namespace vv
\ No newline at end of file
@@ -0,0 +1,87 @@
+
+#include <algorithm>
+#include <iostream>
+
+#include "Benchmark.h"
+#include "vv/Mesh.h"
+#include "vv/ObjLoader.h"
+#include "vv/Settings.h"
+#include "vv/Time.h"
+#include "vv/VirtualVista.h"
+
+namespace vv
+{
+  /////////////////////////////////////////////////////////////////////// public
+  bool benchmarkObjImport(const std::vector<std::string> &arguments)
+  {
+    if (arguments.empty())
+    {
+      std::cerr << "ERROR: The obj benchmark needs a file to import.\n";
+      return false;
+    }
+
+    size_t split = arguments[0].find_last_of("/\\") + 1;
+    std::string path = arguments[0].substr(0, split);
+    std::string name = arguments[0].substr(split);
+    size_t iterations = benchmarkArgument(arguments, 1, 5);
+
+    // the obj loader is called directly so a fallback to assimp can't hide in its timings
+    bool fast_obj_import = Settings::instance()->getFastObjImport();
+    Settings::instance()->setFastObjImport(false);
+
+    BenchmarkTimings assimp_timings("assimp");
+    BenchmarkTimings obj_timings("obj loader");
+    BenchmarkTimings parse_timings("obj loader parse");
+    BenchmarkTimings build_timings("obj loader build");
+    size_t assimp_vertices = 0, assimp_indices = 0, obj_vertices = 0, obj_indices = 0;
+    bool success = true;
+
+    for (size_t iteration = 0; iteration < iterations && success; ++iteration)
+    {
+      Mesh *assimp_mesh = new Mesh(path, name);
+      double start_time = Time::current();
+      success = assimp_mesh->init();
+      assimp_timings.add(Time::current() - start_time);
+      assimp_vertices = assimp_mesh->getVertexCount();
+      assimp_indices = assimp_mesh->getIndexCount();
+      SAFE_DELETE(assimp_mesh);
+
+      if (!success)
+      {
+        std::cerr << "ERROR: Assimp could not import " << arguments[0] << "\n";
+        break;
+      }
+
+      Mesh *obj_mesh = new Mesh(path, name);
+      ObjLoader loader;
+      start_time = Time::current();
+      success = loader.load(path, name, *obj_mesh);
+      obj_timings.add(Time::current() - start_time);
+      parse_timings.add(loader.getStats().parse_time);
+      build_timings.add(loader.getStats().build_time);
+      obj_vertices = obj_mesh->getVertexCount();
+      obj_indices = obj_mesh->getIndexCount();
+      SAFE_DELETE(obj_mesh);
+
+      if (!success)
+        std::cerr << "ERROR: The obj loader could not import " << arguments[0] << "\n";
+    }
+
+    Settings::instance()->setFastObjImport(fast_obj_import);
+    if (!success) return false;
+
+    std::cout << "  " << arguments[0] << ", " << iterations << " iterations\n";
+    std::cout << "  assimp: " << assimp_vertices << " vertices, " << assimp_indices / 3 << " triangles\n";
+    std::cout << "  obj loader: " << obj_vertices << " vertices, " << obj_indices / 3 << " triangles\n";
+
+    assimp_timings.report();
+    obj_timings.report();
+    parse_timings.report();
+    build_timings.report();
+
+    std::cout << "  obj loader is " << assimp_timings.getMedian() / std::max(obj_timings.getMedian(), 1e-6)
+              << "x assimp\n";
+
+    return true;
+  }
+} // namespace vv
\ No newline at end of file
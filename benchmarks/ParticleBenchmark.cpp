@@ -0,0 +1,80 @@
+
+#include <algorithm>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmark.h"
+#include "vv/ParticleSystem.h"
+#include "vv/ThreadPool.h"
+
+namespace vv
+{
+  static const float FRAME_TIME = 1.0f / 60.0f;
+  static const float LIFETIME_MIN = 2.0f;
+  static const float LIFETIME_MAX = 4.0f;
+
+  /////////////////////////////////////////////////////////////////////// public
+  bool benchmarkParticles(const std::vector<std::string> &arguments)
+  {
+    size_t particles = benchmarkArgument(arguments, 0, 1000000);
+    size_t frames = benchmarkArgument(arguments, 1, 300);
+    size_t emitter_count = std::min(benchmarkArgument(arguments, 2, 16), particles);
+
+    // the stream upload and draw need a context, the simulation does not
+    bool render = createBenchmarkContext(3, 3);
+
+    ParticleSystem particle_system;
+    if (render && !particle_system.init())
+      render = false;
+
+    // every emitter starts full and respawns what dies, so the count stays near capacity
+    for (size_t i = 0; i < emitter_count; ++i)
+    {
+      EmitterSettings settings;
+      settings.capacity = particles / emitter_count + (i < particles % emitter_count ? 1 : 0);
+      settings.lifetime_min = LIFETIME_MIN;
+      settings.lifetime_max = LIFETIME_MAX;
+      settings.emission_rate = 2.0f * settings.capacity / (LIFETIME_MIN + LIFETIME_MAX);
+      settings.spawn_extent = glm::vec3(1.0f);
+
+      ParticleEmitter *emitter = particle_system.createEmitter(settings);
+      emitter->setPosition(glm::vec3((float)i * 4.0f, 0.0f, -20.0f));
+      emitter->emit(settings.capacity);
+    }
+
+    std::cout << "  " << particles << " particles in " << emitter_count << " emitters, " << frames << " frames, "
+              << ThreadPool::instance()->getWorkerCount() << " workers"
+              << (render ? "" : ", upload and draw skipped") << "\n";
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+
+    BenchmarkTimings simulate_timings("simulate");
+    BenchmarkTimings upload_timings("stream upload");
+    size_t live = 0;
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+      particle_system.update(FRAME_TIME);
+      simulate_timings.add(particle_system.getStats().simulate_time);
+      live += particle_system.getStats().particles;
+
+      if (render)
+      {
+        particle_system.render(view, projection);
+        upload_timings.add(particle_system.getStats().upload_time);
+      }
+    }
+
+    if (render) glFinish();
+
+    simulate_timings.report();
+    if (render) upload_timings.report();
+
+    double particles_per_ms = (double)live / frames / std::max(simulate_timings.getMedian(), 1e-6);
+    std::cout << "  " << live / std::max(frames, (size_t)1) << " live particles on average, "
+              << (size_t)particles_per_ms << " simulated per millisecond\n";
+
+    return true;
+  }
+} // namespace vv
\ No newline at end of file
@@ -0,0 +1,147 @@
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "Benchmark.h"
+#include "vv/AnimationSystem.h"
+#include "vv/Mesh.h"
+#include "vv/Time.h"
+#include "vv/VirtualVista.h"
+
+namespace vv
+{
+  /* Roughly a game character: spine, limbs and fingers */
+  static const size_t SYNTHETIC_JOINTS = 64;
+  static const size_t SYNTHETIC_KEYS = 31;
+  static const float SYNTHETIC_DURATION = 2.0f;
+  static const float FRAME_TIME = 1.0f / 60.0f;
+
+  static void buildSkeleton(Skeleton &skeleton)
+  {
+    skeleton.bind_pose.resize(SYNTHETIC_JOINTS);
+    skeleton.global_inverse = glm::mat4(1.0f);
+
+    // parents come first, so a binary tree in joint order is a valid hierarchy
+    for (size_t joint = 0; joint < SYNTHETIC_JOINTS; ++joint)
+    {
+      skeleton.joint_names.push_back("joint" + std::to_string(joint));
+      skeleton.parents.push_back(joint ? (int)(joint - 1) / 2 : -1);
+      skeleton.bind_pose.translations[joint] = glm::vec3(0.0f, joint ? 0.1f : 0.0f, 0.0f);
+      skeleton.bind_pose.rotations[joint] = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+      skeleton.bind_pose.scales[joint] = glm::vec3(1.0f);
+      skeleton.bone_joints.push_back((int)joint);
+      skeleton.inverse_bind.push_back(glm::mat4(1.0f));
+    }
+  }
+
+
+  static AnimationClip* buildClip(std::string name, float frequency, const glm::vec3 &axis)
+  {
+    AnimationClip *clip = new AnimationClip(name, SYNTHETIC_DURATION, SYNTHETIC_JOINTS);
+
+    std::vector<float> times(SYNTHETIC_KEYS);
+    std::vector<glm::quat> rotations(SYNTHETIC_KEYS);
+    for (size_t joint = 0; joint < SYNTHETIC_JOINTS; ++joint)
+    {
+      for (size_t key = 0; key < SYNTHETIC_KEYS; ++key)
+      {
+        times[key] = SYNTHETIC_DURATION * key / (SYNTHETIC_KEYS - 1);
+        float angle = 0.3f * std::sin(frequency * times[key] + joint * 0.5f);
+        rotations[key] = glm::angleAxis(angle, axis);
+      }
+      clip->setRotationKeys(joint, times.data(), rotations.data(), SYNTHETIC_KEYS);
+    }
+
+    float translation_times[] = { 0.0f, SYNTHETIC_DURATION };
+    glm::vec3 translations[] = { glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+    clip->setTranslationKeys(0, translation_times, translations, 2);
+
+    return clip;
+  }
+
+
+  /////////////////////////////////////////////////////////////////////// public
+  bool benchmarkSkinning(const std::vector<std::string> &arguments)
+  {
+    size_t characters = benchmarkArgument(arguments, 0, 1000);
+    size_t frames = benchmarkArgument(arguments, 1, 300);
+
+    Skeleton synthetic_skeleton;
+    const Skeleton *skeleton = &synthetic_skeleton;
+    const AnimationClip *base_clip = nullptr, *blend_clip = nullptr;
+    AnimationClip *synthetic_clips[2] = { nullptr, nullptr };
+    Mesh *mesh = nullptr;
+
+    if (arguments.size() > 2)
+    {
+      size_t split = arguments[2].find_last_of("/\\") + 1;
+      mesh = new Mesh(arguments[2].substr(0, split), arguments[2].substr(split));
+      if (!mesh->init() || !mesh->getSkeleton() || mesh->getAnimationCount() == 0)
+      {
+        std::cerr << "ERROR: " << arguments[2] << " has no skeleton or animations to benchmark.\n";
+        SAFE_DELETE(mesh);
+        return false;
+      }
+
+      skeleton = mesh->getSkeleton();
+      base_clip = mesh->getAnimation(0);
+      blend_clip = mesh->getAnimation(mesh->getAnimationCount() - 1);
+    }
+    else
+    {
+      buildSkeleton(synthetic_skeleton);
+      synthetic_clips[0] = buildClip("walk", 6.0f, glm::vec3(1.0f, 0.0f, 0.0f));
+      synthetic_clips[1] = buildClip("wave", 9.0f, glm::vec3(0.0f, 0.0f, 1.0f));
+      base_clip = synthetic_clips[0];
+      blend_clip = synthetic_clips[1];
+    }
+
+    // the palette upload needs a context, sampling and blending does not
+    bool upload = createBenchmarkContext(3, 3);
+
+    AnimationSystem animation;
+    if (upload && !animation.init())
+      upload = false;
+
+    // two layers per character so blending is part of the cost
+    for (size_t i = 0; i < characters; ++i)
+    {
+      size_t instance = animation.createInstance(skeleton);
+      animation.play(instance, 0, base_clip, 1.0f, true, 0.8f + 0.4f * (i % 16) / 16.0f);
+      animation.play(instance, 1, blend_clip, 0.5f);
+    }
+
+    std::cout << "  " << characters << " characters, " << skeleton->getBoneCount() << " bones each, "
+              << frames << " frames" << (upload ? "" : ", palette upload skipped") << "\n";
+
+    BenchmarkTimings sample_timings("sample and blend");
+    BenchmarkTimings upload_timings("palette upload");
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+      animation.update(FRAME_TIME);
+      sample_timings.add(animation.getStats().sample_time);
+
+      if (upload)
+      {
+        animation.upload();
+        upload_timings.add(animation.getStats().upload_time);
+      }
+    }
+
+    if (upload) glFinish();
+
+    sample_timings.report();
+    if (upload) upload_timings.report();
+
+    double bones_per_ms = characters * skeleton->getBoneCount() / std::max(sample_timings.getMedian(), 1e-6);
+    std::cout << "  " << (size_t)bones_per_ms << " bones per millisecond\n";
+
+    SAFE_DELETE(synthetic_clips[0]);
+    SAFE_DELETE(synthetic_clips[1]);
+    SAFE_DELETE(mesh);
+    return true;
+  }
+} // namespace vv
\ No newline at end of file
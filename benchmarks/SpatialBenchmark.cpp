@@ -0,0 +1,206 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+#include <glm/geometric.hpp>
+
+#include "Benchmark.h"
+#include "vv/AABBTree.h"
+#include "vv/ThreadPool.h"
+#include "vv/Time.h"
+
+namespace vv
+{
+  static const float WORLD_EXTENT = 250.0f;
+  static const float RAY_LENGTH = 100.0f;
+  static const float QUERY_EXTENT = 10.0f;
+  static const size_t QUERY_GRAIN = 64; /* same grain as the tree batches */
+
+  /* xorshift, the same scene every run */
+  static float randomFloat(uint32_t &state, float min, float max)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return min + (max - min) * ((state >> 8) * (1.0f / 16777216.0f));
+  }
+
+
+  static glm::vec3 randomPoint(uint32_t &state, float extent)
+  {
+    return glm::vec3(randomFloat(state, -extent, extent),
+                     randomFloat(state, -extent, extent),
+                     randomFloat(state, -extent, extent));
+  }
+
+
+  /* What the tree replaces: every query tests every box */
+  static void bruteForceRaycasts(const std::vector<AABB> &objects, const std::vector<Ray> &rays,
+                                 std::vector<RayHit> &hits)
+  {
+    ThreadPool::instance()->parallelFor(rays.size(), QUERY_GRAIN, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+      {
+        const Ray &ray = rays[i];
+        const glm::vec3 inverse_direction(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+        RayHit &hit = hits[i];
+        hit.proxy = AABBTree::NULL_NODE;
+        hit.user_data = nullptr;
+        hit.distance = ray.max_distance;
+        for (size_t object = 0; object < objects.size(); ++object)
+        {
+          float distance;
+          if (objects[object].intersectRay(ray.origin, inverse_direction, hit.distance, distance))
+          {
+            hit.proxy = (int)object;
+            hit.distance = distance;
+          }
+        }
+      }
+    });
+  }
+
+
+  static void bruteForceOverlaps(const std::vector<AABB> &objects, const std::vector<AABB> &queries,
+                                 std::vector<std::vector<int> > &results)
+  {
+    ThreadPool::instance()->parallelFor(queries.size(), QUERY_GRAIN, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+      {
+        for (size_t object = 0; object < objects.size(); ++object)
+        {
+          if (objects[object].overlaps(queries[i]))
+            results[i].push_back((int)object);
+        }
+      }
+    });
+  }
+
+
+  static void clearResults(std::vector<std::vector<int> > &results)
+  {
+    for (auto &result : results)
+      result.clear();
+  }
+
+
+  /////////////////////////////////////////////////////////////////////// public
+  bool benchmarkSpatialQueries(const std::vector<std::string> &arguments)
+  {
+    size_t object_count = benchmarkArgument(arguments, 0, 100000);
+    size_t query_count = benchmarkArgument(arguments, 1, 1000);
+    size_t iterations = benchmarkArgument(arguments, 2, 20);
+
+    uint32_t random_state = 0x9e3779b9u;
+    std::vector<AABB> objects(object_count);
+    for (auto &object : objects)
+    {
+      glm::vec3 center = randomPoint(random_state, WORLD_EXTENT);
+      glm::vec3 half_size(randomFloat(random_state, 0.25f, 2.5f),
+                          randomFloat(random_state, 0.25f, 2.5f),
+                          randomFloat(random_state, 0.25f, 2.5f));
+      object = AABB(center - half_size, center + half_size);
+    }
+
+    std::vector<Ray> rays(query_count);
+    std::vector<AABB> queries(query_count);
+    for (size_t i = 0; i < query_count; ++i)
+    {
+      glm::vec3 direction = randomPoint(random_state, 1.0f);
+      if (direction == glm::vec3(0.0f)) direction.z = -1.0f;
+      rays[i] = Ray(randomPoint(random_state, WORLD_EXTENT), direction / std::sqrt(glm::dot(direction, direction)),
+                    RAY_LENGTH);
+
+      glm::vec3 center = randomPoint(random_state, WORLD_EXTENT);
+      queries[i] = AABB(center - glm::vec3(QUERY_EXTENT), center + glm::vec3(QUERY_EXTENT));
+    }
+
+    // proxies are handed out in creation order, remember them to compare against brute force
+    double start_time = Time::current();
+    AABBTree tree;
+    std::vector<int> proxies(object_count);
+    for (size_t i = 0; i < object_count; ++i)
+      proxies[i] = tree.createProxy(objects[i], nullptr);
+    double build_time = Time::current() - start_time;
+
+    std::cout << "  " << object_count << " objects, " << query_count << " queries of each kind, " << iterations
+              << " iterations, " << ThreadPool::instance()->getWorkerCount() << " workers\n";
+    std::cout << "  tree built in " << build_time << " ms, height " << tree.getHeight() << ", area ratio "
+              << tree.getAreaRatio() << "\n";
+
+    std::vector<RayHit> tree_hits(query_count), brute_hits(query_count);
+    std::vector<std::vector<int> > tree_overlaps(query_count), brute_overlaps(query_count);
+
+    BenchmarkTimings tree_ray_timings("tree raycasts");
+    BenchmarkTimings brute_ray_timings("brute force raycasts");
+    BenchmarkTimings tree_overlap_timings("tree overlaps");
+    BenchmarkTimings brute_overlap_timings("brute force overlaps");
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+    {
+      start_time = Time::current();
+      tree.raycastBatch(rays.data(), query_count, tree_hits.data());
+      tree_ray_timings.add(Time::current() - start_time);
+
+      start_time = Time::current();
+      bruteForceRaycasts(objects, rays, brute_hits);
+      brute_ray_timings.add(Time::current() - start_time);
+
+      clearResults(tree_overlaps);
+      start_time = Time::current();
+      tree.overlapBatch(queries.data(), query_count, tree_overlaps.data());
+      tree_overlap_timings.add(Time::current() - start_time);
+
+      clearResults(brute_overlaps);
+      start_time = Time::current();
+      bruteForceOverlaps(objects, queries, brute_overlaps);
+      brute_overlap_timings.add(Time::current() - start_time);
+    }
+
+    // ties between boxes at the same distance may pick either, so only distances are compared
+    size_t ray_hits = 0, overlap_hits = 0;
+    for (size_t i = 0; i < query_count; ++i)
+    {
+      bool tree_hit = tree_hits[i].proxy != AABBTree::NULL_NODE;
+      bool brute_hit = brute_hits[i].proxy != AABBTree::NULL_NODE;
+      if (tree_hit != brute_hit || (tree_hit && tree_hits[i].distance != brute_hits[i].distance))
+      {
+        std::cerr << "ERROR: Raycast " << i << " disagrees with brute force.\n";
+        return false;
+      }
+
+      for (auto &object : brute_overlaps[i])
+        object = proxies[object];
+      std::sort(tree_overlaps[i].begin(), tree_overlaps[i].end());
+      std::sort(brute_overlaps[i].begin(), brute_overlaps[i].end());
+      if (tree_overlaps[i] != brute_overlaps[i])
+      {
+        std::cerr << "ERROR: Overlap query " << i << " disagrees with brute force.\n";
+        return false;
+      }
+
+      ray_hits += tree_hit ? 1 : 0;
+      overlap_hits += tree_overlaps[i].size();
+    }
+
+    std::cout << "  " << ray_hits << " rays hit, " << overlap_hits << " overlaps found, both match brute force\n";
+
+    tree_ray_timings.report();
+    brute_ray_timings.report();
+    tree_overlap_timings.report();
+    brute_overlap_timings.report();
+
+    double ray_speedup = brute_ray_timings.getMedian() / std::max(tree_ray_timings.getMedian(), 1e-6);
+    double overlap_speedup = brute_overlap_timings.getMedian() / std::max(tree_overlap_timings.getMedian(), 1e-6);
+    std::cout << "  " << (size_t)(query_count / std::max(tree_ray_timings.getMedian(), 1e-6))
+              << " raycasts per millisecond, " << ray_speedup << "x brute force\n";
+    std::cout << "  " << (size_t)(query_count / std::max(tree_overlap_timings.getMedian(), 1e-6))
+              << " overlaps per millisecond, " << overlap_speedup << "x brute force\n";
+
+    return true;
+  }
+} // namespace vv
\ No newline at end of file
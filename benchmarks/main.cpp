@@ -0,0 +1,58 @@
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <GLFW/glfw3.h>
+
+#include "Benchmark.h"
+
+using namespace vv;
+
+static const Benchmark BENCHMARKS[] =
+{
+  { "skinning", "[characters=1000] [frames=300] [skinned model]", benchmarkSkinning },
+  { "particles", "[particles=1000000] [frames=300] [emitters=16]", benchmarkParticles },
+  { "spatial", "[objects=100000] [queries=1000] [iterations=20]", benchmarkSpatialQueries },
+  { "obj", "<obj file> [iterations=5]", benchmarkObjImport },
+  { "indirect", "[instances=100000] [frames=100] [meshes=16]", benchmarkIndirect }
+};
+
+static void printUsage(const char *program)
+{
+  std::cout << "Usage: " << program << " <benchmark> [arguments]\n";
+  for (auto &benchmark : BENCHMARKS)
+    std::cout << "  " << benchmark.name << " " << benchmark.usage << "\n";
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // the engine's timers read the glfw clock
+  if (!glfwInit())
+  {
+    std::cerr << "ERROR: GLFW failed to initialize.\n";
+    return EXIT_FAILURE;
+  }
+
+  for (auto &benchmark : BENCHMARKS)
+  {
+    if (std::strcmp(argv[1], benchmark.name) != 0) continue;
+
+    std::cout << benchmark.name << "\n";
+    bool success = benchmark.function(std::vector<std::string>(argv + 2, argv + argc));
+
+    destroyBenchmarkContext();
+    glfwTerminate();
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  glfwTerminate();
+  printUsage(argv[0]);
+  return EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+
+#ifndef VIRTUALVISTA_AABB_H
+#define VIRTUALVISTA_AABB_H
+
+#include <cfloat>
+#include <utility>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <glm/vec3.hpp>
+
+namespace vv
+{
+  struct AABB
+  {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    AABB() :
+      min(FLT_MAX),
+      max(-FLT_MAX)
+    {
+    }
+
+    AABB(glm::vec3 min_corner, glm::vec3 max_corner) :
+      min(min_corner),
+      max(max_corner)
+    {
+    }
+
+    bool isValid() const
+    {
+      return (min.x <= max.x) && (min.y <= max.y) && (min.z <= max.z);
+    }
+
+    glm::vec3 getCorner(int i) const
+    {
+      return glm::vec3((i & 1) ? max.x : min.x,
+                       (i & 2) ? max.y : min.y,
+                       (i & 4) ? max.z : min.z);
+    }
+
+    void expand(glm::vec3 point)
+    {
+      min = glm::min(min, point);
+      max = glm::max(max, point);
+    }
+
+    void expand(const AABB &other)
+    {
+      min = glm::min(min, other.min);
+      max = glm::max(max, other.max);
+    }
+
+    bool contains(const AABB &other) const
+    {
+      return (min.x <= other.min.x) && (min.y <= other.min.y) && (min.z <= other.min.z) &&
+             (other.max.x <= max.x) && (other.max.y <= max.y) && (other.max.z <= max.z);
+    }
+
+    bool overlaps(const AABB &other) const
+    {
+      return (min.x <= other.max.x) && (other.min.x <= max.x) &&
+             (min.y <= other.max.y) && (other.min.y <= max.y) &&
+             (min.z <= other.max.z) && (other.min.z <= max.z);
+    }
+
+    float surfaceArea() const
+    {
+      glm::vec3 size = max - min;
+      return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    /* Slab test, inverse_direction is 1 / direction per axis. Returns the entry distance
+       in distance, which is 0 when the origin starts inside. */
+    bool intersectRay(const glm::vec3 &origin, const glm::vec3 &inverse_direction,
+                      float max_distance, float &distance) const
+    {
+      float enter = 0.0f, leave = max_distance;
+      for (int i = 0; i < 3; ++i)
+      {
+        float t0 = (min[i] - origin[i]) * inverse_direction[i];
+        float t1 = (max[i] - origin[i]) * inverse_direction[i];
+        if (t0 > t1) std::swap(t0, t1);
+        if (t0 > enter) enter = t0;
+        if (t1 < leave) leave = t1;
+        if (enter > leave) return false;
+      }
+
+      distance = enter;
+      return true;
+    }
+
+    static AABB combine(const AABB &a, const AABB &b)
+    {
+      return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+    }
+
+    /* Bounds of this box after an arbitrary affine transform */
+    AABB transformed(const glm::mat4 &matrix) const
+    {
+      AABB result;
+      for (int i = 0; i < 8; ++i)
+      {
+        glm::vec4 corner = matrix * glm::vec4(getCorner(i), 1.0f);
+        result.expand(glm::vec3(corner.x, corner.y, corner.z));
+      }
+      return result;
+    }
+  };
+}
+
+#endif // VIRTUALVISTA_AABB_H
\ No newline at end of file
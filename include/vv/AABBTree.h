@@ -0,0 +1,113 @@
+
+#ifndef VIRTUALVISTA_AABBTREE_H
+#define VIRTUALVISTA_AABBTREE_H
+
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "AABB.h"
+
+namespace vv
+{
+  struct Ray
+  {
+    glm::vec3 origin;
+    glm::vec3 direction; /* doesn't need to be normalized, distances are in its units */
+    float max_distance;
+
+    Ray() :
+      origin(0.0f),
+      direction(0.0f, 0.0f, -1.0f),
+      max_distance(FLT_MAX)
+    {
+    }
+
+    Ray(glm::vec3 ray_origin, glm::vec3 ray_direction, float distance = FLT_MAX) :
+      origin(ray_origin),
+      direction(ray_direction),
+      max_distance(distance)
+    {
+    }
+  };
+
+  struct RayHit
+  {
+    int proxy; /* AABBTree::NULL_NODE when nothing was hit */
+    void *user_data;
+    float distance;
+  };
+
+  /* Dynamic bounding volume hierarchy. Leaves store fattened boxes so small movements
+     don't touch the tree, insertion descends by surface area cost and rotations keep it
+     balanced. Queries are const and keep their state on the stack, any number of threads
+     may run them at once as long as nothing modifies the tree meanwhile. */
+  class AABBTree
+  {
+  public:
+    static const int NULL_NODE = -1;
+
+    AABBTree(float margin = 0.1f);
+    ~AABBTree();
+
+    int createProxy(const AABB &bounds, void *user_data);
+    void destroyProxy(int proxy);
+
+    /* Returns true when the proxy left its fat box and was reinserted. The displacement
+       stretches the new fat box in the direction of travel. */
+    bool moveProxy(int proxy, const AABB &bounds, const glm::vec3 &displacement = glm::vec3(0.0f));
+
+    void* getUserData(int proxy) const;
+    const AABB& getBounds(int proxy) const;
+    const AABB& getFatBounds(int proxy) const;
+
+    /* Closest hit against the exact proxy bounds */
+    bool raycast(const Ray &ray, RayHit &hit) const;
+    void overlap(const AABB &bounds, std::vector<int> &proxies) const;
+
+    /* Spread over the thread pool, results line up with the queries */
+    void raycastBatch(const Ray *rays, size_t count, RayHit *hits) const;
+    void overlapBatch(const AABB *queries, size_t count, std::vector<int> *results) const;
+
+    size_t getProxyCount() const;
+    int getHeight() const;
+
+    /* Summed node area over root area, a rough measure of tree quality */
+    float getAreaRatio() const;
+
+  private:
+    /* Fits one root to leaf path twice over for any tree the rotations allow */
+    static const int STACK_SIZE = 256;
+
+    struct Node
+    {
+      AABB bounds; /* fattened for leaves */
+      int parent;  /* next free node while on the free list */
+      int child1;
+      int child2;
+      int height;  /* 0 for leaves, -1 for free nodes */
+      void *user_data;
+
+      bool isLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<AABB> proxy_bounds_; /* exact bounds, only read at leaves */
+    int root_;
+    int free_list_;
+    size_t proxy_count_;
+    float margin_;
+
+    AABBTree(const AABBTree&);
+    AABBTree& operator=(const AABBTree&);
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int node);
+    void refit(int node);
+  };
+}
+
+#endif // VIRTUALVISTA_AABBTREE_H
\ No newline at end of file
@@ -0,0 +1,95 @@
+
+#ifndef VIRTUALVISTA_ANIMATION_H
+#define VIRTUALVISTA_ANIMATION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+namespace vv
+{
+  /* Local joint transforms, one entry per joint in skeleton order */
+  struct Pose
+  {
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+
+    void resize(size_t joint_count);
+
+    /* Moves toward other by weight, rotations take the shortest path */
+    void blend(const Pose &other, float weight);
+  };
+
+  /* Joint hierarchy of a mesh. Parents always come before their children, so a single
+     forward pass turns local transforms into model space ones. */
+  struct Skeleton
+  {
+    std::vector<std::string> joint_names;
+    std::vector<int> parents; /* -1 for roots */
+    Pose bind_pose;
+
+    /* Palette slot -> joint, only joints that deform vertices get a slot */
+    std::vector<int> bone_joints;
+    std::vector<glm::mat4> inverse_bind; /* per palette slot, mesh space to bone space */
+    glm::mat4 global_inverse;
+
+    size_t getJointCount() const;
+    size_t getBoneCount() const;
+    int findJoint(const std::string &name) const;
+
+    /* Writes getBoneCount() skinning matrices */
+    void computePalette(const Pose &pose, std::vector<glm::mat4> &model_space, glm::mat4 *palette) const;
+  };
+
+  /* Key ranges of one joint inside the clip's shared key arrays, a count of 0 means the
+     joint keeps its bind pose for that channel */
+  struct AnimationTrack
+  {
+    uint32_t first_translation;
+    uint32_t translation_count;
+    uint32_t first_rotation;
+    uint32_t rotation_count;
+    uint32_t first_scale;
+    uint32_t scale_count;
+  };
+
+  /* Keys of every joint are packed into separate time and value arrays per channel, so a
+     key search only walks the times and never drags values through the cache */
+  class AnimationClip
+  {
+    friend class Mesh;
+
+  public:
+    AnimationClip(std::string name, float duration, size_t joint_count);
+
+    const std::string& getName() const;
+    float getDuration() const; /* in seconds */
+
+    void sample(const Skeleton &skeleton, float time, Pose &pose) const;
+
+    /* For clips built in code, times have to be ascending. Setting a channel twice leaves
+       the earlier keys unused in the arrays. */
+    void setTranslationKeys(size_t joint, const float *times, const glm::vec3 *values, size_t count);
+    void setRotationKeys(size_t joint, const float *times, const glm::quat *values, size_t count);
+    void setScaleKeys(size_t joint, const float *times, const glm::vec3 *values, size_t count);
+
+  private:
+    std::string name_;
+    float duration_;
+
+    std::vector<AnimationTrack> tracks_;
+    std::vector<float> translation_times_;
+    std::vector<glm::vec3> translation_values_;
+    std::vector<float> rotation_times_;
+    std::vector<glm::quat> rotation_values_;
+    std::vector<float> scale_times_;
+    std::vector<glm::vec3> scale_values_;
+  };
+}
+
+#endif // VIRTUALVISTA_ANIMATION_H
\ No newline at end of file
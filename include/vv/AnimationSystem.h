@@ -0,0 +1,93 @@
+
+#ifndef VIRTUALVISTA_ANIMATIONSYSTEM_H
+#define VIRTUALVISTA_ANIMATIONSYSTEM_H
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+
+#include "Animation.h"
+
+namespace vv
+{
+  struct AnimationLayer
+  {
+    const AnimationClip *clip;
+    float time;   /* in seconds */
+    float speed;
+    float weight; /* blends over the layers below it */
+    bool loop;
+  };
+
+  struct AnimationStats
+  {
+    size_t instances;
+    size_t bones;
+    double sample_time; /* in milliseconds */
+    double upload_time; /* in milliseconds */
+  };
+
+  /* Samples and blends every animated instance in parallel and packs the resulting bone
+     palettes into one texture buffer, read by the SKINNING shader variant as
+     bone_palette starting at palette_offset. */
+  class AnimationSystem
+  {
+  public:
+    static const int MAX_LAYERS = 4;
+
+    AnimationSystem();
+    ~AnimationSystem();
+
+    bool init();
+
+    /* The skeleton has to outlive the instance */
+    size_t createInstance(const Skeleton *skeleton);
+    void destroyInstance(size_t instance);
+
+    void play(size_t instance, int layer, const AnimationClip *clip, float weight = 1.0f,
+              bool loop = true, float speed = 1.0f);
+    void stop(size_t instance, int layer);
+    void setWeight(size_t instance, int layer, float weight);
+
+    void update(float delta_time); /* in seconds */
+    void upload();
+    void bindPalette(GLuint unit);
+
+    /* In bones, only stable until the next createInstance() or destroyInstance() */
+    GLint getPaletteOffset(size_t instance) const;
+    const glm::mat4* getPalette(size_t instance) const;
+    const AnimationStats& getStats() const;
+
+  private:
+    struct Instance
+    {
+      const Skeleton *skeleton;
+      AnimationLayer layers[MAX_LAYERS];
+      size_t palette_offset;
+      bool alive;
+    };
+
+    /* Instances handed to one job at a time */
+    static const size_t INSTANCE_GRAIN = 8;
+
+    std::vector<Instance> instances_;
+    std::vector<size_t> free_instances_;
+    bool layout_dirty_;
+
+    std::vector<glm::mat4> palettes_;
+    GLuint palette_buffer_;
+    GLuint palette_texture_;
+    size_t buffer_capacity_; /* in bytes */
+
+    AnimationStats stats_;
+
+    AnimationSystem(const AnimationSystem&);
+    AnimationSystem& operator=(const AnimationSystem&);
+
+    void layoutPalettes();
+    void evaluate(Instance &instance, float delta_time);
+  };
+}
+
+#endif // VIRTUALVISTA_ANIMATIONSYSTEM_H
\ No newline at end of file
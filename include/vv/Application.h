@@ -2,13 +2,24 @@
 #ifndef VIRTUALVISTA_APPLICATION_H
 #define VIRTUALVISTA_APPLICATION_H
 
+#include <string>
 #include <vector>
 
 #include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
 
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "GLRenderBackend.h"
 #include "RenderContex.h"
 #include "InputManager.h"
+#include "InputRecorder.h"
+#include "MemoryTracker.h"
+#include "Metrics.h"
+#include "RenderQueue.h"
 #include "ResourceManager.h"
+#include "Scene.h"
 
 namespace vv
 {
@@ -22,17 +33,63 @@ namespace vv
     void run();
     void shutdown();
 
+    /* Offline side of texture streaming, converts every --build-mips image to a .vvtex next
+       to it. Needs no window, so it runs instead of init() and run(). */
+    bool hasMipChainJobs() const;
+    bool buildMipChains();
+
   private:
     bool first_run_;
     bool initialized_;
     bool quit_;
 
-    int argc;
-    char **argv;
+    int argc_;
+    char **argv_;
+
+    // Command line options
+    std::string record_file_; /* --record <file> */
+    std::string replay_file_; /* --replay <file> */
+    bool replay_fast_;        /* --fast */
+    std::string metrics_socket_; /* --metrics <socket> */
+    std::string capture_directory_; /* --capture <directory> */
+    bool capture_raw_;              /* --capture-raw */
+    std::vector<std::string> mip_chain_images_; /* --build-mips <image>, may be repeated */
 
     RenderContex *contex_;
     InputManager *input_manager_;
     ResourceManager *resource_manager_;
+    Scene *scene_;
+    RenderQueue *render_queue_;
+    GLRenderBackend *render_backend_;
+    DynamicResolution *dynamic_resolution_;
+    InputRecorder *input_recorder_;
+    FrameCapture *frame_capture_;
+    MetricsServer *metrics_server_;
+
+    // Camera, fixed until input drives it
+    glm::vec3 camera_position_;
+    glm::mat4 view_;
+    glm::mat4 projection_;
+
+    // Registry handles, written once per frame
+    struct FrameMetrics
+    {
+      Counter *frames;
+      Histogram *frame_time;
+      Gauge *frame_rate;
+      Gauge *draw_calls;
+      Gauge *state_changes;
+      Gauge *frame_allocations;
+      Gauge *thread_pool_queue;
+      Gauge *world_streaming_queue;
+      Gauge *texture_streaming_queue;
+      Gauge *memory_bytes[MEMORY_TAG_COUNT];
+    };
+    FrameMetrics metrics_;
+
+    void parseArguments();
+    void registerMetrics();
+    void updateMetrics();
     
   };
 }
@@ -0,0 +1,80 @@
+
+#ifndef VIRTUALVISTA_DYNAMICRESOLUTION_H
+#define VIRTUALVISTA_DYNAMICRESOLUTION_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+namespace vv
+{
+  struct DynamicResolutionStats
+  {
+    float scale;
+    int render_width;
+    int render_height;
+    double gpu_time;          /* in milliseconds, most recent resolved query */
+    double smoothed_gpu_time; /* in milliseconds */
+    size_t scale_changes;
+  };
+
+  /* Renders the scene into an offscreen framebuffer at a fraction of the window size and
+     stretches it over the window. The fraction follows the gpu time of earlier frames.
+     The window itself can't be multisampled for the scaling blit, so msaa happens offscreen. */
+  class DynamicResolution
+  {
+  public:
+    DynamicResolution();
+    ~DynamicResolution();
+
+    /* Sizes are framebuffer pixels, which differ from window units on HiDPI screens. Storage is
+       allocated once at max_scale, changing the scale only moves the viewport. With samples
+       above 1 the scene is rendered multisampled and resolved before scaling. */
+    bool init(int framebuffer_width, int framebuffer_height, float min_scale, float max_scale,
+              double target_frame_time, int samples = 0);
+
+    /* Binds the offscreen framebuffer and starts timing the frame */
+    void beginFrame();
+
+    /* Stops timing, resolves and upscales into the default framebuffer, call before swapping */
+    void endFrame();
+
+    float getScale() const;
+    void getRenderSize(int &width, int &height) const;
+    const DynamicResolutionStats& getStats() const;
+
+  private:
+    /* Results are read a few frames late so the cpu never waits on the gpu */
+    static const int QUERY_COUNT = 4;
+
+    GLuint framebuffer_;         /* rendered into */
+    GLuint resolve_framebuffer_; /* 0 unless multisampled, holds color_texture_ then */
+    GLuint color_texture_;
+    GLuint color_renderbuffer_;  /* multisampled color, 0 without msaa */
+    GLuint depth_renderbuffer_;
+    int samples_;
+    GLuint queries_[QUERY_COUNT];
+    bool query_pending_[QUERY_COUNT];
+    int query_index_;
+    bool timing_;
+
+    int framebuffer_width_;
+    int framebuffer_height_;
+    float min_scale_;
+    float max_scale_;
+    double target_frame_time_;
+    float scale_;
+    int cooldown_;
+
+    DynamicResolutionStats stats_;
+
+    DynamicResolution(const DynamicResolution&);
+    DynamicResolution& operator=(const DynamicResolution&);
+
+    void collectQueries();
+    void updateScale(double gpu_time);
+    void release();
+  };
+}
+
+#endif // VIRTUALVISTA_DYNAMICRESOLUTION_H
\ No newline at end of file
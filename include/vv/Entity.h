@@ -2,10 +2,22 @@
 #ifndef VIRTUALVISTA_ENTITY_H
 #define VIRTUALVISTA_ENTITY_H
 
+#include <vector>
+
+#include "AABB.h"
+#include "RenderQueue.h"
 #include "Transform.h"
 
 namespace vv
 {
+  class Texture;
+
+  struct StreamedTextureUse
+  {
+    Texture *texture;
+    float uv_density; /* texture coordinate units per model space unit */
+  };
+
   class Entity
   {
   public:
@@ -15,14 +27,33 @@ namespace vv
     Transform* getTransform();
     bool isRenderable();
     void setVisiblity(bool visibility);
+    void setOccluded(bool occluded);
+    bool isOccluded() const;
+
+    /* Valid bounds mark the entity as having geometry, culling and recording skip the rest */
+    void setBounds(const AABB &bounds);
+    const AABB& getBounds() const;
+    AABB getWorldBounds();
+
+    /* Reported to the scene's texture streamer whenever the entity is recorded, the density
+       usually comes from Mesh::getUvDensity() */
+    void addStreamedTexture(Texture *texture, float uv_density);
+    void removeStreamedTexture(Texture *texture);
+    const std::vector<StreamedTextureUse>& getStreamedTextures() const;
 
     virtual void render() = 0;
 
+    /* Deferred alternative to render(), may be called from any worker thread */
+    virtual void record(CommandBuffer &, const glm::vec3 &) {}
+
   private:
     bool is_visible_; /* lock for visibility within view frustum */
+    bool is_occluded_; /* lock for visibility behind occluders, set by the occlusion culler */
     bool has_geometry_; /* determines whether entity has anything to draw */
 
     Transform *transform_;
+    AABB bounds_; /* model space */
+    std::vector<StreamedTextureUse> streamed_textures_;
 
   };
 }
@@ -0,0 +1,114 @@
+
+#ifndef VIRTUALVISTA_FRAMECAPTURE_H
+#define VIRTUALVISTA_FRAMECAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace vv
+{
+  enum CaptureFormat
+  {
+    CAPTURE_PNG = 0, /* frame_000000.png, rgb */
+    CAPTURE_RAW = 1  /* frame_000000_<width>x<height>.rgba, rgba8 rows from the top */
+  };
+
+  struct CaptureStats
+  {
+    size_t frames_read;
+    size_t frames_written;
+    size_t write_failures;
+    size_t fence_waits;    /* a readback wasn't finished when its buffer came around again */
+    size_t writer_waits;   /* every cpu frame was still queued for the writers */
+    double readback_time;  /* cpu time of the last capture(), in milliseconds */
+    double encode_time;    /* average per written frame, in milliseconds */
+  };
+
+  /* Records every frame without stalling the pipeline. Pixels are read into a ring of pack
+     buffers and only mapped RING_SIZE frames later, once their fence has signaled, then
+     handed to writer threads that encode and save them. */
+  class FrameCapture
+  {
+  public:
+    FrameCapture();
+    ~FrameCapture();
+
+    /* The directory has to exist already. A writer_count of 0 picks one writer on machines
+       with up to two cores, where a second one only preempts the render thread, and two
+       everywhere else. */
+    bool init(int width, int height, const std::string &directory, CaptureFormat format,
+              size_t writer_count = 0);
+
+    /* Reads the back buffer, call once the frame is complete and before swapping */
+    void capture();
+
+    /* Maps what is still in flight and waits until every frame is on disk */
+    void finish();
+
+    CaptureStats getStats() const;
+
+  private:
+    static const size_t RING_SIZE = 3;  /* drivers queue up to two frames, the third is signaled */
+    static const size_t MAX_QUEUED = 6; /* cpu frames waiting for the writers, covers disk hiccups */
+
+    struct Slot
+    {
+      GLuint buffer;
+      GLsync fence;
+      size_t frame;
+    };
+
+    struct Frame
+    {
+      std::vector<uint8_t> pixels;
+      size_t index;
+    };
+
+    int width_;
+    int height_;
+    std::string directory_;
+    CaptureFormat format_;
+
+    Slot slots_[RING_SIZE];
+    size_t next_slot_;
+    size_t frame_count_;
+
+    // preallocated, the steady-state loop never touches the heap for a capture
+    std::vector<Frame> frames_;
+    std::vector<size_t> free_frames_;
+    std::vector<size_t> queued_;  /* fifo ring of frames for the writers */
+    size_t queue_head_;
+    size_t queue_count_;
+
+    std::mutex mutex_;
+    std::condition_variable frame_queued_;
+    std::condition_variable frame_released_;
+    bool stopping_;
+    std::vector<std::thread> writers_;
+
+    std::atomic<size_t> frames_read_;
+    std::atomic<size_t> frames_written_;
+    std::atomic<size_t> write_failures_;
+    std::atomic<size_t> fence_waits_;
+    std::atomic<size_t> writer_waits_;
+    std::atomic<uint64_t> encode_microseconds_;
+    double readback_time_;
+
+    FrameCapture(const FrameCapture&);
+    FrameCapture& operator=(const FrameCapture&);
+
+    void resolve(Slot &slot);
+    void writerLoop();
+    bool writeFrame(const Frame &frame) const;
+    void release();
+  };
+}
+
+#endif // VIRTUALVISTA_FRAMECAPTURE_H
\ No newline at end of file
@@ -0,0 +1,57 @@
+
+#ifndef VIRTUALVISTA_FRUSTUM_H
+#define VIRTUALVISTA_FRUSTUM_H
+
+#include <cmath>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "AABB.h"
+
+namespace vv
+{
+  struct Frustum
+  {
+    glm::vec4 planes[6]; /* left, right, bottom, top, near, far with inward normals */
+
+    /* Gribb-Hartmann, every plane normalized so distances can be compared against radii */
+    explicit Frustum(const glm::mat4 &m)
+    {
+      glm::vec4 row[4];
+      for (int i = 0; i < 4; ++i)
+        row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+      for (int i = 0; i < 3; ++i)
+      {
+        planes[i * 2] = row[3] + row[i];
+        planes[i * 2 + 1] = row[3] - row[i];
+      }
+
+      for (int i = 0; i < 6; ++i)
+      {
+        float length = std::sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+        if (length > 0.0f)
+          planes[i] = planes[i] * (1.0f / length);
+      }
+    }
+
+    /* Conservative, boxes near the frustum corners may pass without touching it */
+    bool intersects(const AABB &bounds) const
+    {
+      for (int i = 0; i < 6; ++i)
+      {
+        // the corner furthest along the plane normal
+        glm::vec4 corner((planes[i].x >= 0.0f) ? bounds.max.x : bounds.min.x,
+                         (planes[i].y >= 0.0f) ? bounds.max.y : bounds.min.y,
+                         (planes[i].z >= 0.0f) ? bounds.max.z : bounds.min.z, 1.0f);
+        if (planes[i].x * corner.x + planes[i].y * corner.y + planes[i].z * corner.z + planes[i].w < 0.0f)
+          return false;
+      }
+
+      return true;
+    }
+  };
+}
+
+#endif // VIRTUALVISTA_FRUSTUM_H
\ No newline at end of file
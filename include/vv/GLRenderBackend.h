@@ -0,0 +1,68 @@
+
+#ifndef VIRTUALVISTA_GLRENDERBACKEND_H
+#define VIRTUALVISTA_GLRENDERBACKEND_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "RenderQueue.h"
+#include "Shader.h"
+#include "TexturePacker.h"
+
+namespace vv
+{
+  /* Resolves the ids inside render commands to GL objects and issues them through the
+     state cache, binds only happen when the sorted stream actually switches */
+  class GLRenderBackend : public RenderBackend
+  {
+  public:
+    GLRenderBackend();
+    ~GLRenderBackend();
+
+    uint32_t registerShader(Shader *shader);
+    uint32_t registerMaterial(const PackedMaterial *material, const TexturePacker *packer);
+    uint32_t registerMesh(GLuint vao, GLsizei index_count, GLenum index_type = GL_UNSIGNED_INT,
+                          GLenum mode = GL_TRIANGLES);
+    uint32_t registerUniform(std::string name);
+
+    void beginSubmit();
+    void execute(const RenderCommand &command);
+    void endSubmit();
+
+  private:
+    struct MaterialEntry
+    {
+      const PackedMaterial *material;
+      const TexturePacker *packer;
+    };
+
+    struct MeshEntry
+    {
+      GLuint vao;
+      GLsizei index_count;
+      GLenum index_type;
+      GLenum mode;
+    };
+
+    static const uint32_t NONE = 0xffffffff;
+
+    std::vector<Shader *> shaders_;
+    std::vector<MaterialEntry> materials_;
+    std::vector<MeshEntry> meshes_;
+    std::vector<std::string> uniform_names_;
+    std::unordered_map<uint64_t, GLint> uniform_locations_; /* shader << 32 | uniform */
+
+    uint32_t current_shader_;
+    uint32_t current_material_;
+
+    GLRenderBackend(GLRenderBackend const&);
+    GLRenderBackend& operator=(GLRenderBackend const&);
+
+    GLint getUniformLocation(uint32_t uniform);
+  };
+}
+
+#endif // VIRTUALVISTA_GLRENDERBACKEND_H
\ No newline at end of file
@@ -0,0 +1,99 @@
+
+#ifndef VIRTUALVISTA_GLSTATECACHE_H
+#define VIRTUALVISTA_GLSTATECACHE_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+namespace vv
+{
+  struct GLFrameCounters
+  {
+    size_t api_calls;       /* gl calls actually issued */
+    size_t state_changes;   /* binds and toggles that changed something */
+    size_t redundant_calls; /* requests dropped because the state already matched */
+    size_t draw_calls;
+  };
+
+  /* Shadows the bound GL state of the one context we render with and drops binds that
+     would change nothing. Anything bypassing it must call invalidate() afterwards. */
+  class GLStateCache
+  {
+  public:
+    static GLStateCache* instance();
+
+    void beginFrame();
+    const GLFrameCounters& getFrameCounters() const; /* totals of the last completed frame */
+    const GLFrameCounters& getCurrentCounters() const;
+    void countApiCalls(size_t count = 1);
+
+    void invalidate();
+    void onDeleteProgram(GLuint program);
+    void onDeleteVertexArray(GLuint vao);
+    void onDeleteBuffer(GLuint buffer);
+    void onDeleteTexture(GLuint texture);
+    void onDeleteFramebuffer(GLuint framebuffer);
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+    void setBlend(bool enabled);
+    void setBlendFunc(GLenum source, GLenum destination);
+    void setDepthTest(bool enabled);
+    void setDepthMask(bool enabled);
+    void setDepthFunc(GLenum function);
+    void setCullFace(bool enabled);
+    void setViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    void drawArrays(GLenum mode, GLint first, GLsizei count);
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void *offset);
+    void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+    void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *offset, GLsizei instances);
+    void multiDrawElementsIndirect(GLenum mode, GLenum type, const void *offset, GLsizei draw_count);
+
+  private:
+    static GLStateCache* instance_;
+
+    static const int MAX_TEXTURE_UNITS = 32;
+    static const int TEXTURE_TARGET_COUNT = 5;
+    static const int BUFFER_TARGET_COUNT = 7;
+    static const GLuint UNKNOWN = 0xffffffff;
+
+    GLFrameCounters frame_counters_;
+    GLFrameCounters current_counters_;
+
+    GLuint program_;
+    GLuint vao_;
+    GLuint buffers_[BUFFER_TARGET_COUNT];
+    GLuint active_unit_;
+    GLuint textures_[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+    GLuint draw_framebuffer_;
+    GLuint read_framebuffer_;
+
+    /* 0 or 1 when known, -1 after invalidate() */
+    int blend_;
+    int depth_test_;
+    int depth_mask_;
+    int cull_face_;
+    GLenum blend_source_;
+    GLenum blend_destination_;
+    GLenum depth_func_;
+    GLint viewport_[4];
+
+    GLStateCache();
+    GLStateCache(const GLStateCache&);
+    GLStateCache& operator=(const GLStateCache&);
+
+    static int bufferSlot(GLenum target);
+    static int textureSlot(GLenum target);
+    void setCapability(GLenum capability, bool enabled, int &cached);
+    void changed();
+    void redundant();
+  };
+}
+
+#endif // VIRTUALVISTA_GLSTATECACHE_H
\ No newline at end of file
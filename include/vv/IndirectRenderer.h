@@ -0,0 +1,121 @@
+
+#ifndef VIRTUALVISTA_INDIRECTRENDERER_H
+#define VIRTUALVISTA_INDIRECTRENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "AABB.h"
+
+namespace vv
+{
+  struct IndirectStats
+  {
+    size_t instances;
+    size_t draws;       /* indirect commands, one per registered mesh */
+    size_t batches;     /* multi draw calls, one per run of meshes sharing a vertex array */
+    double upload_time; /* in milliseconds */
+    double submit_time; /* cpu time spent in cull() and draw(), in milliseconds */
+  };
+
+  /* GPU driven submission. Instance bounds and transforms are uploaded once and only
+     touched again when they change, a compute shader culls them against the frustum and
+     fills the indirect commands, and draw() then renders every vertex array with a single
+     glMultiDrawElementsIndirect. Needs a 4.3 context, on 3.3 the render queue path stays. */
+  class IndirectRenderer
+  {
+  public:
+    IndirectRenderer();
+    ~IndirectRenderer();
+
+    static bool isSupported();
+    bool init();
+
+    /* Meshes sharing a vertex array should be registered back to back, every unbroken run
+       of them is drawn by one call. The vertex array gains the culled instance id at
+       attribute 10, which lighting.vert reads in its INDIRECT variant. */
+    uint32_t registerMesh(GLuint vao, GLuint first_index, GLuint index_count, GLint base_vertex = 0);
+
+    uint32_t addInstance(uint32_t mesh, const glm::mat4 &model, const AABB &world_bounds);
+    void setInstance(uint32_t instance, const glm::mat4 &model, const AABB &world_bounds);
+    void clearInstances();
+    size_t getInstanceCount() const;
+
+    /* Results stay on the gpu, nothing here waits for the dispatch to finish */
+    void cull(const glm::mat4 &view_projection);
+
+    /* Expects a program built with VV_INDIRECT and the transforms bound to its sampler */
+    void draw();
+    void bindTransforms(GLuint unit);
+
+    const IndirectStats& getStats() const;
+
+  private:
+    /* Laid out exactly like DrawElementsIndirectCommand */
+    struct DrawCommand
+    {
+      GLuint count;
+      GLuint instance_count;
+      GLuint first_index;
+      GLint base_vertex;
+      GLuint base_instance; /* first slot of this mesh in the visible instance list */
+    };
+
+    /* Laid out like the std430 struct in cull_instances.comp, the mesh index stays an integer
+       because a float carrying its bits would be a denormal that may be flushed to zero */
+    struct InstanceBounds
+    {
+      glm::vec3 min;
+      GLuint mesh;
+      glm::vec3 max;
+      float padding;
+    };
+
+    struct Batch
+    {
+      GLuint vao;
+      size_t first_command;
+      size_t command_count;
+    };
+
+    static const GLuint INSTANCE_ATTRIBUTE = 10;
+    static const GLuint WORKGROUP_SIZE = 64; /* has to match cull_instances.comp */
+
+    GLuint cull_program_;
+    GLint planes_location_;
+    GLint instance_count_location_;
+
+    GLuint bounds_buffer_;    /* one InstanceBounds per instance */
+    GLuint transform_buffer_;
+    GLuint transform_texture_;
+    GLuint command_buffer_;
+    GLuint reset_buffer_;     /* commands with zero instances, copied over before every cull */
+    GLuint visible_buffer_;
+    size_t buffer_capacity_;  /* in instances */
+
+    std::vector<DrawCommand> commands_;
+    std::vector<Batch> batches_;
+    std::vector<uint32_t> mesh_instances_; /* instances per mesh */
+
+    std::vector<InstanceBounds> bounds_;
+    std::vector<glm::mat4> transforms_;
+    size_t dirty_begin_; /* instance range that still has to reach the gpu */
+    size_t dirty_end_;
+    bool layout_dirty_;
+
+    IndirectStats stats_;
+
+    IndirectRenderer(IndirectRenderer const&);
+    IndirectRenderer& operator=(IndirectRenderer const&);
+
+    void upload();
+    void markDirty(size_t instance);
+  };
+}
+
+#endif // VIRTUALVISTA_INDIRECTRENDERER_H
\ No newline at end of file
@@ -0,0 +1,93 @@
+
+#ifndef VIRTUALVISTA_INPUTRECORDER_H
+#define VIRTUALVISTA_INPUTRECORDER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "GLFWState.h"
+
+namespace vv
+{
+  enum RecorderMode
+  {
+    RECORDER_OFF    = 0,
+    RECORDER_RECORD = 1,
+    RECORDER_REPLAY = 2
+  };
+
+  enum ReplaySpeed
+  {
+    REPLAY_RECORDED = 0, /* paced to the recorded frame times */
+    REPLAY_FAST     = 1  /* every frame as soon as the last one is done */
+  };
+
+  /* Sits between glfw and the input manager. Recording passes every event through and
+     logs it, together with the delta of every frame. Replaying drops live input and
+     feeds the log back instead, so a run sees exactly the same input and time steps
+     no matter how fast the machine is. Only a live escape is noted, so a replay can
+     still be cut short.
+
+     File layout, in host byte order so a recording only replays on machines of the same
+     endianness: "VVRP", uint16 version, uint16 reserved, then records that each start
+     with a one byte type. A frame record holds the frame's delta as a double, key and
+     mouse records follow the frame their events were polled in. */
+  class InputRecorder : public GLFWState
+  {
+  public:
+    InputRecorder(GLFWState *target);
+    ~InputRecorder();
+
+    bool startRecording(const std::string &file);
+    bool startReplay(const std::string &file, ReplaySpeed speed);
+    void stop();
+
+    RecorderMode getMode() const;
+    ReplaySpeed getSpeed() const;
+    bool isFinished() const;    /* replay ran out of frames */
+    bool isInterrupted() const; /* escape was pressed live while replaying */
+    size_t getFrameCount() const;
+
+    /* Takes the measured delta and returns the one the frame should use */
+    double beginFrame(double delta_time);
+
+    /* Replaces glfwPollEvents() */
+    void pollEvents();
+
+    void keyCallback(GLFWwindow *window, int key, int scan_code, int action, int mods);
+    void mouseCallback(GLFWwindow *window, double curr_x, double curr_y);
+
+  private:
+    enum RecordType
+    {
+      RECORD_FRAME = 0,
+      RECORD_KEY   = 1,
+      RECORD_MOUSE = 2,
+      RECORD_END   = 3
+    };
+
+    static const uint16_t FILE_VERSION = 1;
+
+    GLFWState *target_;
+    RecorderMode mode_;
+    ReplaySpeed speed_;
+    std::fstream file_;
+    std::string file_name_;
+
+    size_t frame_count_;
+    bool finished_;
+    bool interrupted_;
+    double replay_start_;   /* wall clock, in milliseconds */
+    double replay_elapsed_; /* sum of replayed deltas, in milliseconds */
+
+    InputRecorder(const InputRecorder&);
+    InputRecorder& operator=(const InputRecorder&);
+
+    void write(const void *data, size_t size);
+    bool read(void *data, size_t size);
+    void replayEvents();
+  };
+}
+
+#endif // VIRTUALVISTA_INPUTRECORDER_H
\ No newline at end of file
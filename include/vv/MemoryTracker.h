@@ -0,0 +1,86 @@
+
+#ifndef VIRTUALVISTA_MEMORYTRACKER_H
+#define VIRTUALVISTA_MEMORYTRACKER_H
+
+#include <cstddef>
+#include <ostream>
+
+/* Heap tracking is opt-in, build with -DVV_TRACK_ALLOCATIONS=ON to replace the global
+   operator new/delete. Without it every call here compiles down to nothing. */
+#define VV_MEMORY_CONCAT_(a, b) a##b
+#define VV_MEMORY_CONCAT(a, b) VV_MEMORY_CONCAT_(a, b)
+#define VV_MEMORY_SCOPE(tag) vv::MemoryScope VV_MEMORY_CONCAT(memory_scope_, __LINE__)(tag)
+
+namespace vv
+{
+  enum MemoryTag
+  {
+    MEMORY_GENERAL   = 0,
+    MEMORY_RESOURCES = 1,
+    MEMORY_SCENE     = 2,
+    MEMORY_RENDERING = 3,
+    MEMORY_INPUT     = 4,
+    MEMORY_STREAMING = 5,
+    MEMORY_ANIMATION = 6,
+    MEMORY_TAG_COUNT = 7
+  };
+
+  enum AllocationGuard
+  {
+    GUARD_OFF    = 0,
+    GUARD_REPORT = 1, /* print every allocation made while guarded */
+    GUARD_ASSERT = 2  /* print and assert, for debug builds */
+  };
+
+  struct MemoryTagStats
+  {
+    size_t bytes;             /* currently allocated */
+    size_t peak_bytes;        /* high-water mark */
+    size_t live_allocations;
+    size_t total_allocations;
+  };
+
+  class MemoryTracker
+  {
+  public:
+    static bool isEnabled();
+
+    static void pushTag(MemoryTag tag);
+    static void popTag();
+    static MemoryTag currentTag();
+
+    static MemoryTagStats getStats(MemoryTag tag);
+    static const char* getTagName(MemoryTag tag);
+    static size_t getTotalBytes();
+    static size_t getPeakBytes();
+
+    static void beginFrame();
+    static size_t getFrameAllocations(); /* allocations made during the last completed frame */
+
+    /* Applies to the calling thread only */
+    static void setAllocationGuard(AllocationGuard guard);
+    static size_t getGuardViolations();
+
+    static void report(std::ostream &out);
+
+    static void* allocate(size_t size);
+    static void release(void *pointer);
+  };
+
+  class MemoryScope
+  {
+  public:
+#ifdef VV_TRACK_ALLOCATIONS
+    explicit MemoryScope(MemoryTag tag) { MemoryTracker::pushTag(tag); }
+    ~MemoryScope() { MemoryTracker::popTag(); }
+#else
+    explicit MemoryScope(MemoryTag) {}
+#endif
+
+  private:
+    MemoryScope(const MemoryScope&);
+    MemoryScope& operator=(const MemoryScope&);
+  };
+}
+
+#endif // VIRTUALVISTA_MEMORYTRACKER_H
\ No newline at end of file
@@ -0,0 +1,124 @@
+
+#ifndef VIRTUALVISTA_MESH_H
+#define VIRTUALVISTA_MESH_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "AABB.h"
+#include "Animation.h"
+#include "Resource.h"
+
+struct aiMesh;
+struct aiNode;
+struct aiScene;
+
+namespace vv
+{
+  struct MeshVertex
+  {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 tex_coord;
+    glm::vec3 tangent;
+  };
+
+  /* Kept in a second stream so static meshes don't pay for it */
+  struct SkinVertex
+  {
+    uint8_t bone_ids[4];
+    glm::vec4 bone_weights;
+  };
+
+  struct MeshMaterial
+  {
+    std::string name;
+    glm::vec3 diffuse_color;
+    glm::vec3 specular_color;
+    float shininess;
+    float opacity;
+    std::string diffuse_map; /* relative to the mesh file */
+    std::string normal_map;
+    std::string specular_map;
+  };
+
+  struct Submesh
+  {
+    GLuint first_index;
+    GLuint index_count;
+    unsigned int material; /* index into getMaterials() for obj files, the source file's index otherwise */
+  };
+
+  /* All submeshes of a file share one vertex and one index buffer, indices are already
+     offset so every submesh draws from the start of the vertex buffer */
+  class Mesh : public Resource
+  {
+    friend class ObjLoader;
+
+  public:
+    /* Palette slots per mesh, bone ids are stored as bytes */
+    static const size_t MAX_BONES = 256;
+
+    Mesh(std::string path, std::string name);
+    ~Mesh();
+
+    /* Imports geometry, bones and animations into system memory, nothing is uploaded yet */
+    bool init();
+    bool upload();
+
+    void draw();
+    void draw(size_t submesh);
+
+    Handle getHandle() const;
+    GLuint getVertexArray() const;
+    const std::vector<Submesh>& getSubmeshes() const;
+    const AABB& getBounds() const;
+    const std::vector<MeshMaterial>& getMaterials() const; /* only filled by the obj importer so far */
+    size_t getVertexCount() const;
+    size_t getIndexCount() const;
+    float getUvDensity() const; /* texture coordinate units per model space unit */
+
+    bool isSkinned() const;
+    const Skeleton* getSkeleton() const;
+    size_t getAnimationCount() const;
+    const AnimationClip* getAnimation(size_t i) const;
+    const AnimationClip* getAnimation(const std::string &name) const;
+
+  private:
+    GLuint vao_;
+    GLuint vertex_buffer_;
+    GLuint skin_buffer_;
+    GLuint index_buffer_;
+
+    std::vector<MeshVertex> vertices_;
+    std::vector<SkinVertex> skin_;
+    std::vector<GLuint> indices_;
+    std::vector<Submesh> submeshes_;
+    std::vector<MeshMaterial> materials_;
+    AABB bounds_;
+    float uv_density_;
+
+    Skeleton *skeleton_;
+    std::vector<AnimationClip *> animations_;
+
+    Mesh(const Mesh&);
+    Mesh& operator=(const Mesh&);
+
+    bool importAssimp();
+    void loadGeometry(const aiMesh *mesh);
+    void loadSkeleton(const aiNode *node, int parent);
+    bool loadBones(const aiMesh *mesh, size_t base_vertex, std::unordered_map<std::string, int> &slots);
+    void loadAnimations(const aiScene *scene);
+    void computeUvDensity();
+    void release();
+  };
+}
+
+#endif // VIRTUALVISTA_MESH_H
\ No newline at end of file
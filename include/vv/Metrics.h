@@ -0,0 +1,169 @@
+
+#ifndef VIRTUALVISTA_METRICS_H
+#define VIRTUALVISTA_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace vv
+{
+  enum MetricType
+  {
+    METRIC_COUNTER   = 0,
+    METRIC_GAUGE     = 1,
+    METRIC_HISTOGRAM = 2
+  };
+
+  enum MetricsFormat
+  {
+    METRICS_PROMETHEUS = 0, /* text exposition format 0.0.4 */
+    METRICS_JSON       = 1
+  };
+
+  typedef std::vector<std::pair<std::string, std::string> > MetricLabels;
+
+  class Metric
+  {
+    friend class MetricsRegistry;
+
+  public:
+    virtual ~Metric() {}
+
+    const std::string& getName() const;
+    MetricType getType() const;
+
+  protected:
+    Metric(const std::string &name, const std::string &help, const MetricLabels &labels, MetricType type);
+
+  private:
+    std::string name_;
+    std::string help_;
+    MetricLabels labels_;
+    MetricType type_;
+  };
+
+  /* Only ever goes up */
+  class Counter : public Metric
+  {
+    friend class MetricsRegistry;
+
+  public:
+    void add(uint64_t amount = 1) { value_.fetch_add(amount, std::memory_order_relaxed); }
+    uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> value_;
+
+    Counter(const std::string &name, const std::string &help, const MetricLabels &labels);
+  };
+
+  class Gauge : public Metric
+  {
+    friend class MetricsRegistry;
+
+  public:
+    void set(double value);
+    double get() const;
+
+  private:
+    std::atomic<uint64_t> bits_; /* the double's bit pattern, atomic doubles aren't lock-free everywhere */
+
+    Gauge(const std::string &name, const std::string &help, const MetricLabels &labels);
+  };
+
+  /* Fixed upper bounds chosen at registration. Buckets are read one by one, so a snapshot
+     taken mid-observe can be off by that one sample, which scrapers tolerate. */
+  class Histogram : public Metric
+  {
+    friend class MetricsRegistry;
+
+  public:
+    void observe(double value);
+
+    const std::vector<double>& getBounds() const;
+    uint64_t getBucket(size_t i) const; /* not cumulative, the last one counts everything above */
+    uint64_t getCount() const;
+    double getSum() const;
+
+  private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_bits_;
+
+    Histogram(const std::string &name, const std::string &help, const MetricLabels &labels,
+              const std::vector<double> &bounds);
+  };
+
+  /* Registration takes a lock and allocates, so it belongs to startup. The returned handles
+     stay valid for the lifetime of the program and updating them is a relaxed atomic op,
+     cheap enough for every frame and safe from any thread. */
+  class MetricsRegistry
+  {
+  public:
+    static MetricsRegistry* instance();
+
+    /* Asking for a name and label set that already exists returns the same metric */
+    Counter* counter(const std::string &name, const std::string &help, const MetricLabels &labels = MetricLabels());
+    Gauge* gauge(const std::string &name, const std::string &help, const MetricLabels &labels = MetricLabels());
+    Histogram* histogram(const std::string &name, const std::string &help, const std::vector<double> &bounds,
+                         const MetricLabels &labels = MetricLabels());
+
+    void write(std::ostream &out, MetricsFormat format) const;
+    size_t getMetricCount() const;
+
+  private:
+    static MetricsRegistry* instance_;
+
+    mutable std::mutex mutex_;
+    std::vector<Metric *> metrics_;
+
+    MetricsRegistry();
+    ~MetricsRegistry();
+    MetricsRegistry(MetricsRegistry const&);
+    MetricsRegistry& operator=(MetricsRegistry const&);
+
+    Metric* find(const std::string &name, const MetricLabels &labels, MetricType type) const;
+    void writePrometheus(std::ostream &out) const;
+    void writeJson(std::ostream &out) const;
+  };
+
+  /* Serves registry snapshots over a unix domain socket from its own thread. A client that
+     sends "json" gets JSON, an http GET gets a full http response, and anything else,
+     including sending nothing at all, gets prometheus text:
+       curl --unix-socket <path> http://localhost/metrics
+       echo json | socat - UNIX-CONNECT:<path> */
+  class MetricsServer
+  {
+  public:
+    MetricsServer();
+    ~MetricsServer();
+
+    bool start(const std::string &socket_path);
+    void stop();
+    bool isRunning() const;
+    uint64_t getRequestCount() const;
+
+  private:
+    std::string socket_path_;
+    int socket_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> requests_;
+
+    MetricsServer(MetricsServer const&);
+    MetricsServer& operator=(MetricsServer const&);
+
+    void serveLoop();
+    void serveClient(int client);
+  };
+}
+
+#endif // VIRTUALVISTA_METRICS_H
\ No newline at end of file
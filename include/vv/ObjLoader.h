@@ -0,0 +1,80 @@
+
+#ifndef VIRTUALVISTA_OBJLOADER_H
+#define VIRTUALVISTA_OBJLOADER_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "Mesh.h"
+
+namespace vv
+{
+  struct ObjStats
+  {
+    size_t chunks;
+    size_t positions;
+    size_t normals;
+    size_t tex_coords;
+    size_t triangles;
+    size_t vertices;      /* after deduplication */
+    double map_time;      /* in milliseconds */
+    double parse_time;    /* in milliseconds */
+    double build_time;    /* in milliseconds */
+  };
+
+  /* Wavefront obj/mtl importer. The file is memory mapped, cut into chunks at line ends
+     and parsed by every worker at once, then the chunks are stitched together and the
+     corners deduplicated into one interleaved vertex buffer. */
+  class ObjLoader
+  {
+  public:
+    ObjLoader();
+
+    /* Fills the mesh's geometry and materials. Fails on files without normals, so the
+       caller can hand them to a generic importer that generates them. */
+    bool load(const std::string &path, const std::string &name, Mesh &mesh);
+
+    const ObjStats& getStats() const;
+
+    /* Parses a decimal float in [begin, end), returns the position after it */
+    static const char* parseFloat(const char *begin, const char *end, float &value);
+
+  private:
+    /* Zero based indices, relative ones still need the chunk's offset added */
+    struct Corner
+    {
+      int32_t position;
+      int32_t tex_coord; /* -1 when missing */
+      int32_t normal;
+      uint8_t relative;  /* bit per index, set when written as a negative index */
+    };
+
+    struct Chunk
+    {
+      const char *begin;
+      const char *end;
+
+      std::vector<glm::vec3> positions;
+      std::vector<glm::vec3> normals;
+      std::vector<glm::vec2> tex_coords;
+      std::vector<Corner> corners; /* three per triangle */
+      std::vector<std::pair<size_t, std::string> > material_changes; /* first triangle, name */
+      std::vector<std::string> libraries;
+      bool failed;
+    };
+
+    std::vector<Chunk> chunks_;
+    ObjStats stats_;
+
+    void parseChunk(Chunk &chunk);
+    bool parseMaterials(const std::string &file, std::vector<MeshMaterial> &materials);
+    bool build(Mesh &mesh);
+  };
+}
+
+#endif // VIRTUALVISTA_OBJLOADER_H
\ No newline at end of file
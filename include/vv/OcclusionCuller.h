@@ -0,0 +1,92 @@
+
+#ifndef VIRTUALVISTA_OCCLUSIONCULLER_H
+#define VIRTUALVISTA_OCCLUSIONCULLER_H
+
+#include <set>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "AABB.h"
+#include "Entity.h"
+
+namespace vv
+{
+  struct OcclusionStats
+  {
+    size_t occluders;
+    size_t occluder_triangles;
+    size_t entities_tested;
+    size_t entities_occluded;
+    double rasterize_time; /* in milliseconds */
+    double test_time;      /* in milliseconds */
+  };
+
+  class OcclusionCuller
+  {
+  public:
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    /* Resolution is rounded up to whole tiles */
+    bool init(int width, int height);
+
+    void beginFrame(const glm::mat4 &view_projection);
+
+    /* Geometry has to stay alive until rasterizeOccluders() returns. Large, simple,
+       closed meshes (walls, floors, terrain) make the best occluders. */
+    void addOccluder(const glm::vec3 *positions, const unsigned int *indices,
+                     size_t index_count, const glm::mat4 &model);
+
+    void rasterizeOccluders();
+
+    /* Conservative: anything touching the near plane or partially uncovered is visible */
+    bool isOccluded(const AABB &world_bounds) const;
+
+    /* Expects frustum visibility to already be set, only renderable entities are tested */
+    void cull(const std::set<Entity *> &entities);
+
+    const OcclusionStats& getStats() const;
+    const float* getDepthBuffer() const; /* tile-major, see depthIndex() */
+
+  private:
+    struct Occluder
+    {
+      const glm::vec3 *positions;
+      const unsigned int *indices;
+      size_t index_count;
+      glm::mat4 model;
+    };
+
+    struct ScreenTriangle
+    {
+      float edge_a[3], edge_b[3], edge_c[3]; /* edge function i = a * x + b * y + c */
+      float depth_a, depth_b, depth_c;       /* ndc depth plane */
+      int min_x, min_y, max_x, max_y;
+    };
+
+    int width_;
+    int height_;
+    int tiles_x_;
+    int tiles_y_;
+
+    glm::mat4 view_projection_;
+    std::vector<float> depth_;
+    std::vector<Occluder> occluders_;
+    std::vector<ScreenTriangle> triangles_;
+    std::vector<std::vector<unsigned int> > tile_bins_;
+    std::vector<Entity *> candidates_;
+
+    OcclusionStats stats_;
+
+    OcclusionCuller(OcclusionCuller const&);
+    OcclusionCuller& operator=(OcclusionCuller const&);
+
+    size_t depthIndex(int x, int y) const;
+    void setupTriangles();
+    void rasterizeTile(int tile);
+  };
+}
+
+#endif // VIRTUALVISTA_OCCLUSIONCULLER_H
\ No newline at end of file
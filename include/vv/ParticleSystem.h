@@ -0,0 +1,164 @@
+
+#ifndef VIRTUALVISTA_PARTICLESYSTEM_H
+#define VIRTUALVISTA_PARTICLESYSTEM_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "Shader.h"
+
+namespace vv
+{
+  struct EmitterSettings
+  {
+    size_t capacity;      /* hard limit, storage for it is allocated up front */
+    float emission_rate;  /* particles per second */
+    float lifetime_min;   /* in seconds */
+    float lifetime_max;
+    glm::vec3 spawn_extent; /* half size of the box particles spawn in */
+    glm::vec3 velocity_min;
+    glm::vec3 velocity_max;
+    glm::vec3 acceleration;
+    float drag;
+    float size_start;
+    float size_end;
+    glm::vec4 color_start;
+    glm::vec4 color_end;
+    bool additive;
+
+    EmitterSettings() :
+      capacity(10000),
+      emission_rate(1000.0f),
+      lifetime_min(1.0f),
+      lifetime_max(2.0f),
+      spawn_extent(0.0f),
+      velocity_min(-1.0f, 2.0f, -1.0f),
+      velocity_max(1.0f, 4.0f, 1.0f),
+      acceleration(0.0f, -9.81f, 0.0f),
+      drag(0.1f),
+      size_start(0.1f),
+      size_end(0.0f),
+      color_start(1.0f),
+      color_end(1.0f, 1.0f, 1.0f, 0.0f),
+      additive(true)
+    {
+    }
+  };
+
+  /* Particles live in parallel float arrays, alive ones always packed at the front.
+     Nothing is allocated after construction. */
+  class ParticleEmitter
+  {
+    friend class ParticleSystem;
+
+  public:
+    ParticleEmitter(const EmitterSettings &settings);
+
+    void setPosition(const glm::vec3 &position);
+    const glm::vec3& getPosition() const;
+    void setEmitting(bool emitting);
+    const EmitterSettings& getSettings() const;
+
+    /* Spawns a burst on top of the continuous rate, clamped to the free capacity */
+    void emit(size_t count);
+
+    size_t getCount() const;
+    size_t getCapacity() const;
+
+  private:
+    EmitterSettings settings_;
+    glm::vec3 position_;
+    bool emitting_;
+    float emission_accumulator_;
+    uint32_t random_state_;
+
+    size_t count_;
+    std::vector<float> position_x_;
+    std::vector<float> position_y_;
+    std::vector<float> position_z_;
+    std::vector<float> velocity_x_;
+    std::vector<float> velocity_y_;
+    std::vector<float> velocity_z_;
+    std::vector<float> age_;
+    std::vector<float> lifetime_;
+
+    size_t stream_offset_; /* first instance of this emitter in the stream buffer */
+
+    ParticleEmitter(const ParticleEmitter&);
+    ParticleEmitter& operator=(const ParticleEmitter&);
+
+    void simulate(size_t begin, size_t end, float delta_time);
+    void compact();
+    void spawn(float delta_time);
+    void spawnParticles(size_t count);
+    void writeInstances(size_t begin, size_t end, float *out) const;
+    float random(float min, float max);
+  };
+
+  struct ParticleStats
+  {
+    size_t emitters;
+    size_t particles;
+    double simulate_time; /* in milliseconds */
+    double upload_time;   /* in milliseconds */
+  };
+
+  /* Owns every emitter, simulates them as one batch of jobs and draws each emitter as a
+     single instanced billboard call */
+  class ParticleSystem
+  {
+  public:
+    ParticleSystem();
+    ~ParticleSystem();
+
+    bool init();
+
+    ParticleEmitter* createEmitter(const EmitterSettings &settings);
+    void destroyEmitter(ParticleEmitter *emitter);
+
+    void update(float delta_time); /* in seconds */
+    void render(const glm::mat4 &view, const glm::mat4 &projection);
+
+    const ParticleStats& getStats() const;
+
+  private:
+    struct SimulationJob
+    {
+      ParticleEmitter *emitter;
+      size_t begin;
+      size_t end;
+    };
+
+    /* Particles per job, a multiple of the simd width */
+    static const size_t JOB_SIZE = 16384;
+
+    std::vector<ParticleEmitter *> emitters_;
+    std::vector<SimulationJob> jobs_;
+
+    Shader *shader_;
+    GLuint vao_;
+    GLuint stream_buffer_;
+    size_t stream_capacity_; /* in instances */
+
+    GLint view_location_;
+    GLint projection_location_;
+    GLint size_range_location_;
+    GLint color_start_location_;
+    GLint color_end_location_;
+
+    ParticleStats stats_;
+
+    ParticleSystem(const ParticleSystem&);
+    ParticleSystem& operator=(const ParticleSystem&);
+
+    void buildJobs();
+    void upload();
+  };
+}
+
+#endif // VIRTUALVISTA_PARTICLESYSTEM_H
\ No newline at end of file
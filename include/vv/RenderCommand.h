@@ -0,0 +1,92 @@
+
+#ifndef VIRTUALVISTA_RENDERCOMMAND_H
+#define VIRTUALVISTA_RENDERCOMMAND_H
+
+#include <cstdint>
+
+namespace vv
+{
+  /* 64-bit sort key, most significant first:
+     pass (4) | shader (12) | material (16) | mesh (16) | depth (16) */
+  typedef uint64_t SortKey;
+
+  enum RenderPass
+  {
+    PASS_OPAQUE      = 0,
+    PASS_ALPHA_TEST  = 1,
+    PASS_TRANSPARENT = 2, /* depth is flipped so it draws back to front */
+    PASS_OVERLAY     = 3
+  };
+
+  enum RenderCommandType
+  {
+    COMMAND_BIND_MATERIAL = 0,
+    COMMAND_SET_UNIFORM   = 1,
+    COMMAND_DRAW          = 2
+  };
+
+  enum UniformType
+  {
+    UNIFORM_FLOAT = 0,
+    UNIFORM_VEC3  = 1,
+    UNIFORM_VEC4  = 2,
+    UNIFORM_MAT4  = 3,
+    UNIFORM_INT   = 4  /* bits stored in data[0] */
+  };
+
+  struct BindMaterialPacket
+  {
+    uint32_t shader;
+    uint32_t material;
+  };
+
+  struct SetUniformPacket
+  {
+    uint32_t uniform; /* id handed out by the backend */
+    UniformType type;
+    float data[16];
+  };
+
+  struct DrawPacket
+  {
+    uint32_t mesh;
+    uint32_t first_index;
+    uint32_t index_count; /* 0 draws the whole mesh */
+    uint32_t instance_count;
+  };
+
+  /* Plain data only, nothing here may reference graphics api objects directly */
+  struct RenderCommand
+  {
+    SortKey key;
+    RenderCommandType type;
+    union
+    {
+      BindMaterialPacket bind_material;
+      SetUniformPacket set_uniform;
+      DrawPacket draw;
+    };
+  };
+
+  inline SortKey makeSortKey(RenderPass pass, uint32_t shader, uint32_t material, uint32_t mesh, float depth)
+  {
+    // depth arrives normalized to [0, 1]
+    if (depth < 0.0f) depth = 0.0f;
+    if (depth > 1.0f) depth = 1.0f;
+
+    uint32_t depth_bits = (uint32_t)(depth * 65535.0f);
+    if (pass == PASS_TRANSPARENT)
+      depth_bits = 65535 - depth_bits;
+
+    return ((SortKey)(pass & 0xf) << 60) |
+           ((SortKey)(shader & 0xfff) << 48) |
+           ((SortKey)(material & 0xffff) << 32) |
+           ((SortKey)(mesh & 0xffff) << 16) |
+           (SortKey)depth_bits;
+  }
+
+  inline uint32_t sortKeyShader(SortKey key)   { return (uint32_t)(key >> 48) & 0xfff; }
+  inline uint32_t sortKeyMaterial(SortKey key) { return (uint32_t)(key >> 32) & 0xffff; }
+}
+
+#endif // VIRTUALVISTA_RENDERCOMMAND_H
\ No newline at end of file
@@ -0,0 +1,96 @@
+
+#ifndef VIRTUALVISTA_RENDERQUEUE_H
+#define VIRTUALVISTA_RENDERQUEUE_H
+
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <glm/vec3.hpp>
+
+#include "RenderCommand.h"
+
+namespace vv
+{
+  /* Executes sorted commands, the only place that knows about the graphics api */
+  class RenderBackend
+  {
+  public:
+    virtual ~RenderBackend() {}
+
+    virtual void beginSubmit() = 0;
+    virtual void execute(const RenderCommand &command) = 0;
+    virtual void endSubmit() = 0;
+  };
+
+  /* Written by exactly one thread at a time */
+  class CommandBuffer
+  {
+  public:
+    CommandBuffer();
+
+    void bindMaterial(SortKey key, uint32_t shader, uint32_t material);
+    void setUniform(SortKey key, uint32_t uniform, int value);
+    void setUniform(SortKey key, uint32_t uniform, float value);
+    void setUniform(SortKey key, uint32_t uniform, const glm::vec3 &value);
+    void setUniform(SortKey key, uint32_t uniform, const glm::vec4 &value);
+    void setUniform(SortKey key, uint32_t uniform, const glm::mat4 &value);
+    void draw(SortKey key, uint32_t mesh, uint32_t instance_count = 1,
+              uint32_t first_index = 0, uint32_t index_count = 0);
+
+    void clear();
+    size_t size() const;
+    const RenderCommand& operator[](size_t i) const;
+
+  private:
+    std::vector<RenderCommand> commands_;
+
+    RenderCommand& push(SortKey key, RenderCommandType type);
+  };
+
+  struct RenderQueueStats
+  {
+    size_t commands;
+    size_t draws;
+    double sort_time;   /* in milliseconds */
+    double submit_time; /* in milliseconds */
+  };
+
+  class RenderQueue
+  {
+  public:
+    RenderQueue(size_t buffer_count);
+    ~RenderQueue();
+
+    size_t getBufferCount() const;
+    CommandBuffer& getBuffer(size_t i);
+
+    /* Merges every buffer into one key order. Stable, so commands sharing a key keep the
+       order they were recorded in, which is what ties a uniform to the draw after it. */
+    void sort();
+    void submit(RenderBackend &backend);
+    void reset();
+
+    const RenderQueueStats& getStats() const;
+
+  private:
+    static const int INDEX_BUFFER_SHIFT = 24;
+    static const uint32_t INDEX_COMMAND_MASK = (1u << 24) - 1;
+
+    std::vector<CommandBuffer> buffers_;
+
+    std::vector<SortKey> keys_;
+    std::vector<uint32_t> order_; /* buffer << 24 | command */
+    std::vector<SortKey> scratch_keys_;
+    std::vector<uint32_t> scratch_order_;
+
+    RenderQueueStats stats_;
+
+    RenderQueue(RenderQueue const&);
+    RenderQueue& operator=(RenderQueue const&);
+
+    void radixSort();
+  };
+}
+
+#endif // VIRTUALVISTA_RENDERQUEUE_H
\ No newline at end of file
@@ -4,7 +4,10 @@
 
 #include <unordered_map>
 
+#include "Mesh.h"
 #include "Shader.h"
+#include "ShaderVariantCache.h"
+#include "Texture.h"
 
 namespace vv
 {
@@ -16,15 +19,31 @@ namespace vv
 
     Handle addShader(std::string name, std::string path);
     void removeShader(Handle handle);
+    ShaderVariantCache* addShaderVariants(std::string path, std::string name);
 
     bool loadMeshFromFile(std::string path, std::string name);
     bool loadTextureFromFile(std::string path, std::string name);
 
+    /* For resources decoded on another thread, the mesh is uploaded here. Both take ownership,
+       if the handle is already loaded the copy is deleted and the loaded one gains a use. */
+    bool addMesh(Mesh *mesh);
+    bool addTexture(Texture *texture);
+    bool useMesh(const Handle &handle); /* another use of a loaded resource, false if it isn't */
+    bool useTexture(const Handle &handle);
+
+    void unloadMesh(const Handle &handle);
+    void unloadTexture(const Handle &handle);
+    Mesh* getMesh(const Handle &handle);
+    Texture* getTexture(const Handle &handle);
+
     void clearResources();
 
   private:
 	  // todo: this class needs to load, cache/arrange, and dispose of all resources automatically.
 	  std::unordered_map<Handle, Shader *> shader_buffer_;
+    std::unordered_map<Handle, ShaderVariantCache *> shader_variant_buffer_;
+    std::unordered_map<Handle, Mesh *> mesh_buffer_;
+    std::unordered_map<Handle, Texture *> texture_buffer_;
 
     ResourceManager(ResourceManager const&) {};
     ResourceManager& operator=(ResourceManager const&) {};
@@ -4,20 +4,66 @@
 
 #include <set>
 
+#include <unordered_map>
+#include <vector>
+
+#include "AABBTree.h"
+#include "AnimationSystem.h"
 #include "Entity.h"
+#include "OcclusionCuller.h"
+#include "ParticleSystem.h"
+#include "RenderQueue.h"
 #include "ResourceManager.h"
+#include "TextureStreamer.h"
+#include "WorldStreamer.h"
 
 namespace vv
 {
   class Scene
   {
   public:
-    Scene();
+    Scene(ResourceManager *resource_manager);
     ~Scene();
 
     void instantiateCamera();
     void instantiateModel();
 
+    /* Partitioned worlds are streamed in cell by cell around the camera instead of loaded whole */
+    bool enableStreaming(std::string cell_directory, const StreamingSettings &settings);
+    WorldStreamer* getStreamer();
+
+    /* Streamed textures keep only the mips that recorded entities reported as visible */
+    bool enableTextureStreaming(const TextureStreamingSettings &settings);
+    TextureStreamer* getTextureStreamer();
+    AnimationSystem* getAnimationSystem();
+    ParticleSystem* getParticleSystem();
+
+    /* Occluders are rasterized into a small CPU depth buffer and hide the entities behind them */
+    bool enableOcclusionCulling(int width, int height);
+    OcclusionCuller* getOcclusionCuller();
+
+    /* The geometry is model space and has to stay alive while the entity is in the scene */
+    void addOccluder(Entity *entity, const glm::vec3 *positions, const unsigned int *indices,
+                     size_t index_count);
+
+    /* Also sets frustum visibility, and occlusion when enabled, for the next recordCommands() */
+    void update(glm::vec3 camera_position, const glm::mat4 &view_projection);
+
+    void addEntity(Entity *entity);
+    void removeEntity(Entity *entity);
+    const std::set<Entity *>& getEntities() const;
+
+    /* Answered by the spatial tree, which update() keeps in sync with moved transforms */
+    Entity* pick(const Ray &ray, float *distance = nullptr) const;
+    void queryOverlap(const AABB &bounds, std::vector<Entity *> &entities) const;
+    const AABBTree* getSpatialTree() const;
+
+    /* Spreads the entities over the queue's buffers and records them in parallel. With texture
+       streaming enabled this is also the feedback pass, the projection and viewport height turn
+       every recorded entity's streamed textures into the mip level they need. */
+    void recordCommands(RenderQueue &queue, glm::vec3 camera_position, const glm::mat4 &projection,
+                        int viewport_height);
+
     /* This will come in handy when considering XML/Collada scene structures */
     bool loadSceneFromFile();
     void saveSceneToFile();
@@ -25,8 +71,30 @@ namespace vv
   private:
     bool currently_used_;
     ResourceManager *resource_manager_;
+    WorldStreamer *streamer_;
+    TextureStreamer *texture_streamer_;
+    AnimationSystem *animation_system_;
+    ParticleSystem *particle_system_;
+    OcclusionCuller *occlusion_culler_;
+
+    struct SceneOccluder
+    {
+      Entity *entity;
+      const glm::vec3 *positions;
+      const unsigned int *indices;
+      size_t index_count;
+    };
 
     std::set<Entity *> entities_;
+    std::vector<Entity *> renderable_; /* recordCommands() scratch, kept to stay off the heap */
+    std::vector<SceneOccluder> occluders_;
+
+    AABBTree *spatial_tree_;
+    std::unordered_map<Entity *, int> proxies_;
+
+    static AABB spatialBounds(Entity *entity);
+    void refitSpatialTree();
+    void cullEntities(const glm::mat4 &view_projection);
   };
 }
 
@@ -28,15 +28,26 @@ namespace vv
                      const int height);
 
     void setFieldOfView(const float fov);
+    void setMultisamples(const int samples);
     void setClipDistance(const float near, const float far);
+    void setDynamicResolution(const bool enabled,
+                              const float min_scale,
+                              const float max_scale,
+                              const double target_frame_time);
+    void setFastObjImport(const bool enabled);
+    void setGpuCulling(const bool enabled);
 
     std::string getShaderLocation() const;
     std::string getAssetsLocation() const;
     float getCameraType() const;
     void getViewport(int &x, int &y, int &width, int &height) const;
     void getPerspective(float &fov, float &aspect, float &near, float &far) const;
+    int getMultisamples() const;
     double getMovementSpeed() const;
     double getRotationSpeed() const;
+    bool getDynamicResolution(float &min_scale, float &max_scale, double &target_frame_time) const;
+    bool getFastObjImport() const;
+    bool getGpuCulling() const;
 
 
   private:
@@ -67,6 +78,16 @@ namespace vv
     double rotation_speed_;
 
     int max_lights_in_scene_;
+    int multisamples_; /* 0 turns msaa off */
+
+    // Dynamic resolution
+    bool dynamic_resolution_;
+    float min_resolution_scale_;
+    float max_resolution_scale_;
+    double target_frame_time_; /* in milliseconds */
+
+    bool fast_obj_import_; /* assimp still handles every other format */
+    bool gpu_culling_;     /* asks for a 4.3 context for an IndirectRenderer, falls back to 3.3 */
 
     Settings();
     Settings(const Settings& s);
@@ -17,15 +17,17 @@ namespace vv
     ~Shader();
 
     bool init();
+    bool initFromSource(const std::string &vert_source, const std::string &frag_source);
 
     GLuint getProgramId() const;
     void useProgram();
     GLint getUniformLocation(std::string name) const;
 
+    static std::string loadShaderFromFile(const std::string filename);
+
   private:
     GLuint program_id_;
 
-    std::string loadShaderFromFile(const std::string filename);
     bool createProgram(std::string vert_source, std::string frag_source);
   };
 }
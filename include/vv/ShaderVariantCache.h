@@ -0,0 +1,70 @@
+
+#ifndef VIRTUALVISTA_SHADERVARIANTCACHE_H
+#define VIRTUALVISTA_SHADERVARIANTCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Shader.h"
+
+namespace vv
+{
+  /* Low byte holds the light count bucket, the remaining bits are feature flags */
+  typedef uint64_t ShaderKey;
+
+  const ShaderKey SHADER_LIGHT_BUCKET_MASK      = 0xff;
+  const ShaderKey SHADER_FEATURE_NORMAL_MAPPING = 1ull << 8;
+  const ShaderKey SHADER_FEATURE_ALPHA_TEST     = 1ull << 9;
+  const ShaderKey SHADER_FEATURE_INSTANCING     = 1ull << 10;
+  const ShaderKey SHADER_FEATURE_TEXTURE_ARRAY  = 1ull << 11;
+  const ShaderKey SHADER_FEATURE_SKINNING       = 1ull << 12;
+  const ShaderKey SHADER_FEATURE_INDIRECT       = 1ull << 13;
+
+  class ShaderVariantCache
+  {
+  public:
+    ShaderVariantCache(std::string path, std::string name);
+    ~ShaderVariantCache();
+
+    /* Reads the sources once and collects the features they declare with a
+       "//! features: LIGHT_COUNT NORMAL_MAPPING ..." line */
+    bool init();
+
+    /* Compiles on first use, returns null if the variant fails to build */
+    Shader* getVariant(ShaderKey key);
+    size_t prebuild(const std::vector<ShaderKey> &keys);
+    std::vector<ShaderKey> getAllKeys() const;
+
+    /* Strips features the shader never declared so equivalent keys share one program */
+    ShaderKey sanitize(ShaderKey key) const;
+    ShaderKey getDeclaredFeatures() const;
+    size_t getVariantCount() const;
+
+    static ShaderKey makeKey(int light_count, ShaderKey features);
+    static int getLightCount(ShaderKey key);
+    static std::string buildDefines(ShaderKey key);
+
+  private:
+    std::string path_;
+    std::string name_;
+    std::string vert_source_;
+    std::string frag_source_;
+
+    bool declares_light_count_;
+    ShaderKey declared_features_;
+
+    std::unordered_map<ShaderKey, Shader *> variants_;
+    std::unordered_set<ShaderKey> failed_variants_;
+
+    ShaderVariantCache(ShaderVariantCache const&);
+    ShaderVariantCache& operator=(ShaderVariantCache const&);
+
+    void parseDeclarations(const std::string &source);
+    static std::string injectDefines(const std::string &source, const std::string &defines);
+  };
+}
+
+#endif // VIRTUALVISTA_SHADERVARIANTCACHE_H
\ No newline at end of file
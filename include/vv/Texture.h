@@ -0,0 +1,87 @@
+
+#ifndef VIRTUALVISTA_TEXTURE_H
+#define VIRTUALVISTA_TEXTURE_H
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Resource.h"
+
+namespace vv
+{
+  struct MipLevel
+  {
+    int width;
+    int height;
+    size_t offset; /* into the mip chain file */
+    size_t size;   /* in bytes */
+  };
+
+  class Texture : public Resource
+  {
+  public:
+    /* Levels this small are loaded with a streamed texture and never dropped */
+    static const int TAIL_SIZE = 64;
+
+    Texture(std::string path, std::string name);
+    ~Texture();
+
+    /* Decodes the image into system memory, nothing is uploaded yet. A .vvtex mip chain
+       only reads its tail, the finer levels are left to the TextureStreamer. */
+    bool init();
+
+    /* GL_REPEAT by default. Only GL_CLAMP_TO_EDGE textures may share an atlas page, tiling
+       coordinates would sample their neighbours. Set before upload() or packing. */
+    void setWrapMode(GLint wrap);
+    GLint getWrapMode() const;
+
+    /* Standalone GL_TEXTURE_2D for textures that never get packed */
+    bool upload();
+    void releasePixels();
+
+    /* Offline side of streaming, writes the decoded image with its whole mip chain */
+    bool saveMipChain(std::string file) const;
+
+    /* Context thread only. Levels have to arrive one at a time, finest last, so the
+       texture stays complete between GL_TEXTURE_BASE_LEVEL and the tail. */
+    bool uploadMipLevel(int level, const std::vector<unsigned char> &pixels);
+    void dropMipLevels(int level); /* releases everything finer than level */
+
+    bool isStreamed() const;
+    int getMipCount() const;
+    int getTailLevel() const;
+    int getResidentLevel() const; /* finest level on the gpu */
+    const MipLevel& getMipLevel(int level) const;
+    size_t getResidentSize() const;
+    std::string getFileName() const;
+
+    Handle getHandle() const;
+    GLuint getTextureId() const;
+    int getWidth() const;
+    int getHeight() const;
+    int getChannels() const;
+    GLenum getFormat() const;
+    const std::vector<unsigned char>& getPixels() const;
+
+    static GLenum formatFromChannels(int channels);
+
+  private:
+    GLuint texture_id_;
+    int width_;
+    int height_;
+    int channels_;
+    GLint wrap_mode_;
+    std::vector<unsigned char> pixels_; /* only the tail for streamed textures */
+
+    std::vector<MipLevel> mips_; /* empty unless streamed */
+    int tail_level_;
+    int resident_level_;
+
+    bool readMipChain();
+    bool uploadMipChain();
+  };
+}
+
+#endif // VIRTUALVISTA_TEXTURE_H
\ No newline at end of file
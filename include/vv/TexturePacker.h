@@ -0,0 +1,102 @@
+
+#ifndef VIRTUALVISTA_TEXTUREPACKER_H
+#define VIRTUALVISTA_TEXTUREPACKER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+
+#include "ResourceManager.h"
+#include "Shader.h"
+#include "Texture.h"
+
+namespace vv
+{
+  enum TextureRole
+  {
+    TEXTURE_DIFFUSE    = 0,
+    TEXTURE_SPECULAR   = 1,
+    TEXTURE_NORMAL     = 2,
+    TEXTURE_REFLECTION = 3,
+    TEXTURE_ALPHA      = 4,
+    TEXTURE_ROLE_COUNT = 5
+  };
+
+  struct TextureSlot
+  {
+    GLuint array_id;   /* GL_TEXTURE_2D_ARRAY, 0 if the role is unused */
+    int layer;
+    glm::vec4 uv_rect; /* xy scale, zw offset, identity unless the texture sits in an atlas page */
+  };
+
+  struct PackedMaterial
+  {
+    TextureSlot slots[TEXTURE_ROLE_COUNT];
+  };
+
+  struct PackingStats
+  {
+    size_t textures_packed;
+    size_t texture_arrays;
+    size_t array_layers;
+    size_t atlas_pages;
+  };
+
+  class TexturePacker
+  {
+  public:
+    /* Textures are resolved through the resource manager when the packer is built, so
+       unloading one before that only drops it from the packing */
+    TexturePacker(ResourceManager *resource_manager, int atlas_size = 2048,
+                  int max_atlas_texture_size = 512, int atlas_padding = 4);
+    ~TexturePacker();
+
+    void addTexture(Handle texture);
+    void setMaterialTexture(std::string material, TextureRole role, Handle texture);
+
+    /* Same size, format and wrap mode textures become layers of one array, leftover small
+       clamped ones are atlased into array pages. Packed textures drop their system memory copy. */
+    bool build();
+
+    const TextureSlot* getSlot(Handle texture) const;
+    const PackedMaterial* getMaterial(std::string material) const;
+    const PackingStats& getStats() const;
+
+    /* Expects the TEXTURE_ARRAY shader variant */
+    void bindMaterial(const PackedMaterial &material, Shader *shader) const;
+
+  private:
+    struct PendingSlot
+    {
+      Texture *texture;
+      int layer;
+      int x, y; /* placement inside an atlas page */
+    };
+
+    ResourceManager *resource_manager_;
+    int atlas_size_;
+    int max_atlas_texture_size_;
+    int atlas_padding_;
+    bool built_;
+
+    std::vector<Handle> textures_;
+    std::unordered_map<Handle, TextureSlot> slots_;
+    std::unordered_map<std::string, std::vector<std::pair<TextureRole, Handle> > > material_textures_;
+    std::unordered_map<std::string, PackedMaterial> materials_;
+    std::vector<GLuint> arrays_;
+    PackingStats stats_;
+
+    TexturePacker(TexturePacker const&);
+    TexturePacker& operator=(TexturePacker const&);
+
+    void buildArray(const std::vector<Texture *> &textures);
+    void buildAtlas(std::vector<Texture *> textures);
+    GLuint uploadArray(int width, int height, int channels, int layers,
+                       const std::vector<PendingSlot> &pending, GLint wrap, bool atlas);
+  };
+}
+
+#endif // VIRTUALVISTA_TEXTUREPACKER_H
\ No newline at end of file
@@ -0,0 +1,143 @@
+
+#ifndef VIRTUALVISTA_TEXTURESTREAMER_H
+#define VIRTUALVISTA_TEXTURESTREAMER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "AABB.h"
+#include "Entity.h"
+#include "Texture.h"
+
+namespace vv
+{
+  struct TextureStreamingSettings
+  {
+    size_t memory_budget;              /* bytes of streamed textures on the gpu, tails included */
+    int max_reads_in_flight;
+    size_t max_upload_bytes_per_frame;
+    int drop_hysteresis;               /* levels a texture may stay finer than it needs before mips are dropped */
+    float mip_bias;                    /* added to every estimate, positive values stream less */
+
+    TextureStreamingSettings() :
+      memory_budget(256 << 20),
+      max_reads_in_flight(4),
+      max_upload_bytes_per_frame(4 << 20),
+      drop_hysteresis(1),
+      mip_bias(0.0f)
+    {
+    }
+  };
+
+  struct TextureStreamingStats
+  {
+    size_t textures;
+    size_t resident_bytes;
+    size_t wanted_bytes;   /* what the feedback asked for before the budget was applied */
+    int budget_bias;       /* levels every texture was pushed down to stay within budget */
+    size_t reads_in_flight;
+    size_t levels_loaded;  /* total since the streamer was created */
+    size_t levels_dropped; /* total since the streamer was created */
+    size_t bytes_this_frame;
+  };
+
+  /* Keeps only the mips of streamed textures that the last frame could actually see */
+  class TextureStreamer
+  {
+  public:
+    TextureStreamer(const TextureStreamingSettings &settings);
+    ~TextureStreamer();
+
+    bool init();
+    void shutdown();
+
+    /* Textures have to be removed again before the resource manager unloads them */
+    void addTexture(Texture *texture);
+    void removeTexture(Texture *texture);
+
+    /* Feedback pass, every use of a texture during the frame is reported and the finest level
+       any of them needs wins. addUse() may be called from several threads while recording,
+       as long as no texture is added or removed in the meantime. */
+    void beginFeedback(const glm::vec3 &camera_position, const glm::mat4 &projection, int viewport_height);
+    void addUse(Texture *texture, const AABB &world_bounds, float uv_density);
+
+    /* Takes the density in model space, the entity's transform scales it to world space */
+    void addUse(Texture *texture, Entity *entity, float uv_density);
+
+    /* Context thread. Uploads finished reads, drops mips that aren't needed and queues new reads.
+       Reads and scratch lists are reused, so once warmed up it stays off the heap. */
+    void update();
+
+    int getWantedLevel(Texture *texture) const;
+    const TextureStreamingStats& getStats() const;
+
+  private:
+    struct MipRead
+    {
+      Texture *texture; /* never dereferenced by the io thread */
+      int level;
+      std::string file; /* copied from the entry into a pooled read, so it reuses its capacity */
+      size_t offset;
+      size_t size;
+      bool success;
+      std::vector<unsigned char> pixels;
+    };
+
+    struct StreamedTexture
+    {
+      Texture *texture;
+      std::string file;                /* read once from the texture, every request copies it */
+      std::vector<size_t> chain_sizes; /* bytes resident when a level is the finest one */
+      std::atomic<int> feedback_level;
+      int wanted_level;
+      int target_level;
+      MipRead *read; /* outstanding read, at most one per texture */
+    };
+
+    TextureStreamingSettings settings_;
+    TextureStreamingStats stats_;
+
+    glm::vec3 camera_position_;
+    float pixels_per_unit_; /* at a distance of one unit */
+
+    std::unordered_map<Texture *, StreamedTexture *> textures_;
+    std::vector<MipRead *> ready_;      /* read but not uploaded yet, oldest first */
+    std::vector<MipRead *> free_reads_; /* finished reads kept with their pixel storage */
+    std::vector<MipRead *> collected_;  /* update() scratch */
+    std::vector<StreamedTexture *> candidates_; /* update() scratch */
+    int reads_in_flight_;
+    size_t pending_bytes_;              /* requested and not uploaded or discarded yet */
+
+    // io thread
+    bool running_;
+    std::thread io_thread_;
+    std::mutex io_mutex_;
+    std::condition_variable io_condition_;
+    std::vector<MipRead *> read_requests_; /* oldest first */
+    std::vector<MipRead *> read_results_;
+
+    TextureStreamer(TextureStreamer const&);
+    TextureStreamer& operator=(TextureStreamer const&);
+
+    void collectReads();
+    void uploadReads();
+    void chooseTargets();
+    void dropLevels();
+    void requestReads();
+
+    MipRead* acquireRead();
+    void releaseRead(MipRead *read);
+
+    void ioLoop();
+    static bool readMip(MipRead *read);
+  };
+}
+
+#endif // VIRTUALVISTA_TEXTURESTREAMER_H
\ No newline at end of file
@@ -0,0 +1,79 @@
+
+#ifndef VIRTUALVISTA_THREADPOOL_H
+#define VIRTUALVISTA_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vv
+{
+  class ThreadPool
+  {
+  public:
+    static ThreadPool* instance();
+
+    size_t getWorkerCount() const;
+    size_t getQueuedJobs() const;   /* waiting for a worker, readable without the lock */
+    size_t getQueuedChunks() const; /* parallelFor chunks nobody has started yet, also lock-free */
+
+    void submit(std::function<void()> job);
+
+    /* Splits [0, count) into chunks of at least grain items, the calling thread helps and
+       returns once every chunk has run. Safe to call from inside a job. Nothing is copied
+       to the heap, so it may run inside the frame's allocation guard. */
+    template <typename Function>
+    void parallelFor(size_t count, size_t grain, const Function &function)
+    {
+      runParallelFor(count, grain, &invokeRange<Function>, &function);
+    }
+
+  private:
+    typedef void (*RangeFunction)(const void *function, size_t begin, size_t end);
+
+    /* Lives on the caller's stack, workers only join while it is listed in tasks_ */
+    struct ForTask
+    {
+      RangeFunction function;
+      const void *context;
+      size_t count;
+      size_t chunk_size;
+      size_t chunk_count;
+      std::atomic<size_t> next_chunk;
+      size_t helpers; /* workers running chunks, guarded by mutex_ */
+    };
+
+    bool running_;
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()> > jobs_;
+    std::vector<ForTask *> tasks_; /* capacity reserved up front, see MAX_FOR_TASKS */
+    std::atomic<size_t> queued_jobs_;
+    std::atomic<size_t> queued_chunks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::condition_variable task_done_;
+
+    ThreadPool(size_t worker_count);
+    ~ThreadPool();
+    ThreadPool(ThreadPool const&);
+    ThreadPool& operator=(ThreadPool const&);
+
+    void workerLoop();
+
+    template <typename Function>
+    static void invokeRange(const void *function, size_t begin, size_t end)
+    {
+      (*(const Function *)function)(begin, end);
+    }
+
+    void runParallelFor(size_t count, size_t grain, RangeFunction function, const void *context);
+    ForTask* findOpenTask() const;
+    void runChunks(ForTask &task);
+  };
+}
+
+#endif // VIRTUALVISTA_THREADPOOL_H
\ No newline at end of file
@@ -2,6 +2,8 @@
 #ifndef VIRTUALVISTA_TIME_H
 #define VIRTUALVISTA_TIME_H
 
+#include <cstddef>
+
 namespace vv
 {
   class Time 
@@ -25,8 +25,14 @@ namespace vv
     glm::vec3 getPosition();
     glm::mat3 getOrientation();
 
+    /* Set by every change, cleared by whoever consumes it (the scene's spatial tree) */
+    bool isDirty() const;
+    void markDirty();
+    void clearDirty();
+
   private:
     glm::mat4 homogeneous_transform_mat_;
+    bool dirty_;
   };
 }
 
@@ -0,0 +1,171 @@
+
+#ifndef VIRTUALVISTA_WORLDSTREAMER_H
+#define VIRTUALVISTA_WORLDSTREAMER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "ResourceManager.h"
+
+namespace vv
+{
+  enum CellState
+  {
+    CELL_UNLOADED  = 0,
+    CELL_READING   = 1, /* queued for or being read by the io thread */
+    CELL_PREFETCHED = 2, /* parsed and held in memory, nothing decoded or uploaded */
+    CELL_DECODING  = 3, /* queued for or having its assets decoded by the io thread */
+    CELL_UPLOADING = 4, /* decoded assets being uploaded over several frames */
+    CELL_RESIDENT  = 5,
+    CELL_FAILED    = 6  /* the cell file could not be parsed, nothing is loaded from it */
+  };
+
+  enum CellEntryType
+  {
+    CELL_ENTRY_MESH    = 0,
+    CELL_ENTRY_TEXTURE = 1
+  };
+
+  struct CellEntry
+  {
+    CellEntryType type;
+    std::string path;
+    std::string name;
+    Handle handle;
+
+    // streaming state, not part of the cell file
+    Resource *decoded;   /* decoded by the io thread, waiting for its upload */
+    size_t decoded_size; /* bytes the upload hands to the resource manager */
+    bool shared;         /* already loaded when the cell was queued, gains a use instead */
+    bool loaded;         /* holds a use in the resource manager */
+  };
+
+  struct WorldCell
+  {
+    int x;
+    int z;
+    CellState state;
+    bool cancelled; /* left the streaming radius while the io thread had it */
+    bool failed;    /* set by the io thread when the cell file is malformed */
+    size_t upload_cursor; /* next entry to hand to the resource manager */
+    std::vector<CellEntry> entries;
+  };
+
+  struct StreamingSettings
+  {
+    float cell_size;
+    int load_radius;          /* rings around the camera cell that are fully resident */
+    int prefetch_rings;       /* extra rings that are only read from disk */
+    int hysteresis_rings;     /* extra rings a cell may drift out before being evicted */
+    int max_reads_per_frame;  /* cell files handed to the io thread each frame */
+    int max_reads_in_flight;  /* cells being read or decoded by the io thread */
+    int max_loads_per_frame;  /* resources handed to the resource manager each frame */
+    size_t max_bytes_per_frame; /* decoded mesh and texture data uploaded each frame */
+
+    StreamingSettings() :
+      cell_size(64.0f),
+      load_radius(1),
+      prefetch_rings(1),
+      hysteresis_rings(1),
+      max_reads_per_frame(4),
+      max_reads_in_flight(8),
+      max_loads_per_frame(2),
+      max_bytes_per_frame(1 << 20)
+    {
+    }
+  };
+
+  struct StreamingStats
+  {
+    size_t cells_resident;
+    size_t cells_prefetched;
+    size_t cells_in_flight; /* being read or decoded */
+    size_t cells_evicted;   /* total since the streamer was created */
+    size_t cells_failed;    /* total since the streamer was created */
+    size_t cells_loaded;    /* total since the streamer was created */
+    size_t loads_this_frame;
+    size_t bytes_this_frame;
+  };
+
+  /* Cells only manage resource residency. They load the meshes and textures they list and
+     release them again, placing entities in the scene is left to whoever uses the resources.
+     The io thread reads cell files and decodes their assets, the context thread only uploads. */
+  class WorldStreamer
+  {
+  public:
+    WorldStreamer(ResourceManager *resource_manager, std::string directory,
+                  const StreamingSettings &settings);
+    ~WorldStreamer();
+
+    bool init();
+    void update(glm::vec3 camera_position);
+    void shutdown();
+
+    const StreamingStats& getStats() const;
+    std::string getCellFileName(int x, int z) const;
+
+    /* Offline side of the partitioning, writes one cell in the format read by the io thread */
+    bool saveCell(const WorldCell &cell) const;
+
+  private:
+    struct CellCandidate
+    {
+      int x;
+      int z;
+      int ring;
+    };
+
+    ResourceManager *resource_manager_;
+    std::string directory_;
+    StreamingSettings settings_;
+    StreamingStats stats_;
+
+    int camera_cell_x_;
+    int camera_cell_z_;
+    int reads_in_flight_;
+
+    /* Every tracked cell lies within the eviction limit of the camera cell, so a window of that
+       size wrapped around the grid gives each one its own slot, see slot() */
+    int window_size_;
+    std::vector<WorldCell *> cells_;
+    std::vector<WorldCell *> free_cells_;   /* released cells, reused by acquireCell() */
+    std::vector<WorldCell *> collected_;    /* update() scratch */
+    std::vector<WorldCell *> pending_;      /* update() scratch */
+    std::vector<CellCandidate> candidates_; /* update() scratch */
+
+    // io thread
+    bool running_;
+    std::thread io_thread_;
+    std::mutex io_mutex_;
+    std::condition_variable io_condition_;
+    std::vector<WorldCell *> read_requests_; /* oldest first */
+    std::vector<WorldCell *> read_results_;
+
+    WorldStreamer(WorldStreamer const&);
+    WorldStreamer& operator=(WorldStreamer const&);
+
+    size_t slot(int x, int z) const;
+    int ringDistance(const WorldCell *cell) const;
+
+    void requestCells();
+    void collectReads();
+    void issueLoads();
+    bool uploadEntry(const WorldCell *cell, CellEntry &entry);
+    void evictCells();
+    void unloadCell(WorldCell *cell);
+
+    WorldCell* acquireCell(int x, int z);
+    void releaseCell(WorldCell *cell);
+
+    void ioLoop();
+    bool readCell(WorldCell *cell) const;
+    static void decodeCell(WorldCell *cell);
+  };
+}
+
+#endif // VIRTUALVISTA_WORLDSTREAMER_H
\ No newline at end of file
@@ -0,0 +1,427 @@
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "vv/AABBTree.h"
+#include "vv/MemoryTracker.h"
+#include "vv/ThreadPool.h"
+
+namespace vv
+{
+  /* Fat boxes are stretched this many frames of displacement ahead */
+  static const float DISPLACEMENT_MULTIPLIER = 2.0f;
+
+  /* Queries handed to one job at a time in the batched calls */
+  static const size_t QUERY_GRAIN = 64;
+
+  /////////////////////////////////////////////////////////////////////// public
+  AABBTree::AABBTree(float margin) :
+    root_(NULL_NODE),
+    free_list_(NULL_NODE),
+    proxy_count_(0),
+    margin_(margin)
+  {
+  }
+
+
+  AABBTree::~AABBTree()
+  {
+  }
+
+
+  int AABBTree::createProxy(const AABB &bounds, void *user_data)
+  {
+    int proxy = allocateNode();
+
+    Node &node = nodes_[proxy];
+    node.bounds = AABB(bounds.min - glm::vec3(margin_), bounds.max + glm::vec3(margin_));
+    node.user_data = user_data;
+    node.height = 0;
+    proxy_bounds_[proxy] = bounds;
+
+    insertLeaf(proxy);
+    proxy_count_++;
+
+    return proxy;
+  }
+
+
+  void AABBTree::destroyProxy(int proxy)
+  {
+    assert(proxy >= 0 && proxy < (int)nodes_.size() && nodes_[proxy].isLeaf());
+
+    removeLeaf(proxy);
+    freeNode(proxy);
+    proxy_count_--;
+  }
+
+
+  bool AABBTree::moveProxy(int proxy, const AABB &bounds, const glm::vec3 &displacement)
+  {
+    assert(proxy >= 0 && proxy < (int)nodes_.size() && nodes_[proxy].isLeaf());
+
+    proxy_bounds_[proxy] = bounds;
+    if (nodes_[proxy].bounds.contains(bounds))
+      return false;
+
+    removeLeaf(proxy);
+
+    AABB fat(bounds.min - glm::vec3(margin_), bounds.max + glm::vec3(margin_));
+    glm::vec3 ahead = displacement * DISPLACEMENT_MULTIPLIER;
+    for (int i = 0; i < 3; ++i)
+    {
+      if (ahead[i] < 0.0f)
+        fat.min[i] += ahead[i];
+      else
+        fat.max[i] += ahead[i];
+    }
+
+    nodes_[proxy].bounds = fat;
+    insertLeaf(proxy);
+
+    return true;
+  }
+
+
+  void* AABBTree::getUserData(int proxy) const
+  {
+    return nodes_[proxy].user_data;
+  }
+
+
+  const AABB& AABBTree::getBounds(int proxy) const
+  {
+    return proxy_bounds_[proxy];
+  }
+
+
+  const AABB& AABBTree::getFatBounds(int proxy) const
+  {
+    return nodes_[proxy].bounds;
+  }
+
+
+  bool AABBTree::raycast(const Ray &ray, RayHit &hit) const
+  {
+    hit.proxy = NULL_NODE;
+    hit.user_data = nullptr;
+    hit.distance = ray.max_distance;
+    if (root_ == NULL_NODE) return false;
+
+    const glm::vec3 inverse_direction(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+    int stack[STACK_SIZE];
+    int count = 0;
+    stack[count++] = root_;
+
+    while (count > 0)
+    {
+      const Node &node = nodes_[stack[--count]];
+
+      // anything entered past the closest hit so far can't contain a closer one
+      float distance;
+      if (!node.bounds.intersectRay(ray.origin, inverse_direction, hit.distance, distance))
+        continue;
+
+      if (node.isLeaf())
+      {
+        int proxy = (int)(&node - &nodes_[0]);
+        if (proxy_bounds_[proxy].intersectRay(ray.origin, inverse_direction, hit.distance, distance))
+        {
+          hit.proxy = proxy;
+          hit.user_data = node.user_data;
+          hit.distance = distance;
+        }
+        continue;
+      }
+
+      assert(count + 2 <= STACK_SIZE);
+      stack[count++] = node.child1;
+      stack[count++] = node.child2;
+    }
+
+    return hit.proxy != NULL_NODE;
+  }
+
+
+  void AABBTree::overlap(const AABB &bounds, std::vector<int> &proxies) const
+  {
+    if (root_ == NULL_NODE) return;
+
+    int stack[STACK_SIZE];
+    int count = 0;
+    stack[count++] = root_;
+
+    while (count > 0)
+    {
+      int index = stack[--count];
+      const Node &node = nodes_[index];
+      if (!node.bounds.overlaps(bounds)) continue;
+
+      if (node.isLeaf())
+      {
+        if (proxy_bounds_[index].overlaps(bounds))
+          proxies.push_back(index);
+        continue;
+      }
+
+      assert(count + 2 <= STACK_SIZE);
+      stack[count++] = node.child1;
+      stack[count++] = node.child2;
+    }
+  }
+
+
+  void AABBTree::raycastBatch(const Ray *rays, size_t count, RayHit *hits) const
+  {
+    ThreadPool::instance()->parallelFor(count, QUERY_GRAIN, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+        raycast(rays[i], hits[i]);
+    });
+  }
+
+
+  void AABBTree::overlapBatch(const AABB *queries, size_t count, std::vector<int> *results) const
+  {
+    ThreadPool::instance()->parallelFor(count, QUERY_GRAIN, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+        overlap(queries[i], results[i]);
+    });
+  }
+
+
+  size_t AABBTree::getProxyCount() const
+  {
+    return proxy_count_;
+  }
+
+
+  int AABBTree::getHeight() const
+  {
+    return (root_ == NULL_NODE) ? 0 : nodes_[root_].height;
+  }
+
+
+  float AABBTree::getAreaRatio() const
+  {
+    if (root_ == NULL_NODE) return 0.0f;
+
+    float root_area = nodes_[root_].bounds.surfaceArea();
+    if (root_area <= 0.0f) return 0.0f;
+
+    float total_area = 0.0f;
+    for (auto &node : nodes_)
+      if (node.height >= 0)
+        total_area += node.bounds.surfaceArea();
+
+    return total_area / root_area;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  int AABBTree::allocateNode()
+  {
+    if (free_list_ == NULL_NODE)
+    {
+      VV_MEMORY_SCOPE(MEMORY_SCENE);
+
+      // grow in one go and thread the new nodes onto the free list
+      size_t old_size = nodes_.size();
+      size_t new_size = std::max<size_t>(16, old_size * 2);
+      nodes_.resize(new_size);
+      proxy_bounds_.resize(new_size);
+
+      for (size_t i = old_size; i < new_size; ++i)
+      {
+        nodes_[i].parent = (i + 1 < new_size) ? (int)(i + 1) : NULL_NODE;
+        nodes_[i].height = -1;
+      }
+      free_list_ = (int)old_size;
+    }
+
+    int index = free_list_;
+    Node &node = nodes_[index];
+    free_list_ = node.parent;
+
+    node.parent = NULL_NODE;
+    node.child1 = NULL_NODE;
+    node.child2 = NULL_NODE;
+    node.height = 0;
+    node.user_data = nullptr;
+
+    return index;
+  }
+
+
+  void AABBTree::freeNode(int node)
+  {
+    nodes_[node].parent = free_list_;
+    nodes_[node].height = -1;
+    free_list_ = node;
+  }
+
+
+  void AABBTree::insertLeaf(int leaf)
+  {
+    if (root_ == NULL_NODE)
+    {
+      root_ = leaf;
+      nodes_[leaf].parent = NULL_NODE;
+      return;
+    }
+
+    // walk down towards the sibling whose pairing grows the tree's total area the least
+    const AABB leaf_bounds = nodes_[leaf].bounds;
+    int index = root_;
+    while (!nodes_[index].isLeaf())
+    {
+      const Node &node = nodes_[index];
+      float area = node.bounds.surfaceArea();
+      float combined_area = AABB::combine(node.bounds, leaf_bounds).surfaceArea();
+
+      // cost of making a new parent for this node and the leaf
+      float cost = 2.0f * combined_area;
+
+      // minimum cost of pushing the leaf further down
+      float inheritance_cost = 2.0f * (combined_area - area);
+
+      float child_cost[2];
+      int children[2] = { node.child1, node.child2 };
+      for (int i = 0; i < 2; ++i)
+      {
+        const Node &child = nodes_[children[i]];
+        float enlarged = AABB::combine(child.bounds, leaf_bounds).surfaceArea();
+        child_cost[i] = (child.isLeaf() ? enlarged : enlarged - child.bounds.surfaceArea()) + inheritance_cost;
+      }
+
+      if (cost < child_cost[0] && cost < child_cost[1])
+        break;
+
+      index = (child_cost[0] < child_cost[1]) ? children[0] : children[1];
+    }
+
+    int sibling = index;
+
+    // allocation may grow the node array, so nothing above holds a reference past here
+    int new_parent = allocateNode();
+    int old_parent = nodes_[sibling].parent;
+
+    nodes_[new_parent].parent = old_parent;
+    nodes_[new_parent].bounds = AABB::combine(leaf_bounds, nodes_[sibling].bounds);
+    nodes_[new_parent].height = nodes_[sibling].height + 1;
+    nodes_[new_parent].child1 = sibling;
+    nodes_[new_parent].child2 = leaf;
+    nodes_[sibling].parent = new_parent;
+    nodes_[leaf].parent = new_parent;
+
+    if (old_parent == NULL_NODE)
+      root_ = new_parent;
+    else if (nodes_[old_parent].child1 == sibling)
+      nodes_[old_parent].child1 = new_parent;
+    else
+      nodes_[old_parent].child2 = new_parent;
+
+    refit(nodes_[leaf].parent);
+  }
+
+
+  void AABBTree::removeLeaf(int leaf)
+  {
+    if (leaf == root_)
+    {
+      root_ = NULL_NODE;
+      return;
+    }
+
+    int parent = nodes_[leaf].parent;
+    int grand_parent = nodes_[parent].parent;
+    int sibling = (nodes_[parent].child1 == leaf) ? nodes_[parent].child2 : nodes_[parent].child1;
+
+    nodes_[sibling].parent = grand_parent;
+    freeNode(parent);
+
+    if (grand_parent == NULL_NODE)
+    {
+      root_ = sibling;
+      return;
+    }
+
+    if (nodes_[grand_parent].child1 == parent)
+      nodes_[grand_parent].child1 = sibling;
+    else
+      nodes_[grand_parent].child2 = sibling;
+
+    refit(grand_parent);
+  }
+
+
+  int AABBTree::balance(int a)
+  {
+    Node &node_a = nodes_[a];
+    if (node_a.isLeaf() || node_a.height < 2)
+      return a;
+
+    int b = node_a.child1;
+    int c = node_a.child2;
+    int difference = nodes_[c].height - nodes_[b].height;
+    if (difference >= -1 && difference <= 1)
+      return a;
+
+    // promote the taller child, it takes a's place and a adopts one of its children
+    int up = (difference > 1) ? c : b;
+    int stays = (difference > 1) ? b : c;
+    Node &node_up = nodes_[up];
+
+    int f = node_up.child1;
+    int g = node_up.child2;
+
+    node_up.child1 = a;
+    node_up.parent = node_a.parent;
+    node_a.parent = up;
+
+    if (node_up.parent == NULL_NODE)
+      root_ = up;
+    else if (nodes_[node_up.parent].child1 == a)
+      nodes_[node_up.parent].child1 = up;
+    else
+      nodes_[node_up.parent].child2 = up;
+
+    // the taller grandchild stays with the promoted node
+    int keep = (nodes_[f].height > nodes_[g].height) ? f : g;
+    int give = (keep == f) ? g : f;
+
+    node_up.child2 = keep;
+    if (up == c)
+      node_a.child2 = give;
+    else
+      node_a.child1 = give;
+    nodes_[give].parent = a;
+
+    node_a.bounds = AABB::combine(nodes_[stays].bounds, nodes_[give].bounds);
+    node_a.height = 1 + std::max(nodes_[stays].height, nodes_[give].height);
+    node_up.bounds = AABB::combine(node_a.bounds, nodes_[keep].bounds);
+    node_up.height = 1 + std::max(node_a.height, nodes_[keep].height);
+
+    return up;
+  }
+
+
+  void AABBTree::refit(int node)
+  {
+    while (node != NULL_NODE)
+    {
+      node = balance(node);
+
+      Node &current = nodes_[node];
+      const Node &child1 = nodes_[current.child1];
+      const Node &child2 = nodes_[current.child2];
+      current.height = 1 + std::max(child1.height, child2.height);
+      current.bounds = AABB::combine(child1.bounds, child2.bounds);
+
+      node = current.parent;
+    }
+  }
+} // namespace vv
\ No newline at end of file
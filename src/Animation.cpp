@@ -0,0 +1,194 @@
+
+#include <algorithm>
+
+#include "vv/Animation.h"
+
+namespace vv
+{
+  /* Index of the key starting the segment that contains time, clamped to the track */
+  static size_t findKey(const float *times, size_t count, float time)
+  {
+    size_t key = std::upper_bound(times, times + count, time) - times;
+    return (key > 0) ? key - 1 : 0;
+  }
+
+
+  static float segmentFactor(const float *times, size_t key, size_t count, float time)
+  {
+    if (key + 1 >= count) return 0.0f;
+
+    float length = times[key + 1] - times[key];
+    if (length <= 0.0f) return 0.0f;
+
+    float factor = (time - times[key]) / length;
+    return (factor < 0.0f) ? 0.0f : (factor > 1.0f ? 1.0f : factor);
+  }
+
+
+  static glm::quat nlerp(const glm::quat &a, const glm::quat &b, float weight)
+  {
+    glm::quat target = (glm::dot(a, b) < 0.0f) ? -b : b;
+    return glm::normalize(a * (1.0f - weight) + target * weight);
+  }
+
+  /////////////////////////////////////////////////////////////////////// public
+  void Pose::resize(size_t joint_count)
+  {
+    translations.resize(joint_count);
+    rotations.resize(joint_count);
+    scales.resize(joint_count);
+  }
+
+
+  void Pose::blend(const Pose &other, float weight)
+  {
+    if (weight <= 0.0f) return;
+
+    for (size_t i = 0; i < translations.size(); ++i)
+    {
+      translations[i] += (other.translations[i] - translations[i]) * weight;
+      rotations[i] = nlerp(rotations[i], other.rotations[i], weight);
+      scales[i] += (other.scales[i] - scales[i]) * weight;
+    }
+  }
+
+
+  size_t Skeleton::getJointCount() const
+  {
+    return parents.size();
+  }
+
+
+  size_t Skeleton::getBoneCount() const
+  {
+    return bone_joints.size();
+  }
+
+
+  int Skeleton::findJoint(const std::string &name) const
+  {
+    for (size_t i = 0; i < joint_names.size(); ++i)
+      if (joint_names[i] == name)
+        return (int)i;
+
+    return -1;
+  }
+
+
+  void Skeleton::computePalette(const Pose &pose, std::vector<glm::mat4> &model_space, glm::mat4 *palette) const
+  {
+    model_space.resize(parents.size());
+
+    for (size_t i = 0; i < parents.size(); ++i)
+    {
+      // translation * rotation * scale without going through three full matrix products
+      glm::mat4 local = glm::mat4_cast(pose.rotations[i]);
+      local[0] = local[0] * pose.scales[i].x;
+      local[1] = local[1] * pose.scales[i].y;
+      local[2] = local[2] * pose.scales[i].z;
+      local[3] = glm::vec4(pose.translations[i], 1.0f);
+
+      model_space[i] = (parents[i] < 0) ? local : model_space[parents[i]] * local;
+    }
+
+    for (size_t bone = 0; bone < bone_joints.size(); ++bone)
+      palette[bone] = global_inverse * model_space[bone_joints[bone]] * inverse_bind[bone];
+  }
+
+
+  AnimationClip::AnimationClip(std::string name, float duration, size_t joint_count) :
+    name_(name),
+    duration_(duration),
+    tracks_(joint_count, AnimationTrack())
+  {
+  }
+
+
+  const std::string& AnimationClip::getName() const
+  {
+    return name_;
+  }
+
+
+  float AnimationClip::getDuration() const
+  {
+    return duration_;
+  }
+
+
+  void AnimationClip::sample(const Skeleton &skeleton, float time, Pose &pose) const
+  {
+    pose.resize(tracks_.size());
+
+    for (size_t joint = 0; joint < tracks_.size(); ++joint)
+    {
+      const AnimationTrack &track = tracks_[joint];
+
+      if (track.translation_count > 0)
+      {
+        const float *times = &translation_times_[track.first_translation];
+        const glm::vec3 *values = &translation_values_[track.first_translation];
+        size_t key = findKey(times, track.translation_count, time);
+        float factor = segmentFactor(times, key, track.translation_count, time);
+        pose.translations[joint] = (factor > 0.0f) ? glm::mix(values[key], values[key + 1], factor) : values[key];
+      }
+      else
+        pose.translations[joint] = skeleton.bind_pose.translations[joint];
+
+      if (track.rotation_count > 0)
+      {
+        const float *times = &rotation_times_[track.first_rotation];
+        const glm::quat *values = &rotation_values_[track.first_rotation];
+        size_t key = findKey(times, track.rotation_count, time);
+        float factor = segmentFactor(times, key, track.rotation_count, time);
+        pose.rotations[joint] = (factor > 0.0f) ? glm::slerp(values[key], values[key + 1], factor) : values[key];
+      }
+      else
+        pose.rotations[joint] = skeleton.bind_pose.rotations[joint];
+
+      if (track.scale_count > 0)
+      {
+        const float *times = &scale_times_[track.first_scale];
+        const glm::vec3 *values = &scale_values_[track.first_scale];
+        size_t key = findKey(times, track.scale_count, time);
+        float factor = segmentFactor(times, key, track.scale_count, time);
+        pose.scales[joint] = (factor > 0.0f) ? glm::mix(values[key], values[key + 1], factor) : values[key];
+      }
+      else
+        pose.scales[joint] = skeleton.bind_pose.scales[joint];
+    }
+  }
+
+
+  void AnimationClip::setTranslationKeys(size_t joint, const float *times, const glm::vec3 *values, size_t count)
+  {
+    if (joint >= tracks_.size()) return;
+
+    tracks_[joint].first_translation = (uint32_t)translation_times_.size();
+    tracks_[joint].translation_count = (uint32_t)count;
+    translation_times_.insert(translation_times_.end(), times, times + count);
+    translation_values_.insert(translation_values_.end(), values, values + count);
+  }
+
+
+  void AnimationClip::setRotationKeys(size_t joint, const float *times, const glm::quat *values, size_t count)
+  {
+    if (joint >= tracks_.size()) return;
+
+    tracks_[joint].first_rotation = (uint32_t)rotation_times_.size();
+    tracks_[joint].rotation_count = (uint32_t)count;
+    rotation_times_.insert(rotation_times_.end(), times, times + count);
+    rotation_values_.insert(rotation_values_.end(), values, values + count);
+  }
+
+
+  void AnimationClip::setScaleKeys(size_t joint, const float *times, const glm::vec3 *values, size_t count)
+  {
+    if (joint >= tracks_.size()) return;
+
+    tracks_[joint].first_scale = (uint32_t)scale_times_.size();
+    tracks_[joint].scale_count = (uint32_t)count;
+    scale_times_.insert(scale_times_.end(), times, times + count);
+    scale_values_.insert(scale_values_.end(), values, values + count);
+  }
+} // namespace vv
\ No newline at end of file
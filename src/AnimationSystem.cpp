@@ -0,0 +1,256 @@
+
+#include <cmath>
+#include <iostream>
+
+#include "vv/AnimationSystem.h"
+#include "vv/GLStateCache.h"
+#include "vv/MemoryTracker.h"
+#include "vv/ThreadPool.h"
+#include "vv/Time.h"
+
+namespace vv
+{
+  /////////////////////////////////////////////////////////////////////// public
+  AnimationSystem::AnimationSystem() :
+    layout_dirty_(false),
+    palette_buffer_(0),
+    palette_texture_(0),
+    buffer_capacity_(0)
+  {
+    stats_ = AnimationStats();
+  }
+
+
+  AnimationSystem::~AnimationSystem()
+  {
+    GLStateCache *cache = GLStateCache::instance();
+
+    if (palette_texture_)
+    {
+      cache->onDeleteTexture(palette_texture_);
+      glDeleteTextures(1, &palette_texture_);
+    }
+
+    if (palette_buffer_)
+    {
+      cache->onDeleteBuffer(palette_buffer_);
+      glDeleteBuffers(1, &palette_buffer_);
+    }
+  }
+
+
+  bool AnimationSystem::init()
+  {
+    if (palette_texture_) return true;
+
+    GLStateCache *cache = GLStateCache::instance();
+
+    glGenBuffers(1, &palette_buffer_);
+    glGenTextures(1, &palette_texture_);
+    if (!palette_buffer_ || !palette_texture_)
+    {
+      std::cerr << "ERROR: Failed to create the bone palette buffer.\n";
+      return false;
+    }
+
+    // every matrix is four rgba32f texels, one column each
+    cache->bindBuffer(GL_TEXTURE_BUFFER, palette_buffer_);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    buffer_capacity_ = sizeof(glm::mat4);
+
+    cache->bindTexture(0, GL_TEXTURE_BUFFER, palette_texture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palette_buffer_);
+
+    return true;
+  }
+
+
+  size_t AnimationSystem::createInstance(const Skeleton *skeleton)
+  {
+    VV_MEMORY_SCOPE(MEMORY_ANIMATION);
+
+    Instance instance = Instance();
+    instance.skeleton = skeleton;
+    instance.alive = true;
+    layout_dirty_ = true;
+
+    if (!free_instances_.empty())
+    {
+      size_t id = free_instances_.back();
+      free_instances_.pop_back();
+      instances_[id] = instance;
+      return id;
+    }
+
+    instances_.push_back(instance);
+    return instances_.size() - 1;
+  }
+
+
+  void AnimationSystem::destroyInstance(size_t instance)
+  {
+    if (instance >= instances_.size() || !instances_[instance].alive) return;
+    VV_MEMORY_SCOPE(MEMORY_ANIMATION);
+
+    instances_[instance].alive = false;
+    free_instances_.push_back(instance);
+    layout_dirty_ = true;
+  }
+
+
+  void AnimationSystem::play(size_t instance, int layer, const AnimationClip *clip, float weight,
+                             bool loop, float speed)
+  {
+    if (instance >= instances_.size() || layer < 0 || layer >= MAX_LAYERS) return;
+
+    AnimationLayer &target = instances_[instance].layers[layer];
+    target.clip = clip;
+    target.time = 0.0f;
+    target.speed = speed;
+    target.weight = weight;
+    target.loop = loop;
+  }
+
+
+  void AnimationSystem::stop(size_t instance, int layer)
+  {
+    if (instance >= instances_.size() || layer < 0 || layer >= MAX_LAYERS) return;
+
+    instances_[instance].layers[layer] = AnimationLayer();
+  }
+
+
+  void AnimationSystem::setWeight(size_t instance, int layer, float weight)
+  {
+    if (instance >= instances_.size() || layer < 0 || layer >= MAX_LAYERS) return;
+
+    instances_[instance].layers[layer].weight = weight;
+  }
+
+
+  void AnimationSystem::update(float delta_time)
+  {
+    double start_time = Time::current();
+
+    if (layout_dirty_)
+      layoutPalettes();
+
+    // instances never share palette ranges, so jobs write without any locking
+    ThreadPool::instance()->parallelFor(instances_.size(), INSTANCE_GRAIN, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+        if (instances_[i].alive)
+          evaluate(instances_[i], delta_time);
+    });
+
+    stats_.sample_time = Time::current() - start_time;
+  }
+
+
+  void AnimationSystem::upload()
+  {
+    if (palettes_.empty()) return;
+    if (!palette_buffer_ && !init()) return;
+    double start_time = Time::current();
+
+    GLStateCache *cache = GLStateCache::instance();
+    cache->bindBuffer(GL_TEXTURE_BUFFER, palette_buffer_);
+
+    // orphan the old storage so the driver never waits for last frame's draws to finish with it
+    size_t size = palettes_.size() * sizeof(glm::mat4);
+    if (size > buffer_capacity_)
+      buffer_capacity_ = size;
+
+    glBufferData(GL_TEXTURE_BUFFER, buffer_capacity_, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, palettes_.data());
+    cache->countApiCalls(2);
+
+    stats_.upload_time = Time::current() - start_time;
+  }
+
+
+  void AnimationSystem::bindPalette(GLuint unit)
+  {
+    GLStateCache::instance()->bindTexture(unit, GL_TEXTURE_BUFFER, palette_texture_);
+  }
+
+
+  GLint AnimationSystem::getPaletteOffset(size_t instance) const
+  {
+    return (GLint)instances_[instance].palette_offset;
+  }
+
+
+  const glm::mat4* AnimationSystem::getPalette(size_t instance) const
+  {
+    return &palettes_[instances_[instance].palette_offset];
+  }
+
+
+  const AnimationStats& AnimationSystem::getStats() const
+  {
+    return stats_;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void AnimationSystem::layoutPalettes()
+  {
+    VV_MEMORY_SCOPE(MEMORY_ANIMATION);
+
+    size_t offset = 0;
+    stats_.instances = 0;
+    for (auto &instance : instances_)
+    {
+      if (!instance.alive) continue;
+
+      instance.palette_offset = offset;
+      offset += instance.skeleton->getBoneCount();
+      stats_.instances++;
+    }
+
+    palettes_.assign(offset, glm::mat4(1.0f));
+    stats_.bones = offset;
+    layout_dirty_ = false;
+  }
+
+
+  void AnimationSystem::evaluate(Instance &instance, float delta_time)
+  {
+    // scratch poses live per worker and only ever grow, so steady frames don't allocate
+    static thread_local Pose pose;
+    static thread_local Pose layer_pose;
+    static thread_local std::vector<glm::mat4> model_space;
+
+    const Skeleton &skeleton = *instance.skeleton;
+    pose = skeleton.bind_pose;
+
+    for (int l = 0; l < MAX_LAYERS; ++l)
+    {
+      AnimationLayer &layer = instance.layers[l];
+      if (!layer.clip) continue;
+
+      float duration = layer.clip->getDuration();
+      layer.time += delta_time * layer.speed;
+      if (layer.loop && duration > 0.0f)
+      {
+        layer.time = std::fmod(layer.time, duration);
+        if (layer.time < 0.0f) layer.time += duration;
+      }
+      else if (layer.time > duration)
+        layer.time = duration;
+
+      if (layer.weight <= 0.0f) continue;
+
+      if (layer.weight >= 1.0f)
+        layer.clip->sample(skeleton, layer.time, pose);
+      else
+      {
+        layer.clip->sample(skeleton, layer.time, layer_pose);
+        pose.blend(layer_pose, layer.weight);
+      }
+    }
+
+    skeleton.computePalette(pose, model_space, &palettes_[instance.palette_offset]);
+  }
+} // namespace vv
\ No newline at end of file
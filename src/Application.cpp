@@ -1,7 +1,13 @@
 
 #include <iostream>
 
+#include <glm/gtc/matrix_transform.hpp>
+
 #include "vv/Application.h"
+#include "vv/GLStateCache.h"
+#include "vv/MemoryTracker.h"
+#include "vv/Settings.h"
+#include "vv/ThreadPool.h"
 #include "vv/Time.h"
 #include "vv/VirtualVista.h"
 
@@ -11,11 +17,27 @@ namespace vv
   Application::Application(int argc, char **argv) :
     first_run_(true),
     initialized_(false),
-    quit_(false)
+    quit_(false),
+    argc_(argc),
+    argv_(argv),
+    replay_fast_(false),
+    capture_raw_(false),
+    camera_position_(0.0f),
+    view_(1.0f),
+    projection_(1.0f)
   {
     contex_ = new RenderContex;
     input_manager_ = new InputManager;
     resource_manager_ = new ResourceManager;
+    scene_ = new Scene(resource_manager_);
+    render_queue_ = new RenderQueue(ThreadPool::instance()->getWorkerCount() + 1);
+    render_backend_ = new GLRenderBackend;
+    dynamic_resolution_ = nullptr;
+    input_recorder_ = new InputRecorder(input_manager_);
+    metrics_server_ = nullptr;
+    frame_capture_ = nullptr;
+
+    parseArguments();
   }
 
 
@@ -23,7 +45,14 @@ namespace vv
   {
     SAFE_DELETE(contex_);
     SAFE_DELETE(input_manager_);
+    SAFE_DELETE(scene_);
+    SAFE_DELETE(render_queue_);
+    SAFE_DELETE(render_backend_);
     SAFE_DELETE(resource_manager_);
+    SAFE_DELETE(dynamic_resolution_);
+    SAFE_DELETE(input_recorder_);
+    SAFE_DELETE(metrics_server_);
+    SAFE_DELETE(frame_capture_);
   }
 
 
@@ -32,11 +61,70 @@ namespace vv
     if (!initialized_)
     {
       input_manager_->setEventHandling();
-      if (!contex_->init(0, 0, 640, 480)) return false;
+
+      // the recorder has to see events first, it decides what reaches the input manager
+      if (!replay_file_.empty())
+      {
+        if (!input_recorder_->startReplay(replay_file_, replay_fast_ ? REPLAY_FAST : REPLAY_RECORDED))
+          return false;
+        input_recorder_->setEventHandling();
+      }
+      else if (!record_file_.empty())
+      {
+        if (!input_recorder_->startRecording(record_file_)) return false;
+        input_recorder_->setEventHandling();
+      }
+
+      registerMetrics();
+      if (!metrics_socket_.empty())
+      {
+        metrics_server_ = new MetricsServer;
+        if (!metrics_server_->start(metrics_socket_))
+          SAFE_DELETE(metrics_server_);
+      }
+
+      int x, y, width, height;
+      Settings::instance()->getViewport(x, y, width, height);
+      if (!contex_->init(x, y, width, height)) return false;
+
+      float fov, aspect, near_clip, far_clip;
+      Settings::instance()->getPerspective(fov, aspect, near_clip, far_clip);
+      projection_ = glm::perspective(glm::radians(fov), aspect, near_clip, far_clip);
+      view_ = glm::lookAt(camera_position_, camera_position_ + glm::vec3(0.0f, 0.0f, -1.0f),
+                          glm::vec3(0.0f, 1.0f, 0.0f));
+
+      // offscreen targets and capture are sized in pixels, the settings viewport is in window units
+      int framebuffer_width, framebuffer_height;
+      glfwGetFramebufferSize(contex_->getWindow(), &framebuffer_width, &framebuffer_height);
+
+      float min_scale, max_scale;
+      double target_frame_time;
+      if (Settings::instance()->getDynamicResolution(min_scale, max_scale, target_frame_time))
+      {
+        dynamic_resolution_ = new DynamicResolution;
+        if (!dynamic_resolution_->init(framebuffer_width, framebuffer_height, min_scale, max_scale,
+                                       target_frame_time, Settings::instance()->getMultisamples()))
+        {
+          std::cerr << "WARNING: Dynamic resolution disabled, rendering at window size.\n";
+          SAFE_DELETE(dynamic_resolution_);
+        }
+      }
 
       glfwSetKeyCallback(contex_->getWindow(), GLFWState::dispatchKeyCallback);
       glfwSetCursorPosCallback(contex_->getWindow(), GLFWState::dispatchMouseCallback);
 
+      if (!capture_directory_.empty())
+      {
+        frame_capture_ = new FrameCapture;
+        if (!frame_capture_->init(framebuffer_width, framebuffer_height, capture_directory_,
+                                  capture_raw_ ? CAPTURE_RAW : CAPTURE_PNG))
+          return false;
+      }
+
+      // vsync would pace a fast replay to the display again
+      if (input_recorder_->getMode() == RECORDER_REPLAY && replay_fast_)
+        glfwSwapInterval(0);
+
       initialized_ = true;
     }
 
@@ -50,11 +138,29 @@ namespace vv
 
 
     const double UPDATE_STEP = 2000; // todo: move somewhere else
+    const size_t WARMUP_FRAMES = 120; // after this the loop should stop touching the heap
     double total_update_time = 0, previous_time = 0, fps_time_stamp = 0;
     int frame_counter = 0; // stores number of frames every second
+    double replay_start = Time::current();
+
+    // texture streaming feedback estimates mip levels against the full framebuffer
+    int framebuffer_width, framebuffer_height;
+    glfwGetFramebufferSize(contex_->getWindow(), &framebuffer_width, &framebuffer_height);
 
     while (!quit_)
     {
+      GLStateCache::instance()->beginFrame();
+      MemoryTracker::beginFrame();
+
+      if (Time::frame_num_ == WARMUP_FRAMES)
+      {
+#ifdef NDEBUG
+        MemoryTracker::setAllocationGuard(GUARD_REPORT);
+#else
+        MemoryTracker::setAllocationGuard(GUARD_ASSERT);
+#endif
+      }
+
       // timing calculations
       double current_time = Time::current();
       if (first_run_)
@@ -64,8 +170,14 @@ namespace vv
         first_run_ = false;
       }
 
-      Time::delta_time_ = current_time - previous_time;
+      Time::delta_time_ = input_recorder_->beginFrame(current_time - previous_time);
       previous_time = current_time;
+      if (input_recorder_->isFinished())
+      {
+        quit_ = true;
+        break;
+      }
+
       total_update_time += Time::delta_time_;
 
       // update frames per second calculation
@@ -76,7 +188,8 @@ namespace vv
         Time::frame_rate_ = (int)(MILLISECOND * frame_counter / (current_time - fps_time_stamp));
         fps_time_stamp = current_time;
         frame_counter = 0;
-        //std::cout << "Frame rate: " << Time::frame_rate_ << "\n";
+        //std::cout << "Frame rate: " << Time::frame_rate_ << ", draw calls: "
+        //          << GLStateCache::instance()->getFrameCounters().draw_calls << "\n";
       }
 
       // update scene as many times as possible within the alloted time
@@ -86,22 +199,195 @@ namespace vv
         total_update_time -= UPDATE_STEP;
       }
 
+      // streaming, culling and animation follow the frame rather than the fixed step
+      scene_->update(camera_position_, projection_ * view_);
+
       // render
-      glfwPollEvents();
+      if (dynamic_resolution_)
+        dynamic_resolution_->beginFrame();
+      else
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+      scene_->recordCommands(*render_queue_, camera_position_, projection_, framebuffer_height);
+      render_queue_->sort();
+      render_queue_->submit(*render_backend_);
+      render_queue_->reset();
+
+      // blended last, after every opaque draw has written depth
+      scene_->getParticleSystem()->render(view_, projection_);
+
+      if (dynamic_resolution_) dynamic_resolution_->endFrame();
+      if (frame_capture_) frame_capture_->capture();
+      input_recorder_->pollEvents();
       glfwSwapBuffers(contex_->getWindow());
+      updateMetrics();
+
+      // replayed input never carries the live escape or a closed window, check both directly
+      if (input_manager_->keyIsPressed(GLFW_KEY_ESCAPE) || input_recorder_->isInterrupted() ||
+          glfwWindowShouldClose(contex_->getWindow()))
+        quit_ = true;
+
+    }
+
+    MemoryTracker::setAllocationGuard(GUARD_OFF);
 
-      if (input_manager_->keyIsPressed(GLFW_KEY_ESCAPE)) quit_ = true;
+    if (input_recorder_->getMode() == RECORDER_REPLAY)
+    {
+      double replay_time = Time::current() - replay_start;
+      size_t frames = input_recorder_->getFrameCount();
+      std::cout << "Replayed " << frames << " frames in " << replay_time << " ms ("
+                << (frames ? replay_time / frames : 0.0) << " ms per frame)"
+                << (input_recorder_->isInterrupted() ? ", interrupted" : "") << ".\n";
+    }
+
+    input_recorder_->stop();
 
+    if (frame_capture_)
+    {
+      frame_capture_->finish();
+      CaptureStats stats = frame_capture_->getStats();
+      std::cout << "Capture: " << stats.fence_waits << " fence waits, " << stats.writer_waits
+                << " writer waits, " << stats.encode_time << " ms per frame on the writers.\n";
     }
   }
 
 
   void Application::shutdown()
   {
+    if (!initialized_) return;
+
+    if (MemoryTracker::isEnabled())
+      MemoryTracker::report(std::cout);
+
+    // these own GL objects, which can only be deleted while the context is still current
+    SAFE_DELETE(frame_capture_);
+    SAFE_DELETE(dynamic_resolution_);
+    SAFE_DELETE(render_backend_);
+    SAFE_DELETE(render_queue_);
+    SAFE_DELETE(scene_);
+    resource_manager_->clearResources();
+
     glfwSetWindowShouldClose(contex_->getWindow(), GL_TRUE);
     glfwDestroyWindow(contex_->getWindow());
     glfwTerminate();
+
+    initialized_ = false;
+  }
+
+
+  bool Application::hasMipChainJobs() const
+  {
+    return !mip_chain_images_.empty();
+  }
+
+
+  bool Application::buildMipChains()
+  {
+    bool success = true;
+    for (auto &image : mip_chain_images_)
+    {
+      size_t split = image.find_last_of("/\\") + 1;
+      size_t extension = image.find_last_of('.');
+      if (extension == std::string::npos || extension < split)
+        extension = image.size();
+      std::string output = image.substr(0, extension) + ".vvtex";
+
+      // decoding and writing happen in system memory, no context is needed
+      Texture texture(image.substr(0, split), image.substr(split));
+      if (!texture.init() || !texture.saveMipChain(output))
+      {
+        success = false;
+        continue;
+      }
+
+      std::cout << "Built mip chain " << output << " (" << texture.getWidth() << "x" << texture.getHeight() << ")\n";
+    }
+
+    return success;
   }
   ////////////////////////////////////////////////////////////////////// private
+  void Application::parseArguments()
+  {
+    for (int i = 1; i < argc_; ++i)
+    {
+      std::string argument = argv_[i];
 
+      if (argument == "--record" && i + 1 < argc_)
+        record_file_ = argv_[++i];
+      else if (argument == "--replay" && i + 1 < argc_)
+        replay_file_ = argv_[++i];
+      else if (argument == "--fast")
+        replay_fast_ = true;
+      else if (argument == "--metrics" && i + 1 < argc_)
+        metrics_socket_ = argv_[++i];
+      else if (argument == "--capture" && i + 1 < argc_)
+        capture_directory_ = argv_[++i];
+      else if (argument == "--capture-raw")
+        capture_raw_ = true;
+      else if (argument == "--build-mips" && i + 1 < argc_)
+        mip_chain_images_.push_back(argv_[++i]);
+      else
+        std::cerr << "WARNING: Ignoring unknown argument " << argument << "\n";
+    }
+
+    if (!record_file_.empty() && !replay_file_.empty())
+    {
+      std::cerr << "WARNING: --record and --replay are exclusive, only replaying.\n";
+      record_file_.clear();
+    }
+  }
+
+
+  void Application::registerMetrics()
+  {
+    static const double FRAME_TIME_BOUNDS[] = { 4.0, 8.0, 12.0, 16.7, 20.0, 33.3, 50.0, 100.0, 250.0 };
+
+    MetricsRegistry *registry = MetricsRegistry::instance();
+    metrics_.frames = registry->counter("vv_frames_total", "Frames rendered since startup.");
+    metrics_.frame_time = registry->histogram("vv_frame_time_milliseconds", "Time between consecutive frames.",
+      std::vector<double>(FRAME_TIME_BOUNDS, FRAME_TIME_BOUNDS + sizeof(FRAME_TIME_BOUNDS) / sizeof(double)));
+    metrics_.frame_rate = registry->gauge("vv_frame_rate", "Frames per second, averaged over a quarter second.");
+    metrics_.draw_calls = registry->gauge("vv_draw_calls", "Draw calls issued during the last frame.");
+    metrics_.state_changes = registry->gauge("vv_gl_state_changes", "GL binds and toggles that changed state during the last frame.");
+    metrics_.frame_allocations = registry->gauge("vv_frame_allocations", "Heap allocations during the last frame, needs VV_TRACK_ALLOCATIONS.");
+
+    // parallelFor never queues jobs, its unclaimed chunks are what waits for a worker
+    const char *QUEUE_HELP = "Work handed to other threads and not done yet, sampled after every frame.";
+    metrics_.thread_pool_queue = registry->gauge("vv_queue_depth", QUEUE_HELP,
+      MetricLabels(1, std::make_pair(std::string("queue"), std::string("thread_pool"))));
+    metrics_.world_streaming_queue = registry->gauge("vv_queue_depth", QUEUE_HELP,
+      MetricLabels(1, std::make_pair(std::string("queue"), std::string("world_streaming"))));
+    metrics_.texture_streaming_queue = registry->gauge("vv_queue_depth", QUEUE_HELP,
+      MetricLabels(1, std::make_pair(std::string("queue"), std::string("texture_streaming"))));
+
+    for (int i = 0; i < MEMORY_TAG_COUNT; ++i)
+    {
+      MetricLabels labels(1, std::make_pair(std::string("subsystem"), std::string(MemoryTracker::getTagName((MemoryTag)i))));
+      metrics_.memory_bytes[i] = registry->gauge("vv_memory_bytes", "Live heap bytes per subsystem, needs VV_TRACK_ALLOCATIONS.", labels);
+    }
+  }
+
+
+  void Application::updateMetrics()
+  {
+    // relaxed atomic stores only, this runs inside the allocation guard
+    const GLFrameCounters &counters = GLStateCache::instance()->getCurrentCounters();
+
+    metrics_.frames->add();
+    metrics_.frame_time->observe(Time::delta_time_);
+    metrics_.frame_rate->set(Time::frame_rate_);
+    metrics_.draw_calls->set((double)counters.draw_calls);
+    metrics_.state_changes->set((double)counters.state_changes);
+    metrics_.frame_allocations->set((double)MemoryTracker::getFrameAllocations());
+
+    ThreadPool *pool = ThreadPool::instance();
+    WorldStreamer *world_streamer = scene_->getStreamer();
+    TextureStreamer *texture_streamer = scene_->getTextureStreamer();
+    metrics_.thread_pool_queue->set((double)(pool->getQueuedJobs() + pool->getQueuedChunks()));
+    metrics_.world_streaming_queue->set(world_streamer ? (double)world_streamer->getStats().cells_in_flight : 0.0);
+    metrics_.texture_streaming_queue->set(texture_streamer ? (double)texture_streamer->getStats().reads_in_flight : 0.0);
+
+    for (int i = 0; i < MEMORY_TAG_COUNT; ++i)
+      metrics_.memory_bytes[i]->set((double)MemoryTracker::getStats((MemoryTag)i).bytes);
+  }
 } // namespace vv
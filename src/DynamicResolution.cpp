@@ -0,0 +1,340 @@
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "vv/DynamicResolution.h"
+#include "vv/GLStateCache.h"
+
+namespace vv
+{
+  /* Weight of the newest sample in the smoothed gpu time */
+  static const double SMOOTHING = 0.2;
+
+  /* Band around the target in which the scale is left alone, stops it oscillating */
+  static const double UPPER_THRESHOLD = 1.05;
+  static const double LOWER_THRESHOLD = 0.85;
+
+  /* Largest change per adjustment, dropping is allowed to react faster than raising */
+  static const float MAX_DECREASE = 0.85f;
+  static const float MAX_INCREASE = 1.05f;
+
+  /* Scales snap to this step so tiny changes don't resize the viewport every frame */
+  static const float SCALE_STEP = 1.0f / 32.0f;
+
+  static bool checkFramebuffer(const char *name)
+  {
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status == GL_FRAMEBUFFER_COMPLETE) return true;
+
+    std::cerr << "ERROR: Dynamic resolution " << name << " framebuffer is incomplete (0x" << std::hex
+              << status << std::dec << ").\n";
+    return false;
+  }
+
+
+  /////////////////////////////////////////////////////////////////////// public
+  DynamicResolution::DynamicResolution() :
+    framebuffer_(0),
+    resolve_framebuffer_(0),
+    color_texture_(0),
+    color_renderbuffer_(0),
+    depth_renderbuffer_(0),
+    samples_(0),
+    query_index_(0),
+    timing_(false),
+    framebuffer_width_(0),
+    framebuffer_height_(0),
+    min_scale_(1.0f),
+    max_scale_(1.0f),
+    target_frame_time_(0.0),
+    scale_(1.0f),
+    cooldown_(0)
+  {
+    for (int i = 0; i < QUERY_COUNT; ++i)
+    {
+      queries_[i] = 0;
+      query_pending_[i] = false;
+    }
+
+    stats_ = DynamicResolutionStats();
+  }
+
+
+  DynamicResolution::~DynamicResolution()
+  {
+    release();
+  }
+
+
+  bool DynamicResolution::init(int framebuffer_width, int framebuffer_height, float min_scale,
+                               float max_scale, double target_frame_time, int samples)
+  {
+    release();
+
+    if (min_scale <= 0.0f || max_scale < min_scale)
+    {
+      std::cerr << "ERROR: Invalid resolution scale range " << min_scale << " - " << max_scale << ".\n";
+      return false;
+    }
+
+    framebuffer_width_ = framebuffer_width;
+    framebuffer_height_ = framebuffer_height;
+    min_scale_ = min_scale;
+    max_scale_ = max_scale;
+    target_frame_time_ = target_frame_time;
+    scale_ = max_scale;
+
+    GLint max_samples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    samples_ = (samples > 1) ? std::min(samples, (int)max_samples) : 0;
+
+    int width = (int)std::ceil(framebuffer_width * max_scale);
+    int height = (int)std::ceil(framebuffer_height * max_scale);
+
+    GLStateCache *cache = GLStateCache::instance();
+
+    glGenTextures(1, &color_texture_);
+    cache->bindTexture(0, GL_TEXTURE_2D, color_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // zero samples is plain storage, so depth looks the same either way
+    glGenRenderbuffers(1, &depth_renderbuffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_DEPTH24_STENCIL8, width, height);
+
+    glGenFramebuffers(1, &framebuffer_);
+    cache->bindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer_);
+
+    if (samples_)
+    {
+      glGenRenderbuffers(1, &color_renderbuffer_);
+      glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer_);
+      glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_RGBA8, width, height);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer_);
+    }
+    else
+    {
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_texture_, 0);
+    }
+
+    bool complete = checkFramebuffer("render");
+    if (complete && samples_)
+    {
+      glGenFramebuffers(1, &resolve_framebuffer_);
+      cache->bindFramebuffer(GL_FRAMEBUFFER, resolve_framebuffer_);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_texture_, 0);
+      complete = checkFramebuffer("resolve");
+    }
+
+    cache->bindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete)
+    {
+      release();
+      return false;
+    }
+
+    glGenQueries(QUERY_COUNT, queries_);
+
+    stats_ = DynamicResolutionStats();
+    stats_.scale = scale_;
+    getRenderSize(stats_.render_width, stats_.render_height);
+
+    return true;
+  }
+
+
+  void DynamicResolution::beginFrame()
+  {
+    if (!framebuffer_) return;
+
+    collectQueries();
+
+    int width, height;
+    getRenderSize(width, height);
+
+    GLStateCache *cache = GLStateCache::instance();
+    cache->bindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    cache->setViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    // every query in the ring is still in flight, skip timing this frame rather than stall
+    if (!query_pending_[query_index_])
+    {
+      glBeginQuery(GL_TIME_ELAPSED, queries_[query_index_]);
+      timing_ = true;
+    }
+  }
+
+
+  void DynamicResolution::endFrame()
+  {
+    if (!framebuffer_) return;
+
+    if (timing_)
+    {
+      glEndQuery(GL_TIME_ELAPSED);
+      query_pending_[query_index_] = true;
+      query_index_ = (query_index_ + 1) % QUERY_COUNT;
+      timing_ = false;
+    }
+
+    int width, height;
+    getRenderSize(width, height);
+
+    // multisampled blits can't scale, so resolve at render size first
+    GLStateCache *cache = GLStateCache::instance();
+    cache->bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    if (resolve_framebuffer_)
+    {
+      cache->bindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_framebuffer_);
+      glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+      cache->bindFramebuffer(GL_READ_FRAMEBUFFER, resolve_framebuffer_);
+    }
+
+    // the default framebuffer must be single sampled for a scaling blit
+    cache->bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, framebuffer_width_, framebuffer_height_,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    cache->bindFramebuffer(GL_FRAMEBUFFER, 0);
+    cache->setViewport(0, 0, framebuffer_width_, framebuffer_height_);
+  }
+
+
+  float DynamicResolution::getScale() const
+  {
+    return scale_;
+  }
+
+
+  void DynamicResolution::getRenderSize(int &width, int &height) const
+  {
+    width = (int)(framebuffer_width_ * scale_ + 0.5f);
+    height = (int)(framebuffer_height_ * scale_ + 0.5f);
+    if (width < 1) width = 1;
+    if (height < 1) height = 1;
+  }
+
+
+  const DynamicResolutionStats& DynamicResolution::getStats() const
+  {
+    return stats_;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void DynamicResolution::collectQueries()
+  {
+    // oldest first, stop at the first result that isn't ready so samples stay in order
+    for (int i = 0; i < QUERY_COUNT; ++i)
+    {
+      int index = (query_index_ + i) % QUERY_COUNT;
+      if (!query_pending_[index]) continue;
+
+      GLint available = 0;
+      glGetQueryObjectiv(queries_[index], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) break;
+
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(queries_[index], GL_QUERY_RESULT, &elapsed);
+      query_pending_[index] = false;
+
+      updateScale(elapsed / 1000000.0);
+    }
+  }
+
+
+  void DynamicResolution::updateScale(double gpu_time)
+  {
+    stats_.gpu_time = gpu_time;
+    if (stats_.smoothed_gpu_time <= 0.0)
+      stats_.smoothed_gpu_time = gpu_time;
+    else
+      stats_.smoothed_gpu_time += SMOOTHING * (gpu_time - stats_.smoothed_gpu_time);
+
+    // results still in flight were rendered at the old scale, wait for them to drain
+    if (cooldown_ > 0)
+    {
+      cooldown_--;
+      return;
+    }
+
+    double ratio = stats_.smoothed_gpu_time / target_frame_time_;
+    if (ratio < UPPER_THRESHOLD && ratio > LOWER_THRESHOLD) return;
+
+    // gpu time follows the pixel count, which grows with the square of the scale
+    float factor = (float)std::sqrt(1.0 / ratio);
+    if (factor < MAX_DECREASE) factor = MAX_DECREASE;
+    if (factor > MAX_INCREASE) factor = MAX_INCREASE;
+
+    float scale = std::floor(scale_ * factor / SCALE_STEP + 0.5f) * SCALE_STEP;
+    if (scale < min_scale_) scale = min_scale_;
+    if (scale > max_scale_) scale = max_scale_;
+    if (scale == scale_) return;
+
+    scale_ = scale;
+    cooldown_ = QUERY_COUNT;
+    stats_.smoothed_gpu_time = 0.0;
+
+    stats_.scale = scale_;
+    getRenderSize(stats_.render_width, stats_.render_height);
+    stats_.scale_changes++;
+  }
+
+
+  void DynamicResolution::release()
+  {
+    GLStateCache *cache = GLStateCache::instance();
+
+    if (queries_[0])
+    {
+      glDeleteQueries(QUERY_COUNT, queries_);
+      for (int i = 0; i < QUERY_COUNT; ++i)
+      {
+        queries_[i] = 0;
+        query_pending_[i] = false;
+      }
+    }
+
+    if (framebuffer_)
+    {
+      cache->onDeleteFramebuffer(framebuffer_);
+      glDeleteFramebuffers(1, &framebuffer_);
+      framebuffer_ = 0;
+    }
+
+    if (resolve_framebuffer_)
+    {
+      cache->onDeleteFramebuffer(resolve_framebuffer_);
+      glDeleteFramebuffers(1, &resolve_framebuffer_);
+      resolve_framebuffer_ = 0;
+    }
+
+    if (color_renderbuffer_)
+    {
+      glDeleteRenderbuffers(1, &color_renderbuffer_);
+      color_renderbuffer_ = 0;
+    }
+
+    if (depth_renderbuffer_)
+    {
+      glDeleteRenderbuffers(1, &depth_renderbuffer_);
+      depth_renderbuffer_ = 0;
+    }
+
+    if (color_texture_)
+    {
+      cache->onDeleteTexture(color_texture_);
+      glDeleteTextures(1, &color_texture_);
+      color_texture_ = 0;
+    }
+
+    timing_ = false;
+    query_index_ = 0;
+  }
+} // namespace vv
\ No newline at end of file
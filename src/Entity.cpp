@@ -1,13 +1,18 @@
 
+#include <algorithm>
+
 #include "vv/Entity.h"
+#include "vv/MemoryTracker.h"
 
 namespace vv
 {
   /////////////////////////////////////////////////////////////////////// public
   Entity::Entity() :
     is_visible_(false),
+    is_occluded_(false),
     has_geometry_(false)
   {
+    VV_MEMORY_SCOPE(MEMORY_SCENE);
     transform_ = new Transform;
   }
 
@@ -26,7 +31,7 @@ namespace vv
 
   bool Entity::isRenderable()
   {
-    return has_geometry_ && is_visible_;
+    return has_geometry_ && is_visible_ && !is_occluded_;
   }
 
 
@@ -36,5 +41,63 @@ namespace vv
   }
 
 
+  void Entity::setOccluded(bool occluded)
+  {
+    is_occluded_ = occluded;
+  }
+
+
+  bool Entity::isOccluded() const
+  {
+    return is_occluded_;
+  }
+
+
+  void Entity::setBounds(const AABB &bounds)
+  {
+    bounds_ = bounds;
+    has_geometry_ = bounds.isValid();
+
+    // new bounds have to reach the spatial tree just like a move would
+    transform_->markDirty();
+  }
+
+
+  const AABB& Entity::getBounds() const
+  {
+    return bounds_;
+  }
+
+
+  AABB Entity::getWorldBounds()
+  {
+    return bounds_.transformed(transform_->getMatrix());
+  }
+
+
+  void Entity::addStreamedTexture(Texture *texture, float uv_density)
+  {
+    if (!texture) return;
+
+    VV_MEMORY_SCOPE(MEMORY_SCENE);
+    StreamedTextureUse use = { texture, uv_density };
+    streamed_textures_.push_back(use);
+  }
+
+
+  void Entity::removeStreamedTexture(Texture *texture)
+  {
+    streamed_textures_.erase(std::remove_if(streamed_textures_.begin(), streamed_textures_.end(),
+                                            [texture](const StreamedTextureUse &use) { return use.texture == texture; }),
+                             streamed_textures_.end());
+  }
+
+
+  const std::vector<StreamedTextureUse>& Entity::getStreamedTextures() const
+  {
+    return streamed_textures_;
+  }
+
+
   ////////////////////////////////////////////////////////////////////// private
 } // namespace vv
\ No newline at end of file
@@ -0,0 +1,426 @@
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "vv/FrameCapture.h"
+#include "vv/GLStateCache.h"
+#include "vv/Time.h"
+
+namespace vv
+{
+  /* A readback that still isn't done after this is given up on rather than hanging the frame */
+  static const GLuint64 FENCE_TIMEOUT = 1000000000; /* in nanoseconds */
+
+  /* Largest payload of an uncompressed deflate block */
+  static const size_t STORED_BLOCK_SIZE = 65535;
+
+  static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+  {
+    static uint32_t table[256];
+    static bool table_ready = false;
+    if (!table_ready)
+    {
+      for (uint32_t i = 0; i < 256; ++i)
+      {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; ++bit)
+          value = (value & 1) ? (0xedb88320u ^ (value >> 1)) : (value >> 1);
+        table[i] = value;
+      }
+      table_ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+      crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+  }
+
+
+  static void appendBigEndian(std::vector<uint8_t> &out, uint32_t value)
+  {
+    out.push_back((uint8_t)(value >> 24));
+    out.push_back((uint8_t)(value >> 16));
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+  }
+
+
+  static void appendChunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data)
+  {
+    appendBigEndian(out, (uint32_t)data.size());
+    size_t type_start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    appendBigEndian(out, crc32(&out[type_start], out.size() - type_start));
+  }
+
+
+  /* Stored deflate blocks, so the png is about as large as the raw frame but costs no more
+     than a copy to write. Worth swapping for a real deflate if disk space matters more. */
+  static void encodePng(const uint8_t *rgba, int width, int height, std::vector<uint8_t> &png)
+  {
+    const size_t row_size = (size_t)width * 3 + 1; // filter byte, then rgb
+    std::vector<uint8_t> scanlines(row_size * height);
+    for (int y = 0; y < height; ++y)
+    {
+      // gl rows start at the bottom
+      const uint8_t *source = rgba + (size_t)(height - 1 - y) * width * 4;
+      uint8_t *row = &scanlines[y * row_size];
+      row[0] = 0;
+      for (int x = 0; x < width; ++x)
+      {
+        row[1 + x * 3] = source[x * 4];
+        row[2 + x * 3] = source[x * 4 + 1];
+        row[3 + x * 3] = source[x * 4 + 2];
+      }
+    }
+
+    std::vector<uint8_t> zlib;
+    zlib.reserve(scanlines.size() + scanlines.size() / STORED_BLOCK_SIZE * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+
+    uint32_t adler_a = 1, adler_b = 0;
+    for (size_t offset = 0; ; offset += STORED_BLOCK_SIZE)
+    {
+      size_t length = std::min(STORED_BLOCK_SIZE, scanlines.size() - offset);
+      bool last = (offset + length == scanlines.size());
+      zlib.push_back(last ? 1 : 0);
+      zlib.push_back((uint8_t)length);
+      zlib.push_back((uint8_t)(length >> 8));
+      zlib.push_back((uint8_t)~length);
+      zlib.push_back((uint8_t)(~length >> 8));
+      zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+
+      // 5552 bytes is the most that can be summed before adler_b overflows 32 bits
+      for (size_t run = offset; run < offset + length; run += 5552)
+      {
+        size_t run_end = std::min(run + 5552, offset + length);
+        for (size_t i = run; i < run_end; ++i)
+        {
+          adler_a += scanlines[i];
+          adler_b += adler_a;
+        }
+        adler_a %= 65521;
+        adler_b %= 65521;
+      }
+
+      if (last) break;
+    }
+    appendBigEndian(zlib, (adler_b << 16) | adler_a);
+
+    static const uint8_t SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    png.assign(SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+
+    std::vector<uint8_t> header;
+    appendBigEndian(header, (uint32_t)width);
+    appendBigEndian(header, (uint32_t)height);
+    header.push_back(8); // bits per channel
+    header.push_back(2); // rgb
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", zlib);
+    appendChunk(png, "IEND", std::vector<uint8_t>());
+  }
+
+  /////////////////////////////////////////////////////////////////////// public
+  FrameCapture::FrameCapture() :
+    width_(0),
+    height_(0),
+    format_(CAPTURE_PNG),
+    next_slot_(0),
+    frame_count_(0),
+    queue_head_(0),
+    queue_count_(0),
+    stopping_(false),
+    frames_read_(0),
+    frames_written_(0),
+    write_failures_(0),
+    fence_waits_(0),
+    writer_waits_(0),
+    encode_microseconds_(0),
+    readback_time_(0.0)
+  {
+    for (size_t i = 0; i < RING_SIZE; ++i)
+    {
+      slots_[i].buffer = 0;
+      slots_[i].fence = nullptr;
+      slots_[i].frame = 0;
+    }
+  }
+
+
+  FrameCapture::~FrameCapture()
+  {
+    finish();
+    release();
+  }
+
+
+  bool FrameCapture::init(int width, int height, const std::string &directory, CaptureFormat format,
+                          size_t writer_count)
+  {
+    if (width <= 0 || height <= 0)
+    {
+      std::cerr << "ERROR: frame capture needs a positive resolution.\n";
+      return false;
+    }
+
+    width_ = width;
+    height_ = height;
+    directory_ = directory;
+    if (!directory_.empty() && directory_[directory_.size() - 1] != '/')
+      directory_ += '/';
+    format_ = format;
+
+    // crc table is built lazily, do it here before several writers race for it
+    crc32(nullptr, 0);
+
+    const size_t frame_size = (size_t)width * height * 4;
+    GLStateCache *cache = GLStateCache::instance();
+    for (size_t i = 0; i < RING_SIZE; ++i)
+    {
+      glGenBuffers(1, &slots_[i].buffer);
+      cache->bindBuffer(GL_PIXEL_PACK_BUFFER, slots_[i].buffer);
+      glBufferData(GL_PIXEL_PACK_BUFFER, frame_size, nullptr, GL_STREAM_READ);
+    }
+    cache->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    frames_.resize(MAX_QUEUED);
+    queued_.resize(MAX_QUEUED);
+    for (size_t i = 0; i < MAX_QUEUED; ++i)
+    {
+      frames_[i].pixels.resize(frame_size);
+      free_frames_.push_back(i);
+    }
+
+    // disk writes block, so they get their own threads instead of tying up the job pool
+    if (writer_count == 0)
+      writer_count = (std::thread::hardware_concurrency() > 2) ? 2 : 1;
+
+    stopping_ = false;
+    for (size_t i = 0; i < writer_count; ++i)
+      writers_.push_back(std::thread(&FrameCapture::writerLoop, this));
+
+    return true;
+  }
+
+
+  void FrameCapture::capture()
+  {
+    if (writers_.empty()) return;
+    double start_time = Time::current();
+
+    Slot &slot = slots_[next_slot_];
+    if (slot.fence)
+      resolve(slot);
+
+    GLStateCache *cache = GLStateCache::instance();
+    cache->bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+
+    // with a pack buffer bound this only queues the copy and returns
+    cache->bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)0);
+    cache->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frame_count_++;
+    cache->countApiCalls(3);
+
+    next_slot_ = (next_slot_ + 1) % RING_SIZE;
+    readback_time_ = Time::current() - start_time;
+  }
+
+
+  void FrameCapture::finish()
+  {
+    if (writers_.empty()) return;
+
+    // oldest first, so the writers see the frames in order
+    for (size_t i = 0; i < RING_SIZE; ++i)
+    {
+      Slot &slot = slots_[(next_slot_ + i) % RING_SIZE];
+      if (slot.fence)
+        resolve(slot);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    frame_queued_.notify_all();
+
+    for (auto &writer : writers_)
+      writer.join();
+    writers_.clear();
+
+    std::cout << "Captured " << frames_written_ << " frames to " << directory_ << "\n";
+  }
+
+
+  CaptureStats FrameCapture::getStats() const
+  {
+    CaptureStats stats = CaptureStats();
+    stats.frames_read = frames_read_;
+    stats.frames_written = frames_written_;
+    stats.write_failures = write_failures_;
+    stats.fence_waits = fence_waits_;
+    stats.writer_waits = writer_waits_;
+    stats.readback_time = readback_time_;
+    if (stats.frames_written)
+      stats.encode_time = (double)encode_microseconds_ / 1000.0 / stats.frames_written;
+    return stats;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void FrameCapture::resolve(Slot &slot)
+  {
+    // normally signaled long ago, RING_SIZE frames have passed since the read was queued
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+      fence_waits_++;
+      status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+      std::cerr << "WARNING: dropped captured frame " << slot.frame << ", readback never finished.\n";
+      return;
+    }
+
+    size_t frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (free_frames_.empty())
+      {
+        // the disk can't keep up, holding the frame here is what keeps memory bounded
+        writer_waits_++;
+        frame_released_.wait(lock, [this] { return !free_frames_.empty(); });
+      }
+      frame = free_frames_.back();
+      free_frames_.pop_back();
+    }
+
+    const size_t frame_size = frames_[frame].pixels.size();
+    GLStateCache *cache = GLStateCache::instance();
+    cache->bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_size, GL_MAP_READ_BIT);
+    if (pixels)
+    {
+      std::memcpy(frames_[frame].pixels.data(), pixels, frame_size);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    cache->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    cache->countApiCalls(2);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!pixels)
+    {
+      free_frames_.push_back(frame);
+      return;
+    }
+
+    frames_[frame].index = slot.frame;
+    queued_[(queue_head_ + queue_count_) % MAX_QUEUED] = frame;
+    queue_count_++;
+    frames_read_++;
+    frame_queued_.notify_one();
+  }
+
+
+  void FrameCapture::writerLoop()
+  {
+    while (true)
+    {
+      size_t frame;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        frame_queued_.wait(lock, [this] { return stopping_ || queue_count_ > 0; });
+        if (queue_count_ == 0) return;
+
+        frame = queued_[queue_head_];
+        queue_head_ = (queue_head_ + 1) % MAX_QUEUED;
+        queue_count_--;
+      }
+
+      double start_time = Time::current();
+      if (writeFrame(frames_[frame]))
+      {
+        frames_written_++;
+        encode_microseconds_ += (uint64_t)((Time::current() - start_time) * 1000.0);
+      }
+      else
+      {
+        // one message is enough, a bad directory would otherwise print every frame
+        if (write_failures_++ == 0)
+          std::cerr << "ERROR: failed to write captured frames to " << directory_ << "\n";
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_frames_.push_back(frame);
+      }
+      frame_released_.notify_one();
+    }
+  }
+
+
+  bool FrameCapture::writeFrame(const Frame &frame) const
+  {
+    char name[64];
+    if (format_ == CAPTURE_RAW)
+      std::snprintf(name, sizeof(name), "frame_%06zu_%dx%d.rgba", frame.index, width_, height_);
+    else
+      std::snprintf(name, sizeof(name), "frame_%06zu.png", frame.index);
+
+    std::ofstream file((directory_ + name).c_str(), std::ios::binary);
+    if (!file.is_open()) return false;
+
+    if (format_ == CAPTURE_RAW)
+    {
+      // flipped here rather than on the gpu, rows are written top first like every image format
+      const size_t row_size = (size_t)width_ * 4;
+      for (int y = height_ - 1; y >= 0; --y)
+        file.write((const char *)&frame.pixels[y * row_size], row_size);
+    }
+    else
+    {
+      std::vector<uint8_t> png;
+      encodePng(frame.pixels.data(), width_, height_, png);
+      file.write((const char *)png.data(), png.size());
+    }
+
+    return file.good();
+  }
+
+
+  void FrameCapture::release()
+  {
+    GLStateCache *cache = GLStateCache::instance();
+    for (size_t i = 0; i < RING_SIZE; ++i)
+    {
+      if (slots_[i].fence)
+        glDeleteSync(slots_[i].fence);
+      slots_[i].fence = nullptr;
+
+      if (slots_[i].buffer)
+      {
+        cache->onDeleteBuffer(slots_[i].buffer);
+        glDeleteBuffers(1, &slots_[i].buffer);
+        slots_[i].buffer = 0;
+      }
+    }
+  }
+} // namespace vv
\ No newline at end of file
@@ -0,0 +1,154 @@
+
+#include <cstring>
+
+#include "vv/GLRenderBackend.h"
+#include "vv/GLStateCache.h"
+
+namespace vv
+{
+  /////////////////////////////////////////////////////////////////////// public
+  GLRenderBackend::GLRenderBackend() :
+    current_shader_(NONE),
+    current_material_(NONE)
+  {
+  }
+
+
+  GLRenderBackend::~GLRenderBackend()
+  {
+  }
+
+
+  uint32_t GLRenderBackend::registerShader(Shader *shader)
+  {
+    shaders_.push_back(shader);
+    return (uint32_t)shaders_.size() - 1;
+  }
+
+
+  uint32_t GLRenderBackend::registerMaterial(const PackedMaterial *material, const TexturePacker *packer)
+  {
+    MaterialEntry entry = { material, packer };
+    materials_.push_back(entry);
+    return (uint32_t)materials_.size() - 1;
+  }
+
+
+  uint32_t GLRenderBackend::registerMesh(GLuint vao, GLsizei index_count, GLenum index_type, GLenum mode)
+  {
+    MeshEntry entry = { vao, index_count, index_type, mode };
+    meshes_.push_back(entry);
+    return (uint32_t)meshes_.size() - 1;
+  }
+
+
+  uint32_t GLRenderBackend::registerUniform(std::string name)
+  {
+    for (size_t i = 0; i < uniform_names_.size(); ++i)
+      if (uniform_names_[i] == name)
+        return (uint32_t)i;
+
+    uniform_names_.push_back(name);
+    return (uint32_t)uniform_names_.size() - 1;
+  }
+
+
+  void GLRenderBackend::beginSubmit()
+  {
+    current_shader_ = NONE;
+    current_material_ = NONE;
+  }
+
+
+  void GLRenderBackend::execute(const RenderCommand &command)
+  {
+    GLStateCache *state = GLStateCache::instance();
+
+    switch (command.type)
+    {
+      case COMMAND_BIND_MATERIAL:
+      {
+        const BindMaterialPacket &packet = command.bind_material;
+        if (packet.shader != current_shader_ && packet.shader < shaders_.size())
+        {
+          shaders_[packet.shader]->useProgram();
+          current_shader_ = packet.shader;
+          current_material_ = NONE; // texture uniforms live in the program
+        }
+
+        if (packet.material != current_material_ && packet.material < materials_.size())
+        {
+          const MaterialEntry &entry = materials_[packet.material];
+          if (entry.material && entry.packer && current_shader_ != NONE)
+            entry.packer->bindMaterial(*entry.material, shaders_[current_shader_]);
+          current_material_ = packet.material;
+        }
+        break;
+      }
+
+      case COMMAND_SET_UNIFORM:
+      {
+        const SetUniformPacket &packet = command.set_uniform;
+        GLint location = getUniformLocation(packet.uniform);
+        if (location == -1) break;
+
+        switch (packet.type)
+        {
+          case UNIFORM_FLOAT: glUniform1fv(location, 1, packet.data); break;
+          case UNIFORM_VEC3:  glUniform3fv(location, 1, packet.data); break;
+          case UNIFORM_VEC4:  glUniform4fv(location, 1, packet.data); break;
+          case UNIFORM_MAT4:  glUniformMatrix4fv(location, 1, GL_FALSE, packet.data); break;
+          case UNIFORM_INT:
+          {
+            GLint value;
+            std::memcpy(&value, packet.data, sizeof(value));
+            glUniform1i(location, value);
+            break;
+          }
+        }
+        state->countApiCalls();
+        break;
+      }
+
+      case COMMAND_DRAW:
+      {
+        const DrawPacket &packet = command.draw;
+        if (packet.mesh >= meshes_.size()) break;
+
+        const MeshEntry &mesh = meshes_[packet.mesh];
+        GLsizei index_count = packet.index_count ? (GLsizei)packet.index_count : mesh.index_count;
+        size_t index_size = (mesh.index_type == GL_UNSIGNED_INT) ? 4 : (mesh.index_type == GL_UNSIGNED_SHORT) ? 2 : 1;
+        const void *offset = (const void *)(packet.first_index * index_size);
+
+        state->bindVertexArray(mesh.vao);
+        if (packet.instance_count > 1)
+          state->drawElementsInstanced(mesh.mode, index_count, mesh.index_type, offset, packet.instance_count);
+        else
+          state->drawElements(mesh.mode, index_count, mesh.index_type, offset);
+        break;
+      }
+    }
+  }
+
+
+  void GLRenderBackend::endSubmit()
+  {
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  GLint GLRenderBackend::getUniformLocation(uint32_t uniform)
+  {
+    if (current_shader_ == NONE || uniform >= uniform_names_.size()) return -1;
+
+    uint64_t key = ((uint64_t)current_shader_ << 32) | uniform;
+    auto cached = uniform_locations_.find(key);
+    if (cached != uniform_locations_.end())
+      return cached->second;
+
+    // missing uniforms are cached as -1 too, variants compile unused ones out
+    GLint location = glGetUniformLocation(shaders_[current_shader_]->getProgramId(), uniform_names_[uniform].c_str());
+    uniform_locations_[key] = location;
+    return location;
+  }
+} // namespace vv
\ No newline at end of file
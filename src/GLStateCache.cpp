@@ -0,0 +1,348 @@
+
+#include "vv/GLStateCache.h"
+
+namespace vv
+{
+  GLStateCache* GLStateCache::instance_ = nullptr;
+
+  /////////////////////////////////////////////////////////////////////// public
+  GLStateCache* GLStateCache::instance()
+  {
+    if (!instance_)
+      instance_ = new GLStateCache;
+
+    return instance_;
+  }
+
+
+  void GLStateCache::beginFrame()
+  {
+    frame_counters_ = current_counters_;
+    current_counters_ = GLFrameCounters();
+  }
+
+
+  const GLFrameCounters& GLStateCache::getFrameCounters() const
+  {
+    return frame_counters_;
+  }
+
+
+  const GLFrameCounters& GLStateCache::getCurrentCounters() const
+  {
+    return current_counters_;
+  }
+
+
+  void GLStateCache::countApiCalls(size_t count)
+  {
+    current_counters_.api_calls += count;
+  }
+
+
+  void GLStateCache::invalidate()
+  {
+    program_ = UNKNOWN;
+    vao_ = UNKNOWN;
+    active_unit_ = UNKNOWN;
+    draw_framebuffer_ = UNKNOWN;
+    read_framebuffer_ = UNKNOWN;
+
+    for (int i = 0; i < BUFFER_TARGET_COUNT; ++i)
+      buffers_[i] = UNKNOWN;
+
+    for (int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+      for (int target = 0; target < TEXTURE_TARGET_COUNT; ++target)
+        textures_[unit][target] = UNKNOWN;
+
+    blend_ = -1;
+    depth_test_ = -1;
+    depth_mask_ = -1;
+    cull_face_ = -1;
+    blend_source_ = UNKNOWN;
+    blend_destination_ = UNKNOWN;
+    depth_func_ = UNKNOWN;
+    viewport_[0] = viewport_[1] = viewport_[2] = viewport_[3] = -1;
+  }
+
+
+  void GLStateCache::onDeleteProgram(GLuint program)
+  {
+    // a deleted program stays current until something else is used
+    if (program_ == program)
+      program_ = UNKNOWN;
+  }
+
+
+  void GLStateCache::onDeleteVertexArray(GLuint vao)
+  {
+    if (vao_ == vao)
+      vao_ = 0;
+  }
+
+
+  void GLStateCache::onDeleteBuffer(GLuint buffer)
+  {
+    for (int i = 0; i < BUFFER_TARGET_COUNT; ++i)
+      if (buffers_[i] == buffer)
+        buffers_[i] = 0;
+  }
+
+
+  void GLStateCache::onDeleteTexture(GLuint texture)
+  {
+    for (int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+      for (int target = 0; target < TEXTURE_TARGET_COUNT; ++target)
+        if (textures_[unit][target] == texture)
+          textures_[unit][target] = 0;
+  }
+
+
+  void GLStateCache::onDeleteFramebuffer(GLuint framebuffer)
+  {
+    // deleting a bound framebuffer reverts that binding to the window
+    if (draw_framebuffer_ == framebuffer)
+      draw_framebuffer_ = 0;
+    if (read_framebuffer_ == framebuffer)
+      read_framebuffer_ = 0;
+  }
+
+
+  void GLStateCache::useProgram(GLuint program)
+  {
+    if (program_ == program) return redundant();
+
+    glUseProgram(program);
+    program_ = program;
+    changed();
+  }
+
+
+  void GLStateCache::bindVertexArray(GLuint vao)
+  {
+    if (vao_ == vao) return redundant();
+
+    glBindVertexArray(vao);
+    vao_ = vao;
+    changed();
+
+    // the element buffer binding belongs to the vao
+    buffers_[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+  }
+
+
+  void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+  {
+    int slot = bufferSlot(target);
+    if (slot >= 0 && buffers_[slot] == buffer) return redundant();
+
+    glBindBuffer(target, buffer);
+    if (slot >= 0) buffers_[slot] = buffer;
+    changed();
+  }
+
+
+  void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+  {
+    int slot = textureSlot(target);
+    bool tracked = (slot >= 0) && (unit < (GLuint)MAX_TEXTURE_UNITS);
+    if (tracked && textures_[unit][slot] == texture) return redundant();
+
+    if (active_unit_ != unit)
+    {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      active_unit_ = unit;
+      changed();
+    }
+
+    glBindTexture(target, texture);
+    if (tracked) textures_[unit][slot] = texture;
+    changed();
+  }
+
+
+  void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+  {
+    bool draw = (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER);
+    bool read = (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER);
+    if ((!draw || draw_framebuffer_ == framebuffer) && (!read || read_framebuffer_ == framebuffer))
+      return redundant();
+
+    glBindFramebuffer(target, framebuffer);
+    if (draw) draw_framebuffer_ = framebuffer;
+    if (read) read_framebuffer_ = framebuffer;
+    changed();
+  }
+
+
+  void GLStateCache::setBlend(bool enabled)
+  {
+    setCapability(GL_BLEND, enabled, blend_);
+  }
+
+
+  void GLStateCache::setBlendFunc(GLenum source, GLenum destination)
+  {
+    if (blend_source_ == source && blend_destination_ == destination) return redundant();
+
+    glBlendFunc(source, destination);
+    blend_source_ = source;
+    blend_destination_ = destination;
+    changed();
+  }
+
+
+  void GLStateCache::setDepthTest(bool enabled)
+  {
+    setCapability(GL_DEPTH_TEST, enabled, depth_test_);
+  }
+
+
+  void GLStateCache::setDepthMask(bool enabled)
+  {
+    if (depth_mask_ == (int)enabled) return redundant();
+
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    depth_mask_ = enabled;
+    changed();
+  }
+
+
+  void GLStateCache::setDepthFunc(GLenum function)
+  {
+    if (depth_func_ == function) return redundant();
+
+    glDepthFunc(function);
+    depth_func_ = function;
+    changed();
+  }
+
+
+  void GLStateCache::setCullFace(bool enabled)
+  {
+    setCapability(GL_CULL_FACE, enabled, cull_face_);
+  }
+
+
+  void GLStateCache::setViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+  {
+    if (viewport_[0] == x && viewport_[1] == y && viewport_[2] == width && viewport_[3] == height)
+      return redundant();
+
+    glViewport(x, y, width, height);
+    viewport_[0] = x;
+    viewport_[1] = y;
+    viewport_[2] = width;
+    viewport_[3] = height;
+    changed();
+  }
+
+
+  void GLStateCache::drawArrays(GLenum mode, GLint first, GLsizei count)
+  {
+    glDrawArrays(mode, first, count);
+    current_counters_.api_calls++;
+    current_counters_.draw_calls++;
+  }
+
+
+  void GLStateCache::drawElements(GLenum mode, GLsizei count, GLenum type, const void *offset)
+  {
+    glDrawElements(mode, count, type, offset);
+    current_counters_.api_calls++;
+    current_counters_.draw_calls++;
+  }
+
+
+  void GLStateCache::drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+  {
+    glDrawArraysInstanced(mode, first, count, instances);
+    current_counters_.api_calls++;
+    current_counters_.draw_calls++;
+  }
+
+
+  void GLStateCache::drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *offset, GLsizei instances)
+  {
+    glDrawElementsInstanced(mode, count, type, offset, instances);
+    current_counters_.api_calls++;
+    current_counters_.draw_calls++;
+  }
+
+
+  void GLStateCache::multiDrawElementsIndirect(GLenum mode, GLenum type, const void *offset, GLsizei draw_count)
+  {
+    // one call as far as the cpu is concerned, however many draws the buffer holds
+    glMultiDrawElementsIndirect(mode, type, offset, draw_count, 0);
+    current_counters_.api_calls++;
+    current_counters_.draw_calls++;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  GLStateCache::GLStateCache()
+  {
+    frame_counters_ = GLFrameCounters();
+    current_counters_ = GLFrameCounters();
+    invalidate();
+  }
+
+
+  int GLStateCache::bufferSlot(GLenum target)
+  {
+    switch (target)
+    {
+      case GL_ARRAY_BUFFER:         return 0;
+      case GL_ELEMENT_ARRAY_BUFFER: return 1;
+      case GL_UNIFORM_BUFFER:       return 2;
+      case GL_PIXEL_PACK_BUFFER:    return 3;
+      case GL_PIXEL_UNPACK_BUFFER:  return 4;
+      case GL_TEXTURE_BUFFER:       return 5;
+#ifdef GL_DRAW_INDIRECT_BUFFER
+      case GL_DRAW_INDIRECT_BUFFER: return 6;
+#endif
+      default:                      return -1;
+    }
+  }
+
+
+  int GLStateCache::textureSlot(GLenum target)
+  {
+    switch (target)
+    {
+      case GL_TEXTURE_2D:       return 0;
+      case GL_TEXTURE_2D_ARRAY: return 1;
+      case GL_TEXTURE_BUFFER:   return 2;
+      case GL_TEXTURE_CUBE_MAP: return 3;
+      case GL_TEXTURE_3D:       return 4;
+      default:                  return -1;
+    }
+  }
+
+
+  void GLStateCache::setCapability(GLenum capability, bool enabled, int &cached)
+  {
+    if (cached == (int)enabled) return redundant();
+
+    if (enabled)
+      glEnable(capability);
+    else
+      glDisable(capability);
+
+    cached = enabled;
+    changed();
+  }
+
+
+  void GLStateCache::changed()
+  {
+    current_counters_.api_calls++;
+    current_counters_.state_changes++;
+  }
+
+
+  void GLStateCache::redundant()
+  {
+    current_counters_.redundant_calls++;
+  }
+} // namespace vv
\ No newline at end of file
@@ -0,0 +1,359 @@
+
+#include <algorithm>
+#include <iostream>
+
+#include "vv/Frustum.h"
+#include "vv/GLStateCache.h"
+#include "vv/IndirectRenderer.h"
+#include "vv/MemoryTracker.h"
+#include "vv/Settings.h"
+#include "vv/Shader.h"
+#include "vv/Time.h"
+
+namespace vv
+{
+  static GLuint compileComputeProgram(const std::string &file)
+  {
+    std::string source = Shader::loadShaderFromFile(file);
+    const GLchar *source_pointer = source.c_str();
+
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source_pointer, NULL);
+    glCompileShader(shader);
+
+    GLint success = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+      char log[1024];
+      glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+      std::cerr << "ERROR: failed to compile compute shader " << file << ":\n" << log << "\n";
+      glDeleteShader(shader);
+      return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+      char log[1024];
+      glGetProgramInfoLog(program, sizeof(log), NULL, log);
+      std::cerr << "ERROR: failed to link compute program " << file << ":\n" << log << "\n";
+      glDeleteProgram(program);
+      return 0;
+    }
+
+    return program;
+  }
+
+
+  /////////////////////////////////////////////////////////////////////// public
+  IndirectRenderer::IndirectRenderer() :
+    cull_program_(0),
+    planes_location_(-1),
+    instance_count_location_(-1),
+    bounds_buffer_(0),
+    transform_buffer_(0),
+    transform_texture_(0),
+    command_buffer_(0),
+    reset_buffer_(0),
+    visible_buffer_(0),
+    buffer_capacity_(0),
+    dirty_begin_(0),
+    dirty_end_(0),
+    layout_dirty_(false)
+  {
+    stats_ = IndirectStats();
+  }
+
+
+  IndirectRenderer::~IndirectRenderer()
+  {
+    GLStateCache *cache = GLStateCache::instance();
+
+    GLuint buffers[] = { bounds_buffer_, transform_buffer_, command_buffer_, reset_buffer_, visible_buffer_ };
+    for (auto buffer : buffers)
+    {
+      cache->onDeleteBuffer(buffer);
+      glDeleteBuffers(1, &buffer);
+    }
+
+    cache->onDeleteTexture(transform_texture_);
+    glDeleteTextures(1, &transform_texture_);
+
+    cache->onDeleteProgram(cull_program_);
+    glDeleteProgram(cull_program_);
+  }
+
+
+  bool IndirectRenderer::isSupported()
+  {
+    // compute shaders, storage buffers and multi draw indirect all arrived with 4.3
+    return GLAD_GL_VERSION_4_3 != 0;
+  }
+
+
+  bool IndirectRenderer::init()
+  {
+    if (cull_program_) return true;
+
+    if (!isSupported())
+    {
+      std::cerr << "ERROR: gpu driven rendering needs an OpenGL 4.3 context.\n";
+      return false;
+    }
+
+    cull_program_ = compileComputeProgram(Settings::instance()->getShaderLocation() + "cull_instances.comp");
+    if (!cull_program_) return false;
+
+    planes_location_ = glGetUniformLocation(cull_program_, "planes");
+    instance_count_location_ = glGetUniformLocation(cull_program_, "instance_count");
+
+    glGenBuffers(1, &bounds_buffer_);
+    glGenBuffers(1, &transform_buffer_);
+    glGenBuffers(1, &command_buffer_);
+    glGenBuffers(1, &reset_buffer_);
+    glGenBuffers(1, &visible_buffer_);
+    glGenTextures(1, &transform_texture_);
+
+    // the vertex arrays point at the visible list as soon as meshes register, so it has to exist
+    GLStateCache *cache = GLStateCache::instance();
+    cache->bindBuffer(GL_ARRAY_BUFFER, visible_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+    cache->bindBuffer(GL_TEXTURE_BUFFER, transform_buffer_);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::mat4), nullptr, GL_STATIC_DRAW);
+    cache->bindTexture(0, GL_TEXTURE_BUFFER, transform_texture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, transform_buffer_);
+
+    return true;
+  }
+
+
+  uint32_t IndirectRenderer::registerMesh(GLuint vao, GLuint first_index, GLuint index_count, GLint base_vertex)
+  {
+    VV_MEMORY_SCOPE(MEMORY_RENDERING);
+
+    DrawCommand command = { index_count, 0, first_index, base_vertex, 0 };
+    commands_.push_back(command);
+    mesh_instances_.push_back(0);
+    layout_dirty_ = true;
+
+    if (!batches_.empty() && batches_.back().vao == vao)
+    {
+      batches_.back().command_count++;
+    }
+    else
+    {
+      Batch batch = { vao, commands_.size() - 1, 1 };
+      batches_.push_back(batch);
+
+      // instanced by one, so every draw's base instance offsets it into that mesh's slots
+      GLStateCache *cache = GLStateCache::instance();
+      cache->bindVertexArray(vao);
+      cache->bindBuffer(GL_ARRAY_BUFFER, visible_buffer_);
+      glEnableVertexAttribArray(INSTANCE_ATTRIBUTE);
+      glVertexAttribIPointer(INSTANCE_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid *)0);
+      glVertexAttribDivisor(INSTANCE_ATTRIBUTE, 1);
+      cache->bindVertexArray(0);
+    }
+
+    return (uint32_t)commands_.size() - 1;
+  }
+
+
+  uint32_t IndirectRenderer::addInstance(uint32_t mesh, const glm::mat4 &model, const AABB &world_bounds)
+  {
+    VV_MEMORY_SCOPE(MEMORY_RENDERING);
+
+    InstanceBounds bounds = { glm::vec3(0.0f), mesh, glm::vec3(0.0f), 0.0f };
+    bounds_.push_back(bounds);
+    transforms_.push_back(model);
+    mesh_instances_[mesh]++;
+    layout_dirty_ = true;
+
+    uint32_t instance = (uint32_t)transforms_.size() - 1;
+    setInstance(instance, model, world_bounds);
+    return instance;
+  }
+
+
+  void IndirectRenderer::setInstance(uint32_t instance, const glm::mat4 &model, const AABB &world_bounds)
+  {
+    bounds_[instance].min = world_bounds.min;
+    bounds_[instance].max = world_bounds.max;
+    transforms_[instance] = model;
+    markDirty(instance);
+  }
+
+
+  void IndirectRenderer::clearInstances()
+  {
+    bounds_.clear();
+    transforms_.clear();
+    for (auto &count : mesh_instances_)
+      count = 0;
+
+    dirty_begin_ = dirty_end_ = 0;
+    layout_dirty_ = true;
+  }
+
+
+  size_t IndirectRenderer::getInstanceCount() const
+  {
+    return transforms_.size();
+  }
+
+
+  void IndirectRenderer::cull(const glm::mat4 &view_projection)
+  {
+    double start_time = Time::current();
+    stats_.instances = transforms_.size();
+    stats_.draws = commands_.size();
+    stats_.batches = 0;
+    stats_.submit_time = 0.0;
+    if (!cull_program_ || transforms_.empty()) return;
+
+    upload();
+
+    GLStateCache *cache = GLStateCache::instance();
+
+    // every mesh starts the frame with no visible instances
+    size_t command_size = commands_.size() * sizeof(DrawCommand);
+    cache->bindBuffer(GL_COPY_READ_BUFFER, reset_buffer_);
+    cache->bindBuffer(GL_COPY_WRITE_BUFFER, command_buffer_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, command_size);
+
+    Frustum frustum(view_projection);
+
+    cache->useProgram(cull_program_);
+    glUniform4fv(planes_location_, 6, &frustum.planes[0].x);
+    glUniform1ui(instance_count_location_, (GLuint)transforms_.size());
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, bounds_buffer_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, command_buffer_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visible_buffer_);
+
+    GLuint groups = (GLuint)((transforms_.size() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+    glDispatchCompute(groups, 1, 1);
+
+    // the commands are read as draw parameters and the visible list as a vertex attribute
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    cache->countApiCalls(9);
+
+    stats_.submit_time += Time::current() - start_time;
+  }
+
+
+  void IndirectRenderer::draw()
+  {
+    if (!cull_program_ || transforms_.empty()) return;
+    double start_time = Time::current();
+
+    GLStateCache *cache = GLStateCache::instance();
+    cache->bindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+
+    for (auto &batch : batches_)
+    {
+      cache->bindVertexArray(batch.vao);
+      cache->multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                       (const void *)(batch.first_command * sizeof(DrawCommand)),
+                                       (GLsizei)batch.command_count);
+    }
+
+    stats_.batches = batches_.size();
+    stats_.submit_time += Time::current() - start_time;
+  }
+
+
+  void IndirectRenderer::bindTransforms(GLuint unit)
+  {
+    GLStateCache::instance()->bindTexture(unit, GL_TEXTURE_BUFFER, transform_texture_);
+  }
+
+
+  const IndirectStats& IndirectRenderer::getStats() const
+  {
+    return stats_;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void IndirectRenderer::upload()
+  {
+    if (!layout_dirty_ && dirty_begin_ == dirty_end_) return;
+    double start_time = Time::current();
+
+    GLStateCache *cache = GLStateCache::instance();
+    size_t instance_count = transforms_.size();
+
+    if (instance_count > buffer_capacity_)
+    {
+      // grow by half so streaming instances in doesn't reallocate every frame
+      buffer_capacity_ = instance_count + instance_count / 2;
+
+      cache->bindBuffer(GL_SHADER_STORAGE_BUFFER, bounds_buffer_);
+      glBufferData(GL_SHADER_STORAGE_BUFFER, buffer_capacity_ * sizeof(InstanceBounds), nullptr, GL_STATIC_DRAW);
+      cache->bindBuffer(GL_TEXTURE_BUFFER, transform_buffer_);
+      glBufferData(GL_TEXTURE_BUFFER, buffer_capacity_ * sizeof(glm::mat4), nullptr, GL_STATIC_DRAW);
+      cache->bindBuffer(GL_ARRAY_BUFFER, visible_buffer_);
+      glBufferData(GL_ARRAY_BUFFER, buffer_capacity_ * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+      cache->countApiCalls(3);
+
+      dirty_begin_ = 0;
+      dirty_end_ = instance_count;
+    }
+
+    if (dirty_begin_ < dirty_end_)
+    {
+      size_t count = dirty_end_ - dirty_begin_;
+      cache->bindBuffer(GL_SHADER_STORAGE_BUFFER, bounds_buffer_);
+      glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirty_begin_ * sizeof(InstanceBounds),
+                      count * sizeof(InstanceBounds), &bounds_[dirty_begin_]);
+      cache->bindBuffer(GL_TEXTURE_BUFFER, transform_buffer_);
+      glBufferSubData(GL_TEXTURE_BUFFER, dirty_begin_ * sizeof(glm::mat4),
+                      count * sizeof(glm::mat4), &transforms_[dirty_begin_]);
+      cache->countApiCalls(2);
+      dirty_begin_ = dirty_end_ = 0;
+    }
+
+    if (layout_dirty_)
+    {
+      // each mesh owns as many visible slots as it has instances
+      GLuint base_instance = 0;
+      for (size_t i = 0; i < commands_.size(); ++i)
+      {
+        commands_[i].base_instance = base_instance;
+        base_instance += mesh_instances_[i];
+      }
+
+      size_t command_size = commands_.size() * sizeof(DrawCommand);
+      cache->bindBuffer(GL_COPY_WRITE_BUFFER, reset_buffer_);
+      glBufferData(GL_COPY_WRITE_BUFFER, command_size, commands_.data(), GL_STATIC_COPY);
+      cache->bindBuffer(GL_COPY_WRITE_BUFFER, command_buffer_);
+      glBufferData(GL_COPY_WRITE_BUFFER, command_size, nullptr, GL_DYNAMIC_COPY);
+      cache->countApiCalls(2);
+      layout_dirty_ = false;
+    }
+
+    stats_.upload_time = Time::current() - start_time;
+  }
+
+
+  void IndirectRenderer::markDirty(size_t instance)
+  {
+    if (dirty_begin_ == dirty_end_)
+    {
+      dirty_begin_ = instance;
+      dirty_end_ = instance + 1;
+      return;
+    }
+
+    dirty_begin_ = std::min(dirty_begin_, instance);
+    dirty_end_ = std::max(dirty_end_, instance + 1);
+  }
+} // namespace vv
\ No newline at end of file
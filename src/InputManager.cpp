@@ -1,5 +1,6 @@
 
 #include "vv/InputManager.h"
+#include "vv/MemoryTracker.h"
 
 namespace vv
 {
@@ -8,6 +9,7 @@ namespace vv
     curr_x_(0.0),
     curr_y_(0.0)
   {
+    VV_MEMORY_SCOPE(MEMORY_INPUT);
     key_pressed_tracker_.resize(GLFW_KEY_LAST);
   }
 
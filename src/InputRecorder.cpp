@@ -0,0 +1,269 @@
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "vv/InputRecorder.h"
+#include "vv/Time.h"
+
+namespace vv
+{
+  static const char FILE_MAGIC[4] = { 'V', 'V', 'R', 'P' };
+
+  /////////////////////////////////////////////////////////////////////// public
+  InputRecorder::InputRecorder(GLFWState *target) :
+    target_(target),
+    mode_(RECORDER_OFF),
+    speed_(REPLAY_RECORDED),
+    frame_count_(0),
+    finished_(false),
+    interrupted_(false),
+    replay_start_(0.0),
+    replay_elapsed_(0.0)
+  {
+  }
+
+
+  InputRecorder::~InputRecorder()
+  {
+    stop();
+  }
+
+
+  bool InputRecorder::startRecording(const std::string &file)
+  {
+    stop();
+
+    file_.open(file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file_.is_open())
+    {
+      std::cerr << "ERROR: Could not open " << file << " for recording.\n";
+      return false;
+    }
+
+    uint16_t version = FILE_VERSION, reserved = 0;
+    write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    write(&version, sizeof(version));
+    write(&reserved, sizeof(reserved));
+
+    file_name_ = file;
+    mode_ = RECORDER_RECORD;
+    frame_count_ = 0;
+    finished_ = false;
+    return true;
+  }
+
+
+  bool InputRecorder::startReplay(const std::string &file, ReplaySpeed speed)
+  {
+    stop();
+
+    file_.open(file.c_str(), std::ios::in | std::ios::binary);
+    if (!file_.is_open())
+    {
+      std::cerr << "ERROR: Could not open replay " << file << "\n";
+      return false;
+    }
+
+    char magic[4];
+    uint16_t version = 0, reserved = 0;
+    if (!read(magic, sizeof(magic)) || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0 ||
+        !read(&version, sizeof(version)) || !read(&reserved, sizeof(reserved)))
+    {
+      std::cerr << "ERROR: " << file << " is not an input recording.\n";
+      file_.close();
+      return false;
+    }
+
+    if (version != FILE_VERSION)
+    {
+      std::cerr << "ERROR: " << file << " was recorded with format version " << version
+                << ", expected " << FILE_VERSION << ".\n";
+      file_.close();
+      return false;
+    }
+
+    file_name_ = file;
+    mode_ = RECORDER_REPLAY;
+    speed_ = speed;
+    frame_count_ = 0;
+    finished_ = false;
+    interrupted_ = false;
+    replay_start_ = Time::current();
+    replay_elapsed_ = 0.0;
+    return true;
+  }
+
+
+  void InputRecorder::stop()
+  {
+    if (mode_ == RECORDER_RECORD)
+    {
+      uint8_t type = RECORD_END;
+      write(&type, sizeof(type));
+      std::cout << "Recorded " << frame_count_ << " frames to " << file_name_ << "\n";
+    }
+
+    if (file_.is_open())
+      file_.close();
+
+    mode_ = RECORDER_OFF;
+  }
+
+
+  RecorderMode InputRecorder::getMode() const
+  {
+    return mode_;
+  }
+
+
+  ReplaySpeed InputRecorder::getSpeed() const
+  {
+    return speed_;
+  }
+
+
+  bool InputRecorder::isFinished() const
+  {
+    return finished_;
+  }
+
+
+  bool InputRecorder::isInterrupted() const
+  {
+    return interrupted_;
+  }
+
+
+  size_t InputRecorder::getFrameCount() const
+  {
+    return frame_count_;
+  }
+
+
+  double InputRecorder::beginFrame(double delta_time)
+  {
+    if (mode_ == RECORDER_RECORD)
+    {
+      uint8_t type = RECORD_FRAME;
+      write(&type, sizeof(type));
+      write(&delta_time, sizeof(delta_time));
+      frame_count_++;
+      return delta_time;
+    }
+
+    if (mode_ != RECORDER_REPLAY || finished_)
+      return delta_time;
+
+    uint8_t type = RECORD_END;
+    double recorded_delta = 0.0;
+    if (!read(&type, sizeof(type)) || type != RECORD_FRAME || !read(&recorded_delta, sizeof(recorded_delta)))
+    {
+      finished_ = true;
+      return delta_time;
+    }
+
+    frame_count_++;
+    replay_elapsed_ += recorded_delta;
+
+    // running ahead of the recording is the only case that needs fixing, a slower machine
+    // simply replays slower since every frame still steps by the recorded delta
+    if (speed_ == REPLAY_RECORDED)
+    {
+      double ahead = replay_elapsed_ - (Time::current() - replay_start_);
+      if (ahead > 0.0)
+        std::this_thread::sleep_for(std::chrono::microseconds((long long)(ahead * 1000.0)));
+    }
+
+    return recorded_delta;
+  }
+
+
+  void InputRecorder::pollEvents()
+  {
+    // keeps the window responsive, live input never reaches the target while replaying
+    glfwPollEvents();
+
+    if (mode_ == RECORDER_REPLAY && !finished_)
+      replayEvents();
+  }
+
+
+  void InputRecorder::keyCallback(GLFWwindow *window, int key, int scan_code, int action, int mods)
+  {
+    if (mode_ == RECORDER_REPLAY)
+    {
+      if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        interrupted_ = true;
+      return;
+    }
+
+    if (mode_ == RECORDER_RECORD)
+    {
+      uint8_t type = RECORD_KEY;
+      int32_t values[2] = { key, scan_code };
+      uint8_t flags[2] = { (uint8_t)action, (uint8_t)mods };
+      write(&type, sizeof(type));
+      write(values, sizeof(values));
+      write(flags, sizeof(flags));
+    }
+
+    target_->keyCallback(window, key, scan_code, action, mods);
+  }
+
+
+  void InputRecorder::mouseCallback(GLFWwindow *window, double curr_x, double curr_y)
+  {
+    if (mode_ == RECORDER_REPLAY) return;
+
+    if (mode_ == RECORDER_RECORD)
+    {
+      uint8_t type = RECORD_MOUSE;
+      double position[2] = { curr_x, curr_y };
+      write(&type, sizeof(type));
+      write(position, sizeof(position));
+    }
+
+    target_->mouseCallback(window, curr_x, curr_y);
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void InputRecorder::write(const void *data, size_t size)
+  {
+    file_.write((const char *)data, size);
+  }
+
+
+  bool InputRecorder::read(void *data, size_t size)
+  {
+    file_.read((char *)data, size);
+    return (size_t)file_.gcount() == size;
+  }
+
+
+  void InputRecorder::replayEvents()
+  {
+    // everything up to the next frame record was polled during the current frame
+    while (file_.peek() == RECORD_KEY || file_.peek() == RECORD_MOUSE)
+    {
+      uint8_t type = 0;
+      read(&type, sizeof(type));
+
+      if (type == RECORD_KEY)
+      {
+        int32_t values[2];
+        uint8_t flags[2];
+        if (!read(values, sizeof(values)) || !read(flags, sizeof(flags))) break;
+        target_->keyCallback(nullptr, values[0], values[1], flags[0], flags[1]);
+      }
+      else
+      {
+        double position[2];
+        if (!read(position, sizeof(position))) break;
+        target_->mouseCallback(nullptr, position[0], position[1]);
+      }
+    }
+  }
+} // namespace vv
\ No newline at end of file
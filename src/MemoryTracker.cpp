@@ -0,0 +1,315 @@
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "vv/MemoryTracker.h"
+
+namespace vv
+{
+  static const char *MEMORY_TAG_NAMES[MEMORY_TAG_COUNT] =
+  {
+    "general", "resources", "scene", "rendering", "input", "streaming", "animation"
+  };
+
+#ifdef VV_TRACK_ALLOCATIONS
+  struct AllocationHeader
+  {
+    size_t size;
+    unsigned int tag;
+    unsigned int magic;
+  };
+
+  /* Keeps the pointer handed out aligned the way malloc would have */
+  static const size_t HEADER_SIZE = 16;
+  static const unsigned int HEADER_MAGIC = 0x7661766d;
+  static const int MAX_TAG_DEPTH = 32;
+
+  struct TagCounters
+  {
+    std::atomic<size_t> bytes;
+    std::atomic<size_t> peak_bytes;
+    std::atomic<size_t> live_allocations;
+    std::atomic<size_t> total_allocations;
+  };
+
+  // zero initialized before any dynamic initialization, so allocations made by other
+  // static constructors are already safe to count
+  static TagCounters tag_counters[MEMORY_TAG_COUNT];
+  static std::atomic<size_t> total_bytes;
+  static std::atomic<size_t> peak_bytes;
+  static std::atomic<size_t> frame_allocations;
+  static std::atomic<size_t> last_frame_allocations;
+  static std::atomic<size_t> guard_violations;
+
+  static thread_local MemoryTag tag_stack[MAX_TAG_DEPTH];
+  static thread_local int tag_depth;
+  static thread_local AllocationGuard allocation_guard;
+  static thread_local bool reporting;
+
+  static void raisePeak(std::atomic<size_t> &peak, size_t value)
+  {
+    size_t previous = peak.load(std::memory_order_relaxed);
+    while (value > previous && !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed))
+    {
+    }
+  }
+#endif
+
+  /////////////////////////////////////////////////////////////////////// public
+  bool MemoryTracker::isEnabled()
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  void MemoryTracker::pushTag(MemoryTag tag)
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    if (tag_depth < MAX_TAG_DEPTH)
+      tag_stack[tag_depth] = tag;
+    tag_depth++;
+#else
+    (void)tag;
+#endif
+  }
+
+
+  void MemoryTracker::popTag()
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    if (tag_depth > 0)
+      tag_depth--;
+#endif
+  }
+
+
+  MemoryTag MemoryTracker::currentTag()
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    if (tag_depth == 0) return MEMORY_GENERAL;
+    return tag_stack[(tag_depth <= MAX_TAG_DEPTH ? tag_depth : MAX_TAG_DEPTH) - 1];
+#else
+    return MEMORY_GENERAL;
+#endif
+  }
+
+
+  MemoryTagStats MemoryTracker::getStats(MemoryTag tag)
+  {
+    MemoryTagStats stats = MemoryTagStats();
+#ifdef VV_TRACK_ALLOCATIONS
+    const TagCounters &counters = tag_counters[tag];
+    stats.bytes = counters.bytes;
+    stats.peak_bytes = counters.peak_bytes;
+    stats.live_allocations = counters.live_allocations;
+    stats.total_allocations = counters.total_allocations;
+#else
+    (void)tag;
+#endif
+    return stats;
+  }
+
+
+  const char* MemoryTracker::getTagName(MemoryTag tag)
+  {
+    return (tag < MEMORY_TAG_COUNT) ? MEMORY_TAG_NAMES[tag] : "unknown";
+  }
+
+
+  size_t MemoryTracker::getTotalBytes()
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    return total_bytes;
+#else
+    return 0;
+#endif
+  }
+
+
+  size_t MemoryTracker::getPeakBytes()
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    return peak_bytes;
+#else
+    return 0;
+#endif
+  }
+
+
+  void MemoryTracker::beginFrame()
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    last_frame_allocations = frame_allocations.exchange(0);
+#endif
+  }
+
+
+  size_t MemoryTracker::getFrameAllocations()
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    return last_frame_allocations;
+#else
+    return 0;
+#endif
+  }
+
+
+  void MemoryTracker::setAllocationGuard(AllocationGuard guard)
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    allocation_guard = guard;
+#else
+    (void)guard;
+#endif
+  }
+
+
+  size_t MemoryTracker::getGuardViolations()
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    return guard_violations;
+#else
+    return 0;
+#endif
+  }
+
+
+  void MemoryTracker::report(std::ostream &out)
+  {
+    if (!isEnabled())
+    {
+      out << "Allocation tracking is disabled, rebuild with VV_TRACK_ALLOCATIONS.\n";
+      return;
+    }
+
+    out << "subsystem      bytes      peak bytes   live       total\n";
+    for (int i = 0; i < MEMORY_TAG_COUNT; ++i)
+    {
+      MemoryTagStats stats = getStats((MemoryTag)i);
+      char line[128];
+      std::snprintf(line, sizeof(line), "%-14s %-10zu %-12zu %-10zu %zu\n", getTagName((MemoryTag)i),
+                    stats.bytes, stats.peak_bytes, stats.live_allocations, stats.total_allocations);
+      out << line;
+    }
+    out << "total bytes: " << getTotalBytes() << ", peak: " << getPeakBytes()
+        << ", last frame allocations: " << getFrameAllocations()
+        << ", guard violations: " << getGuardViolations() << "\n";
+  }
+
+
+  void* MemoryTracker::allocate(size_t size)
+  {
+#ifdef VV_TRACK_ALLOCATIONS
+    void *block = std::malloc(size + HEADER_SIZE);
+    if (!block) return nullptr;
+
+    MemoryTag tag = currentTag();
+    AllocationHeader *header = (AllocationHeader *)block;
+    header->size = size;
+    header->tag = tag;
+    header->magic = HEADER_MAGIC;
+
+    TagCounters &counters = tag_counters[tag];
+    raisePeak(counters.peak_bytes, counters.bytes.fetch_add(size, std::memory_order_relaxed) + size);
+    counters.live_allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.total_allocations.fetch_add(1, std::memory_order_relaxed);
+    raisePeak(peak_bytes, total_bytes.fetch_add(size, std::memory_order_relaxed) + size);
+    frame_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (allocation_guard != GUARD_OFF && !reporting)
+    {
+      // stdio straight to stderr, anything fancier could allocate again
+      reporting = true;
+      guard_violations++;
+      std::fprintf(stderr, "WARNING: heap allocation of %zu bytes (%s) inside the steady-state loop.\n",
+                   size, getTagName(tag));
+      assert(allocation_guard != GUARD_ASSERT && "heap allocation inside an allocation guard");
+      reporting = false;
+    }
+
+    return (char *)block + HEADER_SIZE;
+#else
+    return std::malloc(size);
+#endif
+  }
+
+
+  void MemoryTracker::release(void *pointer)
+  {
+    if (!pointer) return;
+
+#ifdef VV_TRACK_ALLOCATIONS
+    AllocationHeader *header = (AllocationHeader *)((char *)pointer - HEADER_SIZE);
+    assert(header->magic == HEADER_MAGIC && "freeing memory that was not allocated by the tracker");
+
+    TagCounters &counters = tag_counters[header->tag];
+    counters.bytes.fetch_sub(header->size, std::memory_order_relaxed);
+    counters.live_allocations.fetch_sub(1, std::memory_order_relaxed);
+    total_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+    std::free(header);
+#else
+    std::free(pointer);
+#endif
+  }
+} // namespace vv
+
+#ifdef VV_TRACK_ALLOCATIONS
+void* operator new(size_t size)
+{
+  void *pointer = vv::MemoryTracker::allocate(size ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+
+void* operator new[](size_t size)
+{
+  void *pointer = vv::MemoryTracker::allocate(size ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  return vv::MemoryTracker::allocate(size ? size : 1);
+}
+
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  return vv::MemoryTracker::allocate(size ? size : 1);
+}
+
+
+void operator delete(void *pointer) noexcept
+{
+  vv::MemoryTracker::release(pointer);
+}
+
+
+void operator delete[](void *pointer) noexcept
+{
+  vv::MemoryTracker::release(pointer);
+}
+
+
+void operator delete(void *pointer, const std::nothrow_t&) noexcept
+{
+  vv::MemoryTracker::release(pointer);
+}
+
+
+void operator delete[](void *pointer, const std::nothrow_t&) noexcept
+{
+  vv::MemoryTracker::release(pointer);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,520 @@
+
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <glm/geometric.hpp>
+
+#include "vv/GLStateCache.h"
+#include "vv/Mesh.h"
+#include "vv/ObjLoader.h"
+#include "vv/Settings.h"
+#include "vv/Time.h"
+#include "vv/VirtualVista.h"
+
+namespace vv
+{
+  static const unsigned int IMPORT_FLAGS = aiProcess_Triangulate |
+                                           aiProcess_GenSmoothNormals |
+                                           aiProcess_CalcTangentSpace |
+                                           aiProcess_JoinIdenticalVertices |
+                                           aiProcess_LimitBoneWeights |
+                                           aiProcess_FlipUVs;
+
+  /* Used when a file leaves its tick rate out */
+  static const double DEFAULT_TICKS_PER_SECOND = 25.0;
+
+  static glm::vec3 toVec3(const aiVector3D &v)
+  {
+    return glm::vec3(v.x, v.y, v.z);
+  }
+
+
+  static glm::quat toQuat(const aiQuaternion &q)
+  {
+    return glm::quat(q.w, q.x, q.y, q.z);
+  }
+
+
+  static glm::mat4 toMat4(const aiMatrix4x4 &m)
+  {
+    // assimp is row major
+    glm::mat4 result;
+    result[0] = glm::vec4(m.a1, m.b1, m.c1, m.d1);
+    result[1] = glm::vec4(m.a2, m.b2, m.c2, m.d2);
+    result[2] = glm::vec4(m.a3, m.b3, m.c3, m.d3);
+    result[3] = glm::vec4(m.a4, m.b4, m.c4, m.d4);
+    return result;
+  }
+
+
+  static bool hasExtension(const std::string &file, const char *extension)
+  {
+    size_t length = std::strlen(extension);
+    if (file.size() < length) return false;
+
+    for (size_t i = 0; i < length; ++i)
+      if (std::tolower((unsigned char)file[file.size() - length + i]) != extension[i])
+        return false;
+
+    return true;
+  }
+
+  /////////////////////////////////////////////////////////////////////// public
+  Mesh::Mesh(std::string path, std::string name) :
+    Resource(path, name),
+    vao_(0),
+    vertex_buffer_(0),
+    skin_buffer_(0),
+    index_buffer_(0),
+    uv_density_(0.0f),
+    skeleton_(nullptr)
+  {
+  }
+
+
+  Mesh::~Mesh()
+  {
+    release();
+
+    SAFE_DELETE(skeleton_);
+    for (auto animation : animations_)
+      SAFE_DELETE(animation);
+  }
+
+
+  bool Mesh::init()
+  {
+    double start_time = Time::current();
+    const char *importer = "assimp";
+    bool loaded = false;
+
+    if (Settings::instance()->getFastObjImport() && hasExtension(file_name_, ".obj"))
+    {
+      ObjLoader loader;
+      loaded = loader.load(file_path_, file_name_, *this);
+      if (loaded)
+        importer = "obj loader";
+      else
+      {
+        std::cerr << "WARNING: obj loader could not handle " << file_path_ + file_name_ << ", using assimp\n";
+        materials_.clear();
+      }
+    }
+
+    if (!loaded)
+      loaded = importAssimp();
+
+    if (loaded)
+    {
+      computeUvDensity();
+      std::cout << "Imported " << file_name_ << " with the " << importer << " in "
+                << Time::current() - start_time << " ms\n";
+    }
+
+    return loaded;
+  }
+
+
+  bool Mesh::upload()
+  {
+    if (vao_) return true;
+    if (vertices_.empty()) return false;
+
+    GLStateCache *cache = GLStateCache::instance();
+
+    glGenVertexArrays(1, &vao_);
+    cache->bindVertexArray(vao_);
+
+    glGenBuffers(1, &vertex_buffer_);
+    cache->bindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(MeshVertex), vertices_.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)offsetof(MeshVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)offsetof(MeshVertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)offsetof(MeshVertex, tex_coord));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)offsetof(MeshVertex, tangent));
+
+    // locations 4 to 7 are taken by the instance matrix
+    if (!skin_.empty())
+    {
+      glGenBuffers(1, &skin_buffer_);
+      cache->bindBuffer(GL_ARRAY_BUFFER, skin_buffer_);
+      glBufferData(GL_ARRAY_BUFFER, skin_.size() * sizeof(SkinVertex), skin_.data(), GL_STATIC_DRAW);
+
+      glEnableVertexAttribArray(8);
+      glVertexAttribIPointer(8, 4, GL_UNSIGNED_BYTE, sizeof(SkinVertex), (GLvoid *)offsetof(SkinVertex, bone_ids));
+      glEnableVertexAttribArray(9);
+      glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, sizeof(SkinVertex), (GLvoid *)offsetof(SkinVertex, bone_weights));
+    }
+
+    glGenBuffers(1, &index_buffer_);
+    cache->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(GLuint), indices_.data(), GL_STATIC_DRAW);
+
+    cache->bindVertexArray(0);
+    return true;
+  }
+
+
+  void Mesh::draw()
+  {
+    GLStateCache::instance()->bindVertexArray(vao_);
+    GLStateCache::instance()->drawElements(GL_TRIANGLES, (GLsizei)indices_.size(), GL_UNSIGNED_INT, 0);
+  }
+
+
+  void Mesh::draw(size_t submesh)
+  {
+    const Submesh &part = submeshes_[submesh];
+    GLStateCache::instance()->bindVertexArray(vao_);
+    GLStateCache::instance()->drawElements(GL_TRIANGLES, part.index_count, GL_UNSIGNED_INT,
+                                           (GLvoid *)(part.first_index * sizeof(GLuint)));
+  }
+
+
+  Handle Mesh::getHandle() const
+  {
+    return handle_;
+  }
+
+
+  GLuint Mesh::getVertexArray() const
+  {
+    return vao_;
+  }
+
+
+  const std::vector<Submesh>& Mesh::getSubmeshes() const
+  {
+    return submeshes_;
+  }
+
+
+  const AABB& Mesh::getBounds() const
+  {
+    return bounds_;
+  }
+
+
+  const std::vector<MeshMaterial>& Mesh::getMaterials() const
+  {
+    return materials_;
+  }
+
+
+  size_t Mesh::getVertexCount() const
+  {
+    return vertices_.size();
+  }
+
+
+  size_t Mesh::getIndexCount() const
+  {
+    return indices_.size();
+  }
+
+
+  float Mesh::getUvDensity() const
+  {
+    return uv_density_;
+  }
+
+
+  bool Mesh::isSkinned() const
+  {
+    return skeleton_ != nullptr;
+  }
+
+
+  const Skeleton* Mesh::getSkeleton() const
+  {
+    return skeleton_;
+  }
+
+
+  size_t Mesh::getAnimationCount() const
+  {
+    return animations_.size();
+  }
+
+
+  const AnimationClip* Mesh::getAnimation(size_t i) const
+  {
+    return (i < animations_.size()) ? animations_[i] : nullptr;
+  }
+
+
+  const AnimationClip* Mesh::getAnimation(const std::string &name) const
+  {
+    for (auto animation : animations_)
+      if (animation->getName() == name)
+        return animation;
+
+    return nullptr;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  bool Mesh::importAssimp()
+  {
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(file_path_ + file_name_, IMPORT_FLAGS);
+    if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode)
+    {
+      std::cerr << "ERROR: failed to load mesh: " << file_path_ + file_name_ << "\n"
+                << importer.GetErrorString() << "\n";
+      return false;
+    }
+
+    // the whole hierarchy becomes the skeleton, bones only pick the joints that get a palette slot
+    bool skinned = false;
+    for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+      skinned |= (scene->mMeshes[i]->mNumBones > 0);
+
+    if (skinned)
+    {
+      skeleton_ = new Skeleton;
+      loadSkeleton(scene->mRootNode, -1);
+      skeleton_->global_inverse = glm::inverse(toMat4(scene->mRootNode->mTransformation));
+    }
+
+    std::unordered_map<std::string, int> slots;
+    for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+    {
+      size_t base_vertex = vertices_.size();
+      loadGeometry(scene->mMeshes[i]);
+
+      if (skinned && !loadBones(scene->mMeshes[i], base_vertex, slots))
+        return false;
+    }
+
+    if (skinned)
+      loadAnimations(scene);
+
+    return !vertices_.empty();
+  }
+
+
+  void Mesh::loadGeometry(const aiMesh *mesh)
+  {
+    GLuint base_vertex = (GLuint)vertices_.size();
+
+    for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+    {
+      MeshVertex vertex = MeshVertex();
+      vertex.position = toVec3(mesh->mVertices[i]);
+      if (mesh->HasNormals())
+        vertex.normal = toVec3(mesh->mNormals[i]);
+      if (mesh->HasTextureCoords(0))
+        vertex.tex_coord = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+      if (mesh->HasTangentsAndBitangents())
+        vertex.tangent = toVec3(mesh->mTangents[i]);
+
+      bounds_.expand(vertex.position);
+      vertices_.push_back(vertex);
+    }
+
+    Submesh submesh = Submesh();
+    submesh.first_index = (GLuint)indices_.size();
+    submesh.material = mesh->mMaterialIndex;
+
+    for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+    {
+      const aiFace &face = mesh->mFaces[i];
+      if (face.mNumIndices != 3) continue; // points and lines left over from triangulation
+
+      for (unsigned int j = 0; j < 3; ++j)
+        indices_.push_back(base_vertex + face.mIndices[j]);
+    }
+
+    submesh.index_count = (GLuint)indices_.size() - submesh.first_index;
+    submeshes_.push_back(submesh);
+  }
+
+
+  void Mesh::loadSkeleton(const aiNode *node, int parent)
+  {
+    int joint = (int)skeleton_->parents.size();
+    skeleton_->joint_names.push_back(node->mName.C_Str());
+    skeleton_->parents.push_back(parent);
+
+    aiVector3D scale, translation;
+    aiQuaternion rotation;
+    node->mTransformation.Decompose(scale, rotation, translation);
+    skeleton_->bind_pose.translations.push_back(toVec3(translation));
+    skeleton_->bind_pose.rotations.push_back(toQuat(rotation));
+    skeleton_->bind_pose.scales.push_back(toVec3(scale));
+
+    for (unsigned int i = 0; i < node->mNumChildren; ++i)
+      loadSkeleton(node->mChildren[i], joint);
+  }
+
+
+  bool Mesh::loadBones(const aiMesh *mesh, size_t base_vertex, std::unordered_map<std::string, int> &slots)
+  {
+    skin_.resize(vertices_.size(), SkinVertex());
+
+    for (unsigned int b = 0; b < mesh->mNumBones; ++b)
+    {
+      const aiBone *bone = mesh->mBones[b];
+
+      // submeshes share bones by name, each bone gets a single palette slot per file
+      auto found = slots.find(bone->mName.C_Str());
+      int slot;
+      if (found != slots.end())
+        slot = found->second;
+      else
+      {
+        if (skeleton_->bone_joints.size() >= MAX_BONES)
+        {
+          std::cerr << "ERROR: " << file_path_ + file_name_ << " uses more than " << MAX_BONES << " bones.\n";
+          return false;
+        }
+
+        int joint = skeleton_->findJoint(bone->mName.C_Str());
+        if (joint < 0)
+        {
+          std::cerr << "ERROR: bone " << bone->mName.C_Str() << " has no node in " << file_path_ + file_name_ << "\n";
+          return false;
+        }
+
+        slot = (int)skeleton_->bone_joints.size();
+        slots[bone->mName.C_Str()] = slot;
+        skeleton_->bone_joints.push_back(joint);
+        skeleton_->inverse_bind.push_back(toMat4(bone->mOffsetMatrix));
+      }
+
+      for (unsigned int w = 0; w < bone->mNumWeights; ++w)
+      {
+        SkinVertex &vertex = skin_[base_vertex + bone->mWeights[w].mVertexId];
+        float weight = bone->mWeights[w].mWeight;
+
+        // the import already limits influences to four, this only guards odd files
+        int lightest = 0;
+        for (int i = 1; i < 4; ++i)
+          if (vertex.bone_weights[i] < vertex.bone_weights[lightest])
+            lightest = i;
+
+        if (weight > vertex.bone_weights[lightest])
+        {
+          vertex.bone_ids[lightest] = (uint8_t)slot;
+          vertex.bone_weights[lightest] = weight;
+        }
+      }
+    }
+
+    // unweighted vertices, like static submeshes in a skinned file, keep all zero weights
+    // and the vertex shader leaves them in model space
+    for (size_t i = base_vertex; i < skin_.size(); ++i)
+    {
+      glm::vec4 &weights = skin_[i].bone_weights;
+      float total = weights.x + weights.y + weights.z + weights.w;
+      if (total > 0.0f)
+        weights = weights / total;
+    }
+
+    return true;
+  }
+
+
+  void Mesh::loadAnimations(const aiScene *scene)
+  {
+    for (unsigned int a = 0; a < scene->mNumAnimations; ++a)
+    {
+      const aiAnimation *source = scene->mAnimations[a];
+      double ticks_per_second = (source->mTicksPerSecond > 0.0) ? source->mTicksPerSecond : DEFAULT_TICKS_PER_SECOND;
+
+      AnimationClip *clip = new AnimationClip(source->mName.C_Str(), (float)(source->mDuration / ticks_per_second),
+                                              skeleton_->getJointCount());
+
+      for (unsigned int c = 0; c < source->mNumChannels; ++c)
+      {
+        const aiNodeAnim *channel = source->mChannels[c];
+        int joint = skeleton_->findJoint(channel->mNodeName.C_Str());
+        if (joint < 0) continue;
+
+        AnimationTrack &track = clip->tracks_[joint];
+
+        track.first_translation = (uint32_t)clip->translation_times_.size();
+        track.translation_count = channel->mNumPositionKeys;
+        for (unsigned int k = 0; k < channel->mNumPositionKeys; ++k)
+        {
+          clip->translation_times_.push_back((float)(channel->mPositionKeys[k].mTime / ticks_per_second));
+          clip->translation_values_.push_back(toVec3(channel->mPositionKeys[k].mValue));
+        }
+
+        track.first_rotation = (uint32_t)clip->rotation_times_.size();
+        track.rotation_count = channel->mNumRotationKeys;
+        for (unsigned int k = 0; k < channel->mNumRotationKeys; ++k)
+        {
+          clip->rotation_times_.push_back((float)(channel->mRotationKeys[k].mTime / ticks_per_second));
+          clip->rotation_values_.push_back(toQuat(channel->mRotationKeys[k].mValue));
+        }
+
+        track.first_scale = (uint32_t)clip->scale_times_.size();
+        track.scale_count = channel->mNumScalingKeys;
+        for (unsigned int k = 0; k < channel->mNumScalingKeys; ++k)
+        {
+          clip->scale_times_.push_back((float)(channel->mScalingKeys[k].mTime / ticks_per_second));
+          clip->scale_values_.push_back(toVec3(channel->mScalingKeys[k].mValue));
+        }
+      }
+
+      animations_.push_back(clip);
+    }
+  }
+
+
+  void Mesh::computeUvDensity()
+  {
+    // ratio of total uv area to total surface area, so a few stretched triangles can't dominate
+    double surface_area = 0.0, uv_area = 0.0;
+    for (size_t i = 0; i + 2 < indices_.size(); i += 3)
+    {
+      const MeshVertex &a = vertices_[indices_[i]];
+      const MeshVertex &b = vertices_[indices_[i + 1]];
+      const MeshVertex &c = vertices_[indices_[i + 2]];
+
+      surface_area += glm::length(glm::cross(b.position - a.position, c.position - a.position));
+
+      glm::vec2 uv_b = b.tex_coord - a.tex_coord;
+      glm::vec2 uv_c = c.tex_coord - a.tex_coord;
+      uv_area += std::fabs(uv_b.x * uv_c.y - uv_b.y * uv_c.x);
+    }
+
+    uv_density_ = (surface_area > 0.0) ? (float)std::sqrt(uv_area / surface_area) : 0.0f;
+  }
+
+
+  void Mesh::release()
+  {
+    GLStateCache *cache = GLStateCache::instance();
+
+    if (vao_)
+    {
+      cache->onDeleteVertexArray(vao_);
+      glDeleteVertexArrays(1, &vao_);
+      vao_ = 0;
+    }
+
+    GLuint buffers[] = { vertex_buffer_, skin_buffer_, index_buffer_ };
+    for (auto buffer : buffers)
+    {
+      if (!buffer) continue;
+      cache->onDeleteBuffer(buffer);
+      glDeleteBuffers(1, &buffer);
+    }
+
+    vertex_buffer_ = skin_buffer_ = index_buffer_ = 0;
+  }
+} // namespace vv
\ No newline at end of file
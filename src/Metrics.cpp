@@ -0,0 +1,545 @@
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "vv/Metrics.h"
+
+namespace vv
+{
+  MetricsRegistry* MetricsRegistry::instance_ = nullptr;
+
+  /* Long enough for a request line, the rest of an http request is never looked at */
+  static const size_t MAX_REQUEST_SIZE = 512;
+  static const int ACCEPT_TIMEOUT = 100; /* in milliseconds, how quickly stop() is noticed */
+  static const int RECEIVE_TIMEOUT = 50; /* in milliseconds, clients that send nothing get prometheus */
+
+  static uint64_t toBits(double value)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+
+  static double fromBits(uint64_t bits)
+  {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+
+  static std::string formatNumber(double value, bool json)
+  {
+    if (std::isnan(value)) return json ? "null" : "NaN";
+    if (std::isinf(value)) return json ? "null" : (value > 0.0 ? "+Inf" : "-Inf");
+
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+  }
+
+
+  static std::string escape(const std::string &text, bool quotes)
+  {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text)
+    {
+      if (c == '\\') escaped += "\\\\";
+      else if (c == '\n') escaped += "\\n";
+      else if (c == '"' && quotes) escaped += "\\\"";
+      else escaped += c;
+    }
+    return escaped;
+  }
+
+
+  /* {a="1",b="2"}, with an extra label appended for histogram buckets */
+  static std::string formatLabels(const MetricLabels &labels, const char *extra_name = nullptr,
+                                  const std::string &extra_value = std::string())
+  {
+    if (labels.empty() && !extra_name) return std::string();
+
+    std::string text = "{";
+    for (size_t i = 0; i < labels.size(); ++i)
+    {
+      if (i) text += ",";
+      text += labels[i].first + "=\"" + escape(labels[i].second, true) + "\"";
+    }
+
+    if (extra_name)
+    {
+      if (!labels.empty()) text += ",";
+      text += std::string(extra_name) + "=\"" + extra_value + "\"";
+    }
+
+    return text + "}";
+  }
+
+  /////////////////////////////////////////////////////////////////////// public
+  const std::string& Metric::getName() const
+  {
+    return name_;
+  }
+
+
+  MetricType Metric::getType() const
+  {
+    return type_;
+  }
+
+
+  void Gauge::set(double value)
+  {
+    bits_.store(toBits(value), std::memory_order_relaxed);
+  }
+
+
+  double Gauge::get() const
+  {
+    return fromBits(bits_.load(std::memory_order_relaxed));
+  }
+
+
+  void Histogram::observe(double value)
+  {
+    // a handful of bounds, a linear scan beats anything smarter
+    size_t bucket = 0;
+    while (bucket < bounds_.size() && value > bounds_[bucket])
+      bucket++;
+
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t previous = sum_bits_.load(std::memory_order_relaxed);
+    while (!sum_bits_.compare_exchange_weak(previous, toBits(fromBits(previous) + value), std::memory_order_relaxed))
+    {
+    }
+  }
+
+
+  const std::vector<double>& Histogram::getBounds() const
+  {
+    return bounds_;
+  }
+
+
+  uint64_t Histogram::getBucket(size_t i) const
+  {
+    return buckets_[i].load(std::memory_order_relaxed);
+  }
+
+
+  uint64_t Histogram::getCount() const
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+
+  double Histogram::getSum() const
+  {
+    return fromBits(sum_bits_.load(std::memory_order_relaxed));
+  }
+
+
+  MetricsRegistry* MetricsRegistry::instance()
+  {
+    if (!instance_)
+      instance_ = new MetricsRegistry;
+
+    return instance_;
+  }
+
+
+  Counter* MetricsRegistry::counter(const std::string &name, const std::string &help, const MetricLabels &labels)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Metric *existing = find(name, labels, METRIC_COUNTER))
+      return (Counter *)existing;
+
+    Counter *metric = new Counter(name, help, labels);
+    metrics_.push_back(metric);
+    return metric;
+  }
+
+
+  Gauge* MetricsRegistry::gauge(const std::string &name, const std::string &help, const MetricLabels &labels)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Metric *existing = find(name, labels, METRIC_GAUGE))
+      return (Gauge *)existing;
+
+    Gauge *metric = new Gauge(name, help, labels);
+    metrics_.push_back(metric);
+    return metric;
+  }
+
+
+  Histogram* MetricsRegistry::histogram(const std::string &name, const std::string &help,
+                                        const std::vector<double> &bounds, const MetricLabels &labels)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Metric *existing = find(name, labels, METRIC_HISTOGRAM))
+      return (Histogram *)existing;
+
+    Histogram *metric = new Histogram(name, help, labels, bounds);
+    metrics_.push_back(metric);
+    return metric;
+  }
+
+
+  void MetricsRegistry::write(std::ostream &out, MetricsFormat format) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (format == METRICS_JSON)
+      writeJson(out);
+    else
+      writePrometheus(out);
+  }
+
+
+  size_t MetricsRegistry::getMetricCount() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return metrics_.size();
+  }
+
+
+  MetricsServer::MetricsServer() :
+    socket_(-1),
+    running_(false),
+    requests_(0)
+  {
+  }
+
+
+  MetricsServer::~MetricsServer()
+  {
+    stop();
+  }
+
+
+  bool MetricsServer::start(const std::string &socket_path)
+  {
+    if (running_) return true;
+
+#ifdef _WIN32
+    std::cerr << "ERROR: metrics export over unix sockets is not supported on this platform.\n";
+    (void)socket_path;
+    return false;
+#else
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path))
+    {
+      std::cerr << "ERROR: invalid metrics socket path: " << socket_path << "\n";
+      return false;
+    }
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_ < 0)
+    {
+      std::cerr << "ERROR: failed to create the metrics socket.\n";
+      return false;
+    }
+
+    // a socket file left behind by a crashed run would make bind fail
+    unlink(socket_path.c_str());
+    if (bind(socket_, (sockaddr *)&address, sizeof(address)) != 0 || listen(socket_, 4) != 0)
+    {
+      std::cerr << "ERROR: failed to listen for metrics on " << socket_path << "\n";
+      close(socket_);
+      socket_ = -1;
+      return false;
+    }
+
+    socket_path_ = socket_path;
+    running_ = true;
+    thread_ = std::thread(&MetricsServer::serveLoop, this);
+
+    std::cout << "Serving metrics on " << socket_path << "\n";
+    return true;
+#endif
+  }
+
+
+  void MetricsServer::stop()
+  {
+    if (!running_) return;
+
+    running_ = false;
+    if (thread_.joinable())
+      thread_.join();
+
+#ifndef _WIN32
+    close(socket_);
+    unlink(socket_path_.c_str());
+#endif
+    socket_ = -1;
+  }
+
+
+  bool MetricsServer::isRunning() const
+  {
+    return running_;
+  }
+
+
+  uint64_t MetricsServer::getRequestCount() const
+  {
+    return requests_.load(std::memory_order_relaxed);
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  Metric::Metric(const std::string &name, const std::string &help, const MetricLabels &labels, MetricType type) :
+    name_(name),
+    help_(help),
+    labels_(labels),
+    type_(type)
+  {
+  }
+
+
+  Counter::Counter(const std::string &name, const std::string &help, const MetricLabels &labels) :
+    Metric(name, help, labels, METRIC_COUNTER),
+    value_(0)
+  {
+  }
+
+
+  Gauge::Gauge(const std::string &name, const std::string &help, const MetricLabels &labels) :
+    Metric(name, help, labels, METRIC_GAUGE),
+    bits_(toBits(0.0))
+  {
+  }
+
+
+  Histogram::Histogram(const std::string &name, const std::string &help, const MetricLabels &labels,
+                       const std::vector<double> &bounds) :
+    Metric(name, help, labels, METRIC_HISTOGRAM),
+    bounds_(bounds),
+    buckets_(new std::atomic<uint64_t>[bounds.size() + 1]),
+    count_(0),
+    sum_bits_(toBits(0.0))
+  {
+    for (size_t i = 0; i <= bounds_.size(); ++i)
+      buckets_[i] = 0;
+  }
+
+
+  MetricsRegistry::MetricsRegistry()
+  {
+  }
+
+
+  MetricsRegistry::~MetricsRegistry()
+  {
+    for (auto metric : metrics_)
+      delete metric;
+  }
+
+
+  Metric* MetricsRegistry::find(const std::string &name, const MetricLabels &labels, MetricType type) const
+  {
+    for (auto metric : metrics_)
+      if (metric->name_ == name && metric->labels_ == labels && metric->type_ == type)
+        return metric;
+
+    return nullptr;
+  }
+
+
+  void MetricsRegistry::writePrometheus(std::ostream &out) const
+  {
+    static const char *TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+
+    for (size_t i = 0; i < metrics_.size(); ++i)
+    {
+      const Metric *metric = metrics_[i];
+
+      // one header per family, however many label sets it has
+      bool first_of_family = true;
+      for (size_t j = 0; j < i && first_of_family; ++j)
+        first_of_family = (metrics_[j]->name_ != metric->name_);
+
+      if (first_of_family)
+      {
+        out << "# HELP " << metric->name_ << " " << escape(metric->help_, false) << "\n";
+        out << "# TYPE " << metric->name_ << " " << TYPE_NAMES[metric->type_] << "\n";
+      }
+
+      switch (metric->type_)
+      {
+        case METRIC_COUNTER:
+          out << metric->name_ << formatLabels(metric->labels_) << " " << ((const Counter *)metric)->get() << "\n";
+          break;
+
+        case METRIC_GAUGE:
+          out << metric->name_ << formatLabels(metric->labels_) << " "
+              << formatNumber(((const Gauge *)metric)->get(), false) << "\n";
+          break;
+
+        case METRIC_HISTOGRAM:
+        {
+          const Histogram *histogram = (const Histogram *)metric;
+          const std::vector<double> &bounds = histogram->getBounds();
+
+          // prometheus buckets are cumulative
+          uint64_t cumulative = 0;
+          for (size_t b = 0; b <= bounds.size(); ++b)
+          {
+            cumulative += histogram->getBucket(b);
+            std::string bound = (b < bounds.size()) ? formatNumber(bounds[b], false) : "+Inf";
+            out << metric->name_ << "_bucket" << formatLabels(metric->labels_, "le", bound) << " " << cumulative << "\n";
+          }
+
+          out << metric->name_ << "_sum" << formatLabels(metric->labels_) << " "
+              << formatNumber(histogram->getSum(), false) << "\n";
+          out << metric->name_ << "_count" << formatLabels(metric->labels_) << " " << cumulative << "\n";
+          break;
+        }
+      }
+    }
+  }
+
+
+  void MetricsRegistry::writeJson(std::ostream &out) const
+  {
+    static const char *TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+
+    out << "{\"metrics\":[";
+    for (size_t i = 0; i < metrics_.size(); ++i)
+    {
+      const Metric *metric = metrics_[i];
+      if (i) out << ",";
+
+      out << "\n{\"name\":\"" << escape(metric->name_, true) << "\",\"type\":\"" << TYPE_NAMES[metric->type_]
+          << "\",\"help\":\"" << escape(metric->help_, true) << "\"";
+
+      if (!metric->labels_.empty())
+      {
+        out << ",\"labels\":{";
+        for (size_t l = 0; l < metric->labels_.size(); ++l)
+          out << (l ? "," : "") << "\"" << escape(metric->labels_[l].first, true) << "\":\""
+              << escape(metric->labels_[l].second, true) << "\"";
+        out << "}";
+      }
+
+      switch (metric->type_)
+      {
+        case METRIC_COUNTER:
+          out << ",\"value\":" << ((const Counter *)metric)->get();
+          break;
+
+        case METRIC_GAUGE:
+          out << ",\"value\":" << formatNumber(((const Gauge *)metric)->get(), true);
+          break;
+
+        case METRIC_HISTOGRAM:
+        {
+          const Histogram *histogram = (const Histogram *)metric;
+          const std::vector<double> &bounds = histogram->getBounds();
+
+          // per bucket counts here, the last bound is null for everything above the others
+          uint64_t count = 0;
+          out << ",\"buckets\":[";
+          for (size_t b = 0; b <= bounds.size(); ++b)
+          {
+            uint64_t bucket = histogram->getBucket(b);
+            count += bucket;
+            out << (b ? "," : "") << "{\"le\":"
+                << (b < bounds.size() ? formatNumber(bounds[b], true) : "null") << ",\"count\":" << bucket << "}";
+          }
+          out << "],\"sum\":" << formatNumber(histogram->getSum(), true) << ",\"count\":" << count;
+          break;
+        }
+      }
+
+      out << "}";
+    }
+    out << "\n]}\n";
+  }
+
+
+  void MetricsServer::serveLoop()
+  {
+#ifndef _WIN32
+    while (running_)
+    {
+      pollfd listener = { socket_, POLLIN, 0 };
+      if (poll(&listener, 1, ACCEPT_TIMEOUT) <= 0 || !(listener.revents & POLLIN))
+        continue;
+
+      int client = accept(socket_, nullptr, nullptr);
+      if (client < 0) continue;
+
+      serveClient(client);
+      close(client);
+    }
+#endif
+  }
+
+
+  void MetricsServer::serveClient(int client)
+  {
+#ifndef _WIN32
+    timeval timeout = { 0, RECEIVE_TIMEOUT * 1000 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char request[MAX_REQUEST_SIZE];
+    ssize_t received = recv(client, request, sizeof(request) - 1, 0);
+    std::string line = (received > 0) ? std::string(request, received) : std::string();
+    line = line.substr(0, line.find('\n'));
+
+    bool http = (line.compare(0, 4, "GET ") == 0);
+    MetricsFormat format = (line.find("json") != std::string::npos) ? METRICS_JSON : METRICS_PROMETHEUS;
+
+    std::ostringstream body;
+    MetricsRegistry::instance()->write(body, format);
+    std::string response = body.str();
+
+    if (http)
+    {
+      std::ostringstream header;
+      header << "HTTP/1.0 200 OK\r\nContent-Type: "
+             << (format == METRICS_JSON ? "application/json" : "text/plain; version=0.0.4")
+             << "\r\nContent-Length: " << response.size() << "\r\nConnection: close\r\n\r\n";
+      response = header.str() + response;
+    }
+
+    // a client that hangs up early must not take the engine down with SIGPIPE
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    size_t sent = 0;
+    while (sent < response.size())
+    {
+      ssize_t written = send(client, response.data() + sent, response.size() - sent, flags);
+      if (written <= 0) break;
+      sent += (size_t)written;
+    }
+
+    requests_.fetch_add(1, std::memory_order_relaxed);
+#else
+    (void)client;
+#endif
+  }
+} // namespace vv
\ No newline at end of file
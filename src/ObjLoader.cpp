@@ -0,0 +1,758 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "vv/MemoryTracker.h"
+#include "vv/ObjLoader.h"
+#include "vv/ThreadPool.h"
+#include "vv/Time.h"
+
+namespace vv
+{
+  /* Below this every worker would spend more time starting than parsing */
+  static const size_t MIN_CHUNK_BYTES = 64 * 1024;
+
+  /* Corners kept per polygon, anything past this is dropped from the fan */
+  static const int MAX_POLYGON_CORNERS = 64;
+
+  static const uint8_t RELATIVE_POSITION  = 1;
+  static const uint8_t RELATIVE_TEX_COORD = 2;
+  static const uint8_t RELATIVE_NORMAL    = 4;
+
+  static const double POWERS_OF_TEN[] =
+  {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  /* Read only view of a whole file, mapped where the platform allows it */
+  class MappedFile
+  {
+  public:
+    MappedFile() :
+      data_(nullptr),
+      size_(0)
+#ifdef _WIN32
+      , file_(INVALID_HANDLE_VALUE),
+      mapping_(nullptr)
+#endif
+    {
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+      if (data_) UnmapViewOfFile(data_);
+      if (mapping_) CloseHandle(mapping_);
+      if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+      if (data_) munmap((void *)data_, size_);
+#endif
+    }
+
+    bool open(const std::string &file)
+    {
+#ifdef _WIN32
+      file_ = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                          FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file_ == INVALID_HANDLE_VALUE) return false;
+
+      LARGE_INTEGER size;
+      if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) return false;
+      size_ = (size_t)size.QuadPart;
+
+      mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (!mapping_) return false;
+
+      data_ = (const char *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+      return data_ != nullptr;
+#else
+      int descriptor = ::open(file.c_str(), O_RDONLY);
+      if (descriptor < 0) return false;
+
+      struct stat status;
+      if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+      {
+        close(descriptor);
+        return false;
+      }
+      size_ = (size_t)status.st_size;
+
+      void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      close(descriptor); // the mapping keeps its own reference
+      if (data == MAP_FAILED) return false;
+
+      madvise(data, size_, MADV_SEQUENTIAL);
+      data_ = (const char *)data;
+      return true;
+#endif
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+  private:
+    const char *data_;
+    size_t size_;
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+  };
+
+
+  static inline bool isSpace(char c)
+  {
+    return c == ' ' || c == '\t';
+  }
+
+
+  static inline bool isDigit(char c)
+  {
+    return (unsigned)(c - '0') < 10u;
+  }
+
+
+  static inline const char* skipSpaces(const char *p, const char *end)
+  {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+  }
+
+
+  static inline bool startsWith(const char *p, const char *end, const char *keyword, size_t length)
+  {
+    return ((size_t)(end - p) > length) && (std::memcmp(p, keyword, length) == 0) && isSpace(p[length]);
+  }
+
+
+  static const char* parseInt(const char *begin, const char *end, int &value)
+  {
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+      negative = (*p++ == '-');
+
+    if (p >= end || !isDigit(*p)) return begin;
+
+    int result = 0;
+    while (p < end && isDigit(*p))
+      result = result * 10 + (*p++ - '0');
+
+    value = negative ? -result : result;
+    return p;
+  }
+
+
+  /* Rest of the line without surrounding white space */
+  static std::string readName(const char *p, const char *end)
+  {
+    p = skipSpaces(p, end);
+    while (end > p && (isSpace(end[-1]) || end[-1] == '\r')) --end;
+    return std::string(p, end);
+  }
+
+
+  /* Obj indices are one based, negative ones count back from the newest element */
+  static bool resolveIndex(int value, size_t local_count, int32_t &index, uint8_t &relative, uint8_t flag)
+  {
+    if (value > 0)
+      index = value - 1;
+    else if (value < 0)
+    {
+      index = (int32_t)local_count + value;
+      relative |= flag;
+    }
+    else
+      return false;
+
+    return true;
+  }
+
+
+  /* Reads up to count components into values, returns how many were numbers */
+  static int parseComponents(const char *p, const char *end, float *values, int count)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      p = skipSpaces(p, end);
+      const char *next = ObjLoader::parseFloat(p, end, values[i]);
+      if (next == p) return i;
+      p = next;
+    }
+
+    return count;
+  }
+
+
+  static bool hasMap(const std::string &keyword)
+  {
+    return keyword == "map_Kd" || keyword == "map_Bump" || keyword == "map_bump" ||
+           keyword == "bump" || keyword == "norm" || keyword == "map_Ks";
+  }
+
+  /////////////////////////////////////////////////////////////////////// public
+  ObjLoader::ObjLoader()
+  {
+    stats_ = ObjStats();
+  }
+
+
+  bool ObjLoader::load(const std::string &path, const std::string &name, Mesh &mesh)
+  {
+    VV_MEMORY_SCOPE(MEMORY_RESOURCES);
+    double start_time = Time::current();
+
+    MappedFile file;
+    if (!file.open(path + name))
+    {
+      std::cerr << "ERROR: failed to map obj file: " << path + name << "\n";
+      return false;
+    }
+
+    // cut at line ends so no line is split between two workers
+    size_t chunk_count = std::min(ThreadPool::instance()->getWorkerCount() + 1,
+                                  std::max<size_t>(1, file.size() / MIN_CHUNK_BYTES));
+    chunks_.clear();
+    chunks_.resize(chunk_count);
+
+    const char *data = file.data(), *end = data + file.size();
+    const char *begin = data;
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+      const char *split = (i + 1 == chunk_count) ? end : data + file.size() * (i + 1) / chunk_count;
+      if (split < begin) split = begin;
+      if (split < end)
+      {
+        const char *newline = (const char *)std::memchr(split, '\n', end - split);
+        split = newline ? newline + 1 : end;
+      }
+
+      chunks_[i].begin = begin;
+      chunks_[i].end = split;
+      chunks_[i].failed = false;
+      begin = split;
+    }
+
+    stats_.chunks = chunk_count;
+    stats_.map_time = Time::current() - start_time;
+
+    double parse_start = Time::current();
+    ThreadPool::instance()->parallelFor(chunk_count, 1, [&](size_t first, size_t last)
+    {
+      VV_MEMORY_SCOPE(MEMORY_RESOURCES);
+      for (size_t i = first; i < last; ++i)
+        parseChunk(chunks_[i]);
+    });
+    stats_.parse_time = Time::current() - parse_start;
+
+    for (auto &chunk : chunks_)
+    {
+      if (chunk.failed)
+      {
+        std::cerr << "ERROR: malformed vertex or face in obj file: " << path + name << "\n";
+        return false;
+      }
+    }
+
+    // libraries are small and few, they are read after the geometry on this thread
+    std::vector<std::string> libraries;
+    for (auto &chunk : chunks_)
+      for (auto &library : chunk.libraries)
+        if (std::find(libraries.begin(), libraries.end(), library) == libraries.end())
+          libraries.push_back(library);
+
+    mesh.materials_.clear();
+    for (auto &library : libraries)
+      if (!parseMaterials(path + library, mesh.materials_))
+        std::cerr << "WARNING: missing material library " << path + library << "\n";
+
+    double build_start = Time::current();
+    bool built = build(mesh);
+    stats_.build_time = Time::current() - build_start;
+
+    chunks_.clear();
+    return built;
+  }
+
+
+  const ObjStats& ObjLoader::getStats() const
+  {
+    return stats_;
+  }
+
+
+  const char* ObjLoader::parseFloat(const char *begin, const char *end, float &value)
+  {
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+      negative = (*p++ == '-');
+
+    // 19 significant digits always fit, the rest only shifts the exponent
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int exponent = 0;
+    bool any_digit = false;
+
+    while (p < end && isDigit(*p))
+    {
+      if (significant < 19)
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa) significant++;
+      }
+      else
+        exponent++;
+
+      any_digit = true;
+      ++p;
+    }
+
+    if (p < end && *p == '.')
+    {
+      ++p;
+      while (p < end && isDigit(*p))
+      {
+        if (significant < 19)
+        {
+          mantissa = mantissa * 10 + (*p - '0');
+          if (mantissa) significant++;
+          exponent--;
+        }
+
+        any_digit = true;
+        ++p;
+      }
+    }
+
+    if (!any_digit) return begin;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+      int written_exponent;
+      const char *after = parseInt(p + 1, end, written_exponent);
+      if (after != p + 1)
+      {
+        exponent += written_exponent;
+        p = after;
+      }
+    }
+
+    // exact for every mantissa below 2^53 with a power of ten that is itself exact
+    double result = (double)mantissa;
+    if (exponent < 0 && exponent >= -22)
+      result /= POWERS_OF_TEN[-exponent];
+    else if (exponent > 0 && exponent <= 22)
+      result *= POWERS_OF_TEN[exponent];
+    else if (exponent != 0)
+      result *= std::pow(10.0, exponent);
+
+    value = (float)(negative ? -result : result);
+    return p;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void ObjLoader::parseChunk(Chunk &chunk)
+  {
+    // roughly one element per 30 bytes in typical exports, saves most regrowth
+    size_t estimate = (chunk.end - chunk.begin) / 30;
+    chunk.positions.reserve(estimate / 3);
+    chunk.normals.reserve(estimate / 3);
+    chunk.tex_coords.reserve(estimate / 3);
+    chunk.corners.reserve(estimate);
+
+    const char *p = chunk.begin;
+    while (p < chunk.end)
+    {
+      const char *line_end = (const char *)std::memchr(p, '\n', chunk.end - p);
+      if (!line_end) line_end = chunk.end;
+
+      p = skipSpaces(p, line_end);
+      if (line_end - p >= 2)
+      {
+        if (p[0] == 'v' && isSpace(p[1]))
+        {
+          glm::vec3 position(0.0f);
+          if (parseComponents(p + 2, line_end, &position[0], 3) < 3)
+          {
+            chunk.failed = true;
+            return;
+          }
+          chunk.positions.push_back(position);
+        }
+        else if (p[0] == 'v' && p[1] == 'n')
+        {
+          glm::vec3 normal(0.0f);
+          if (parseComponents(p + 2, line_end, &normal[0], 3) < 3)
+          {
+            chunk.failed = true;
+            return;
+          }
+          chunk.normals.push_back(normal);
+        }
+        else if (p[0] == 'v' && p[1] == 't')
+        {
+          // v is optional and defaults to 0, only u is required
+          glm::vec2 tex_coord(0.0f);
+          if (parseComponents(p + 2, line_end, &tex_coord[0], 2) < 1)
+          {
+            chunk.failed = true;
+            return;
+          }
+          tex_coord.y = 1.0f - tex_coord.y; // same orientation as the assimp import
+          chunk.tex_coords.push_back(tex_coord);
+        }
+        else if (p[0] == 'f' && isSpace(p[1]))
+        {
+          Corner polygon[MAX_POLYGON_CORNERS];
+          int corner_count = 0;
+
+          const char *q = p + 1;
+          while (true)
+          {
+            q = skipSpaces(q, line_end);
+            if (q >= line_end || *q == '\r' || *q == '#') break;
+
+            Corner corner = { 0, -1, -1, 0 };
+            int value;
+            const char *next = parseInt(q, line_end, value);
+            if (next == q || !resolveIndex(value, chunk.positions.size(), corner.position, corner.relative, RELATIVE_POSITION))
+            {
+              chunk.failed = true;
+              break;
+            }
+            q = next;
+
+            if (q < line_end && *q == '/')
+            {
+              ++q;
+              if (q < line_end && *q != '/')
+              {
+                next = parseInt(q, line_end, value);
+                if (next == q || !resolveIndex(value, chunk.tex_coords.size(), corner.tex_coord, corner.relative, RELATIVE_TEX_COORD))
+                {
+                  chunk.failed = true;
+                  break;
+                }
+                q = next;
+              }
+
+              if (q < line_end && *q == '/')
+              {
+                ++q;
+                next = parseInt(q, line_end, value);
+                if (next == q || !resolveIndex(value, chunk.normals.size(), corner.normal, corner.relative, RELATIVE_NORMAL))
+                {
+                  chunk.failed = true;
+                  break;
+                }
+                q = next;
+              }
+            }
+
+            if (corner_count < MAX_POLYGON_CORNERS)
+              polygon[corner_count++] = corner;
+          }
+
+          // convex polygons become a fan around their first corner
+          for (int i = 2; i < corner_count; ++i)
+          {
+            chunk.corners.push_back(polygon[0]);
+            chunk.corners.push_back(polygon[i - 1]);
+            chunk.corners.push_back(polygon[i]);
+          }
+        }
+        else if (startsWith(p, line_end, "usemtl", 6))
+          chunk.material_changes.push_back(std::make_pair(chunk.corners.size() / 3, readName(p + 6, line_end)));
+        else if (startsWith(p, line_end, "mtllib", 6))
+          chunk.libraries.push_back(readName(p + 6, line_end));
+      }
+
+      p = line_end + 1;
+    }
+  }
+
+
+  bool ObjLoader::parseMaterials(const std::string &file, std::vector<MeshMaterial> &materials)
+  {
+    std::ifstream stream(file.c_str());
+    if (!stream.is_open()) return false;
+
+    MeshMaterial *material = nullptr;
+    std::string line;
+    while (std::getline(stream, line))
+    {
+      std::istringstream tokens(line);
+      std::string keyword;
+      tokens >> keyword;
+
+      if (keyword == "newmtl")
+      {
+        materials.push_back(MeshMaterial());
+        material = &materials.back();
+        material->name = readName(line.c_str() + line.find("newmtl") + 6, line.c_str() + line.size());
+        material->diffuse_color = glm::vec3(1.0f);
+        material->shininess = 32.0f;
+        material->opacity = 1.0f;
+      }
+      else if (!material || keyword.empty() || keyword[0] == '#')
+        continue;
+      else if (keyword == "Kd")
+        tokens >> material->diffuse_color.x >> material->diffuse_color.y >> material->diffuse_color.z;
+      else if (keyword == "Ks")
+        tokens >> material->specular_color.x >> material->specular_color.y >> material->specular_color.z;
+      else if (keyword == "Ns")
+        tokens >> material->shininess;
+      else if (keyword == "d")
+        tokens >> material->opacity;
+      else if (keyword == "Tr")
+      {
+        float transparency = 0.0f;
+        tokens >> transparency;
+        material->opacity = 1.0f - transparency;
+      }
+      else if (hasMap(keyword))
+      {
+        // options come before the file name, which is always the last token
+        std::string map, token;
+        while (tokens >> token)
+          map = token;
+
+        if (keyword == "map_Kd")
+          material->diffuse_map = map;
+        else if (keyword == "map_Ks")
+          material->specular_map = map;
+        else
+          material->normal_map = map;
+      }
+    }
+
+    return true;
+  }
+
+
+  bool ObjLoader::build(Mesh &mesh)
+  {
+    // element offsets of every chunk, relative indices are fixed up with these
+    std::vector<size_t> position_offsets(chunks_.size()), normal_offsets(chunks_.size()),
+                        tex_coord_offsets(chunks_.size()), triangle_offsets(chunks_.size());
+    size_t position_count = 0, normal_count = 0, tex_coord_count = 0, triangle_count = 0;
+    for (size_t c = 0; c < chunks_.size(); ++c)
+    {
+      position_offsets[c] = position_count;
+      normal_offsets[c] = normal_count;
+      tex_coord_offsets[c] = tex_coord_count;
+      triangle_offsets[c] = triangle_count;
+      position_count += chunks_[c].positions.size();
+      normal_count += chunks_[c].normals.size();
+      tex_coord_count += chunks_[c].tex_coords.size();
+      triangle_count += chunks_[c].corners.size() / 3;
+    }
+
+    stats_.positions = position_count;
+    stats_.normals = normal_count;
+    stats_.tex_coords = tex_coord_count;
+    stats_.triangles = triangle_count;
+
+    if (normal_count == 0 || triangle_count == 0)
+      return false;
+
+    // a material can be set in one chunk and used in the next, so runs are resolved in order
+    struct Run
+    {
+      size_t chunk;
+      size_t first;
+      size_t count;
+      unsigned int material;
+    };
+
+    std::unordered_map<std::string, unsigned int> material_indices;
+    for (size_t i = 0; i < mesh.materials_.size(); ++i)
+      material_indices[mesh.materials_[i].name] = (unsigned int)i;
+
+    auto materialIndex = [&](const std::string &name) -> unsigned int
+    {
+      auto found = material_indices.find(name);
+      if (found != material_indices.end()) return found->second;
+
+      MeshMaterial material = MeshMaterial();
+      material.name = name;
+      material.diffuse_color = glm::vec3(1.0f);
+      material.shininess = 32.0f;
+      material.opacity = 1.0f;
+      mesh.materials_.push_back(material);
+      return material_indices[name] = (unsigned int)(mesh.materials_.size() - 1);
+    };
+
+    // faces before the first usemtl get an unnamed material, only created if there are any
+    std::vector<Run> runs;
+    std::string current_material;
+    for (size_t c = 0; c < chunks_.size(); ++c)
+    {
+      const Chunk &chunk = chunks_[c];
+      size_t chunk_triangles = chunk.corners.size() / 3;
+      size_t first = 0;
+
+      for (size_t m = 0; m <= chunk.material_changes.size(); ++m)
+      {
+        size_t last = (m < chunk.material_changes.size()) ? chunk.material_changes[m].first : chunk_triangles;
+        if (last > first)
+        {
+          Run run = { c, first, last - first, materialIndex(current_material) };
+          runs.push_back(run);
+        }
+
+        if (m < chunk.material_changes.size())
+          current_material = chunk.material_changes[m].second;
+        first = last;
+      }
+    }
+
+    // flat copies of the attribute streams so lookups don't have to find the chunk
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> tex_coords;
+    positions.reserve(position_count);
+    normals.reserve(normal_count);
+    tex_coords.reserve(tex_coord_count);
+    for (auto &chunk : chunks_)
+    {
+      positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+      normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+      tex_coords.insert(tex_coords.end(), chunk.tex_coords.begin(), chunk.tex_coords.end());
+    }
+
+    // open addressing, the table holds vertex index + 1 and the keys live next to the vertices
+    size_t table_size = 1;
+    while (table_size < triangle_count * 3 * 2) table_size <<= 1;
+    std::vector<uint32_t> table(table_size, 0);
+    std::vector<int32_t> keys;
+    keys.reserve(triangle_count * 3);
+
+    std::vector<MeshVertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<Submesh> submeshes;
+    vertices.reserve(triangle_count);
+    indices.reserve(triangle_count * 3);
+
+    AABB bounds;
+    for (unsigned int material = 0; material < mesh.materials_.size(); ++material)
+    {
+      Submesh submesh = Submesh();
+      submesh.first_index = (GLuint)indices.size();
+      submesh.material = material;
+
+      for (auto &run : runs)
+      {
+        if (run.material != material) continue;
+
+        const Chunk &chunk = chunks_[run.chunk];
+        for (size_t i = run.first * 3; i < (run.first + run.count) * 3; ++i)
+        {
+          const Corner &corner = chunk.corners[i];
+          int32_t p = corner.position + ((corner.relative & RELATIVE_POSITION) ? (int32_t)position_offsets[run.chunk] : 0);
+          int32_t t = corner.tex_coord;
+          if (t >= 0 || (corner.relative & RELATIVE_TEX_COORD))
+            t += (corner.relative & RELATIVE_TEX_COORD) ? (int32_t)tex_coord_offsets[run.chunk] : 0;
+          int32_t n = corner.normal + ((corner.relative & RELATIVE_NORMAL) ? (int32_t)normal_offsets[run.chunk] : 0);
+
+          if (p < 0 || p >= (int32_t)position_count || n < 0 || n >= (int32_t)normal_count ||
+              t < -1 || t >= (int32_t)tex_coord_count)
+            return false;
+
+          uint32_t hash = (uint32_t)p * 73856093u ^ (uint32_t)t * 19349663u ^ (uint32_t)n * 83492791u;
+          size_t slot = (hash * 2654435769u) & (table_size - 1);
+
+          uint32_t index = 0;
+          while (table[slot])
+          {
+            uint32_t candidate = table[slot] - 1;
+            if (keys[candidate * 3] == p && keys[candidate * 3 + 1] == t && keys[candidate * 3 + 2] == n)
+            {
+              index = table[slot];
+              break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+          }
+
+          if (!index)
+          {
+            MeshVertex vertex = MeshVertex();
+            vertex.position = positions[p];
+            vertex.normal = normals[n];
+            if (t >= 0) vertex.tex_coord = tex_coords[t];
+            bounds.expand(vertex.position);
+
+            vertices.push_back(vertex);
+            keys.push_back(p);
+            keys.push_back(t);
+            keys.push_back(n);
+            index = (uint32_t)vertices.size();
+            table[slot] = index;
+          }
+
+          indices.push_back(index - 1);
+        }
+      }
+
+      submesh.index_count = (GLuint)indices.size() - submesh.first_index;
+      if (submesh.index_count > 0)
+        submeshes.push_back(submesh);
+    }
+
+    // tangents from the uv gradients, averaged over every triangle sharing a vertex
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+      MeshVertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+      glm::vec3 edge1 = b.position - a.position, edge2 = c.position - a.position;
+      glm::vec2 uv1 = b.tex_coord - a.tex_coord, uv2 = c.tex_coord - a.tex_coord;
+
+      float determinant = uv1.x * uv2.y - uv2.x * uv1.y;
+      if (std::fabs(determinant) < 1e-12f) continue;
+
+      glm::vec3 tangent = (edge1 * uv2.y - edge2 * uv1.y) / determinant;
+      a.tangent += tangent;
+      b.tangent += tangent;
+      c.tangent += tangent;
+    }
+
+    for (auto &vertex : vertices)
+    {
+      glm::vec3 tangent = vertex.tangent - vertex.normal * glm::dot(vertex.normal, vertex.tangent);
+      if (glm::dot(tangent, tangent) < 1e-12f)
+      {
+        // no usable uv gradient, any vector perpendicular to the normal will do
+        glm::vec3 axis = (std::fabs(vertex.normal.x) < 0.9f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        tangent = glm::cross(vertex.normal, axis);
+      }
+      vertex.tangent = glm::normalize(tangent);
+    }
+
+    stats_.vertices = vertices.size();
+
+    mesh.vertices_.swap(vertices);
+    mesh.indices_.swap(indices);
+    mesh.submeshes_.swap(submeshes);
+    mesh.bounds_ = bounds;
+    return true;
+  }
+} // namespace vv
\ No newline at end of file
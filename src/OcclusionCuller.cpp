@@ -0,0 +1,345 @@
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+
+#include "vv/OcclusionCuller.h"
+#include "vv/ThreadPool.h"
+#include "vv/Time.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VV_OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+namespace vv
+{
+  static const int TILE_WIDTH = 32; /* must stay a multiple of 4 for the sse path */
+  static const int TILE_HEIGHT = 16;
+  static const float MIN_CLIP_W = 1e-5f;
+
+  /////////////////////////////////////////////////////////////////////// public
+  OcclusionCuller::OcclusionCuller() :
+    width_(0),
+    height_(0),
+    tiles_x_(0),
+    tiles_y_(0),
+    view_projection_(1.0f)
+  {
+    stats_ = OcclusionStats();
+  }
+
+
+  OcclusionCuller::~OcclusionCuller()
+  {
+  }
+
+
+  bool OcclusionCuller::init(int width, int height)
+  {
+    if (width <= 0 || height <= 0)
+    {
+      std::cerr << "ERROR: occlusion buffer needs a positive resolution.\n";
+      return false;
+    }
+
+    tiles_x_ = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+    tiles_y_ = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+    width_ = tiles_x_ * TILE_WIDTH;
+    height_ = tiles_y_ * TILE_HEIGHT;
+
+    depth_.assign(width_ * height_, 1.0f);
+    tile_bins_.resize(tiles_x_ * tiles_y_);
+    return true;
+  }
+
+
+  void OcclusionCuller::beginFrame(const glm::mat4 &view_projection)
+  {
+    view_projection_ = view_projection;
+    occluders_.clear();
+    stats_ = OcclusionStats();
+  }
+
+
+  void OcclusionCuller::addOccluder(const glm::vec3 *positions, const unsigned int *indices,
+                                   size_t index_count, const glm::mat4 &model)
+  {
+    if (!positions || !indices || index_count < 3) return;
+
+    Occluder occluder = { positions, indices, index_count - (index_count % 3), model };
+    occluders_.push_back(occluder);
+  }
+
+
+  void OcclusionCuller::rasterizeOccluders()
+  {
+    if (depth_.empty()) return;
+
+    double start_time = Time::current();
+
+    setupTriangles();
+    ThreadPool::instance()->parallelFor(tile_bins_.size(), 1, [this](size_t begin, size_t end)
+    {
+      for (size_t tile = begin; tile < end; ++tile)
+        rasterizeTile((int)tile);
+    });
+
+    stats_.occluders = occluders_.size();
+    stats_.occluder_triangles = triangles_.size();
+    stats_.rasterize_time = Time::current() - start_time;
+  }
+
+
+  bool OcclusionCuller::isOccluded(const AABB &world_bounds) const
+  {
+    if (!world_bounds.isValid() || depth_.empty()) return false;
+
+    float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+    float nearest_depth = FLT_MAX;
+
+    for (int i = 0; i < 8; ++i)
+    {
+      glm::vec4 clip = view_projection_ * glm::vec4(world_bounds.getCorner(i), 1.0f);
+      if (clip.w <= MIN_CLIP_W) return false;
+
+      float inv_w = 1.0f / clip.w;
+      float x = (clip.x * inv_w * 0.5f + 0.5f) * width_;
+      float y = (clip.y * inv_w * 0.5f + 0.5f) * height_;
+
+      min_x = std::min(min_x, x);
+      max_x = std::max(max_x, x);
+      min_y = std::min(min_y, y);
+      max_y = std::max(max_y, y);
+      nearest_depth = std::min(nearest_depth, clip.z * inv_w);
+    }
+
+    // entirely off screen is the frustum culler's call, not ours
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= width_ || min_y >= height_)
+      return false;
+
+    int x0 = std::max(0, (int)std::floor(min_x)) & ~3;
+    int y0 = std::max(0, (int)std::floor(min_y));
+    int x1 = std::min(width_ - 1, (int)std::ceil(max_x));
+    int y1 = std::min(height_ - 1, (int)std::ceil(max_y));
+
+#ifdef VV_OCCLUSION_SSE
+    const __m128 box_depth = _mm_set1_ps(nearest_depth);
+    for (int y = y0; y <= y1; ++y)
+    {
+      for (int x = x0; x <= x1; x += 4)
+      {
+        __m128 occluder_depth = _mm_loadu_ps(&depth_[depthIndex(x, y)]);
+        if (_mm_movemask_ps(_mm_cmpge_ps(occluder_depth, box_depth)))
+          return false;
+      }
+    }
+#else
+    for (int y = y0; y <= y1; ++y)
+      for (int x = x0; x <= x1; ++x)
+        if (depth_[depthIndex(x, y)] >= nearest_depth)
+          return false;
+#endif
+
+    return true;
+  }
+
+
+  void OcclusionCuller::cull(const std::set<Entity *> &entities)
+  {
+    double start_time = Time::current();
+
+    // kept between frames so a steady scene does not touch the heap
+    candidates_.clear();
+    for (auto entity : entities)
+    {
+      entity->setOccluded(false);
+      if (entity->isRenderable())
+        candidates_.push_back(entity);
+    }
+
+    std::atomic<size_t> occluded_count(0);
+    ThreadPool::instance()->parallelFor(candidates_.size(), 64,
+      [this, &occluded_count](size_t begin, size_t end)
+    {
+      size_t occluded = 0;
+      for (size_t i = begin; i < end; ++i)
+      {
+        if (isOccluded(candidates_[i]->getWorldBounds()))
+        {
+          candidates_[i]->setOccluded(true);
+          occluded++;
+        }
+      }
+      occluded_count += occluded;
+    });
+
+    stats_.entities_tested = candidates_.size();
+    stats_.entities_occluded = occluded_count;
+    stats_.test_time = Time::current() - start_time;
+  }
+
+
+  const OcclusionStats& OcclusionCuller::getStats() const
+  {
+    return stats_;
+  }
+
+
+  const float* OcclusionCuller::getDepthBuffer() const
+  {
+    return depth_.data();
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  size_t OcclusionCuller::depthIndex(int x, int y) const
+  {
+    int tile = (y / TILE_HEIGHT) * tiles_x_ + (x / TILE_WIDTH);
+    return tile * (TILE_WIDTH * TILE_HEIGHT) + (y % TILE_HEIGHT) * TILE_WIDTH + (x % TILE_WIDTH);
+  }
+
+
+  void OcclusionCuller::setupTriangles()
+  {
+    triangles_.clear();
+    for (auto &bin : tile_bins_)
+      bin.clear();
+
+    glm::vec4 screen[3];
+    for (auto &occluder : occluders_)
+    {
+      glm::mat4 model_view_projection = view_projection_ * occluder.model;
+
+      for (size_t i = 0; i < occluder.index_count; i += 3)
+      {
+        bool clipped = false;
+        for (int v = 0; v < 3; ++v)
+        {
+          glm::vec4 clip = model_view_projection * glm::vec4(occluder.positions[occluder.indices[i + v]], 1.0f);
+          // dropping an occluder is always safe, so skip anything crossing the near plane
+          if (clip.w <= MIN_CLIP_W)
+          {
+            clipped = true;
+            break;
+          }
+
+          float inv_w = 1.0f / clip.w;
+          screen[v] = glm::vec4((clip.x * inv_w * 0.5f + 0.5f) * width_,
+                                (clip.y * inv_w * 0.5f + 0.5f) * height_,
+                                clip.z * inv_w, 1.0f);
+        }
+
+        if (clipped) continue;
+
+        const glm::vec4 &p0 = screen[0], &p1 = screen[1], &p2 = screen[2];
+        float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+
+        // back facing or degenerate
+        if (area <= 0.0f) continue;
+
+        ScreenTriangle tri;
+        tri.min_x = std::max(0, (int)std::floor(std::min(p0.x, std::min(p1.x, p2.x))));
+        tri.min_y = std::max(0, (int)std::floor(std::min(p0.y, std::min(p1.y, p2.y))));
+        tri.max_x = std::min(width_ - 1, (int)std::ceil(std::max(p0.x, std::max(p1.x, p2.x))));
+        tri.max_y = std::min(height_ - 1, (int)std::ceil(std::max(p0.y, std::max(p1.y, p2.y))));
+        if (tri.min_x > tri.max_x || tri.min_y > tri.max_y) continue;
+
+        tri.edge_a[0] = p1.y - p2.y;
+        tri.edge_b[0] = p2.x - p1.x;
+        tri.edge_c[0] = (p2.y - p1.y) * p1.x - (p2.x - p1.x) * p1.y;
+        tri.edge_a[1] = p2.y - p0.y;
+        tri.edge_b[1] = p0.x - p2.x;
+        tri.edge_c[1] = (p0.y - p2.y) * p2.x - (p0.x - p2.x) * p2.y;
+        tri.edge_a[2] = p0.y - p1.y;
+        tri.edge_b[2] = p1.x - p0.x;
+        tri.edge_c[2] = (p1.y - p0.y) * p0.x - (p1.x - p0.x) * p0.y;
+
+        float inv_area = 1.0f / area;
+        tri.depth_a = (tri.edge_a[0] * p0.z + tri.edge_a[1] * p1.z + tri.edge_a[2] * p2.z) * inv_area;
+        tri.depth_b = (tri.edge_b[0] * p0.z + tri.edge_b[1] * p1.z + tri.edge_b[2] * p2.z) * inv_area;
+        tri.depth_c = (tri.edge_c[0] * p0.z + tri.edge_c[1] * p1.z + tri.edge_c[2] * p2.z) * inv_area;
+
+        unsigned int index = (unsigned int)triangles_.size();
+        triangles_.push_back(tri);
+
+        for (int ty = tri.min_y / TILE_HEIGHT; ty <= tri.max_y / TILE_HEIGHT; ++ty)
+          for (int tx = tri.min_x / TILE_WIDTH; tx <= tri.max_x / TILE_WIDTH; ++tx)
+            tile_bins_[ty * tiles_x_ + tx].push_back(index);
+      }
+    }
+  }
+
+
+  void OcclusionCuller::rasterizeTile(int tile)
+  {
+    float *tile_depth = &depth_[tile * TILE_WIDTH * TILE_HEIGHT];
+    std::fill(tile_depth, tile_depth + TILE_WIDTH * TILE_HEIGHT, 1.0f);
+
+    const int tile_x = (tile % tiles_x_) * TILE_WIDTH;
+    const int tile_y = (tile / tiles_x_) * TILE_HEIGHT;
+
+    for (auto index : tile_bins_[tile])
+    {
+      const ScreenTriangle &tri = triangles_[index];
+
+      int x0 = (std::max(tri.min_x, tile_x) - tile_x) & ~3;
+      int x1 = std::min(tri.max_x, tile_x + TILE_WIDTH - 1) - tile_x;
+      int y0 = std::max(tri.min_y, tile_y) - tile_y;
+      int y1 = std::min(tri.max_y, tile_y + TILE_HEIGHT - 1) - tile_y;
+
+#ifdef VV_OCCLUSION_SSE
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+      const __m128 a0 = _mm_set1_ps(tri.edge_a[0]);
+      const __m128 a1 = _mm_set1_ps(tri.edge_a[1]);
+      const __m128 a2 = _mm_set1_ps(tri.edge_a[2]);
+      const __m128 depth_a = _mm_set1_ps(tri.depth_a);
+
+      for (int y = y0; y <= y1; ++y)
+      {
+        float py = (float)(tile_y + y) + 0.5f;
+        __m128 row0 = _mm_set1_ps(tri.edge_b[0] * py + tri.edge_c[0]);
+        __m128 row1 = _mm_set1_ps(tri.edge_b[1] * py + tri.edge_c[1]);
+        __m128 row2 = _mm_set1_ps(tri.edge_b[2] * py + tri.edge_c[2]);
+        __m128 row_depth = _mm_set1_ps(tri.depth_b * py + tri.depth_c);
+
+        float *row = tile_depth + y * TILE_WIDTH;
+        for (int x = x0; x <= x1; x += 4)
+        {
+          __m128 px = _mm_add_ps(_mm_set1_ps((float)(tile_x + x)), offsets);
+          __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+          __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+          __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+          __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                     _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+          if (!_mm_movemask_ps(inside)) continue;
+
+          __m128 depth = _mm_add_ps(_mm_mul_ps(depth_a, px), row_depth);
+          __m128 previous = _mm_loadu_ps(row + x);
+          __m128 nearest = _mm_min_ps(previous, depth);
+          _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+        }
+      }
+#else
+      for (int y = y0; y <= y1; ++y)
+      {
+        float py = (float)(tile_y + y) + 0.5f;
+        float *row = tile_depth + y * TILE_WIDTH;
+        for (int x = x0; x <= x1; ++x)
+        {
+          float px = (float)(tile_x + x) + 0.5f;
+          if ((tri.edge_a[0] * px + tri.edge_b[0] * py + tri.edge_c[0] < 0.0f) ||
+              (tri.edge_a[1] * px + tri.edge_b[1] * py + tri.edge_c[1] < 0.0f) ||
+              (tri.edge_a[2] * px + tri.edge_b[2] * py + tri.edge_c[2] < 0.0f))
+            continue;
+
+          float depth = tri.depth_a * px + tri.depth_b * py + tri.depth_c;
+          row[x] = std::min(row[x], depth);
+        }
+      }
+#endif
+    }
+  }
+} // namespace vv
\ No newline at end of file
@@ -0,0 +1,459 @@
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "vv/GLStateCache.h"
+#include "vv/MemoryTracker.h"
+#include "vv/ParticleSystem.h"
+#include "vv/Settings.h"
+#include "vv/ThreadPool.h"
+#include "vv/Time.h"
+#include "vv/VirtualVista.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VV_PARTICLE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace vv
+{
+  /* Floats per instance in the stream buffer: position and normalized age */
+  static const size_t INSTANCE_FLOATS = 4;
+
+  /////////////////////////////////////////////////////////////////////// public
+  ParticleEmitter::ParticleEmitter(const EmitterSettings &settings) :
+    settings_(settings),
+    position_(0.0f),
+    emitting_(true),
+    emission_accumulator_(0.0f),
+    random_state_(0x9e3779b9u),
+    count_(0),
+    stream_offset_(0)
+  {
+    VV_MEMORY_SCOPE(MEMORY_SCENE);
+
+    size_t capacity = settings_.capacity;
+    position_x_.resize(capacity);
+    position_y_.resize(capacity);
+    position_z_.resize(capacity);
+    velocity_x_.resize(capacity);
+    velocity_y_.resize(capacity);
+    velocity_z_.resize(capacity);
+    age_.resize(capacity);
+    lifetime_.resize(capacity);
+  }
+
+
+  void ParticleEmitter::setPosition(const glm::vec3 &position)
+  {
+    position_ = position;
+  }
+
+
+  const glm::vec3& ParticleEmitter::getPosition() const
+  {
+    return position_;
+  }
+
+
+  void ParticleEmitter::setEmitting(bool emitting)
+  {
+    emitting_ = emitting;
+  }
+
+
+  const EmitterSettings& ParticleEmitter::getSettings() const
+  {
+    return settings_;
+  }
+
+
+  void ParticleEmitter::emit(size_t count)
+  {
+    spawnParticles(count);
+  }
+
+
+  size_t ParticleEmitter::getCount() const
+  {
+    return count_;
+  }
+
+
+  size_t ParticleEmitter::getCapacity() const
+  {
+    return settings_.capacity;
+  }
+
+
+  ParticleSystem::ParticleSystem() :
+    shader_(nullptr),
+    vao_(0),
+    stream_buffer_(0),
+    stream_capacity_(0),
+    view_location_(-1),
+    projection_location_(-1),
+    size_range_location_(-1),
+    color_start_location_(-1),
+    color_end_location_(-1)
+  {
+    stats_ = ParticleStats();
+  }
+
+
+  ParticleSystem::~ParticleSystem()
+  {
+    for (auto emitter : emitters_)
+      SAFE_DELETE(emitter);
+
+    SAFE_DELETE(shader_);
+
+    GLStateCache *cache = GLStateCache::instance();
+    if (vao_)
+    {
+      cache->onDeleteVertexArray(vao_);
+      glDeleteVertexArrays(1, &vao_);
+    }
+
+    if (stream_buffer_)
+    {
+      cache->onDeleteBuffer(stream_buffer_);
+      glDeleteBuffers(1, &stream_buffer_);
+    }
+  }
+
+
+  bool ParticleSystem::init()
+  {
+    if (shader_) return true;
+
+    shader_ = new Shader(Settings::instance()->getShaderLocation(), "particle");
+    if (!shader_->init())
+    {
+      SAFE_DELETE(shader_);
+      return false;
+    }
+
+    view_location_ = shader_->getUniformLocation("view");
+    projection_location_ = shader_->getUniformLocation("projection");
+    size_range_location_ = shader_->getUniformLocation("size_range");
+    color_start_location_ = shader_->getUniformLocation("color_start");
+    color_end_location_ = shader_->getUniformLocation("color_end");
+
+    // quad corners come from gl_VertexID, the only attribute is the per instance stream
+    GLStateCache *cache = GLStateCache::instance();
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &stream_buffer_);
+    cache->bindVertexArray(vao_);
+    cache->bindBuffer(GL_ARRAY_BUFFER, stream_buffer_);
+    glEnableVertexAttribArray(0);
+    glVertexAttribDivisor(0, 1);
+    cache->bindVertexArray(0);
+
+    return true;
+  }
+
+
+  ParticleEmitter* ParticleSystem::createEmitter(const EmitterSettings &settings)
+  {
+    VV_MEMORY_SCOPE(MEMORY_SCENE);
+
+    ParticleEmitter *emitter = new ParticleEmitter(settings);
+    emitters_.push_back(emitter);
+    return emitter;
+  }
+
+
+  void ParticleSystem::destroyEmitter(ParticleEmitter *emitter)
+  {
+    auto found = std::find(emitters_.begin(), emitters_.end(), emitter);
+    if (found == emitters_.end()) return;
+
+    emitters_.erase(found);
+    SAFE_DELETE(emitter);
+  }
+
+
+  void ParticleSystem::update(float delta_time)
+  {
+    double start_time = Time::current();
+
+    buildJobs();
+    ThreadPool::instance()->parallelFor(jobs_.size(), 1, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+        jobs_[i].emitter->simulate(jobs_[i].begin, jobs_[i].end, delta_time);
+    });
+
+    // compaction reorders a whole emitter, so it can only be split per emitter
+    ThreadPool::instance()->parallelFor(emitters_.size(), 1, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+      {
+        emitters_[i]->compact();
+        emitters_[i]->spawn(delta_time);
+      }
+    });
+
+    stats_.emitters = emitters_.size();
+    stats_.particles = 0;
+    for (auto emitter : emitters_)
+      stats_.particles += emitter->count_;
+
+    stats_.simulate_time = Time::current() - start_time;
+  }
+
+
+  void ParticleSystem::render(const glm::mat4 &view, const glm::mat4 &projection)
+  {
+    if (!shader_ && !init()) return;
+
+    upload();
+    if (stats_.particles == 0) return;
+
+    GLStateCache *cache = GLStateCache::instance();
+    shader_->useProgram();
+    glUniformMatrix4fv(view_location_, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(projection_location_, 1, GL_FALSE, glm::value_ptr(projection));
+    cache->countApiCalls(2);
+
+    // particles are tested against the scene but never occlude each other
+    cache->setDepthTest(true);
+    cache->setDepthMask(false);
+    cache->setBlend(true);
+    cache->bindVertexArray(vao_);
+    cache->bindBuffer(GL_ARRAY_BUFFER, stream_buffer_);
+
+    for (auto emitter : emitters_)
+    {
+      if (emitter->count_ == 0) continue;
+
+      const EmitterSettings &settings = emitter->settings_;
+      cache->setBlendFunc(GL_SRC_ALPHA, settings.additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+      glUniform2f(size_range_location_, settings.size_start, settings.size_end);
+      glUniform4fv(color_start_location_, 1, glm::value_ptr(settings.color_start));
+      glUniform4fv(color_end_location_, 1, glm::value_ptr(settings.color_end));
+
+      // without base instance the stream offset has to go through the attribute pointer
+      glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float),
+                            (GLvoid *)(emitter->stream_offset_ * INSTANCE_FLOATS * sizeof(float)));
+      cache->countApiCalls(4);
+
+      cache->drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)emitter->count_);
+    }
+
+    cache->setDepthMask(true);
+    cache->setBlend(false);
+  }
+
+
+  const ParticleStats& ParticleSystem::getStats() const
+  {
+    return stats_;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void ParticleEmitter::simulate(size_t begin, size_t end, float delta_time)
+  {
+    const float damping = std::max(0.0f, 1.0f - settings_.drag * delta_time);
+    const glm::vec3 velocity_change = settings_.acceleration * delta_time;
+
+    float *px = position_x_.data(), *py = position_y_.data(), *pz = position_z_.data();
+    float *vx = velocity_x_.data(), *vy = velocity_y_.data(), *vz = velocity_z_.data();
+    float *age = age_.data();
+
+    size_t i = begin;
+
+#ifdef VV_PARTICLE_SSE
+    const __m128 dt = _mm_set1_ps(delta_time);
+    const __m128 damp = _mm_set1_ps(damping);
+    const __m128 dvx = _mm_set1_ps(velocity_change.x);
+    const __m128 dvy = _mm_set1_ps(velocity_change.y);
+    const __m128 dvz = _mm_set1_ps(velocity_change.z);
+
+    for (; i + 4 <= end; i += 4)
+    {
+      __m128 x = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), dvx), damp);
+      __m128 y = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), dvy), damp);
+      __m128 z = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vz + i), dvz), damp);
+      _mm_storeu_ps(vx + i, x);
+      _mm_storeu_ps(vy + i, y);
+      _mm_storeu_ps(vz + i, z);
+
+      _mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(x, dt)));
+      _mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(y, dt)));
+      _mm_storeu_ps(pz + i, _mm_add_ps(_mm_loadu_ps(pz + i), _mm_mul_ps(z, dt)));
+      _mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), dt));
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+      vx[i] = (vx[i] + velocity_change.x) * damping;
+      vy[i] = (vy[i] + velocity_change.y) * damping;
+      vz[i] = (vz[i] + velocity_change.z) * damping;
+      px[i] += vx[i] * delta_time;
+      py[i] += vy[i] * delta_time;
+      pz[i] += vz[i] * delta_time;
+      age[i] += delta_time;
+    }
+  }
+
+
+  void ParticleEmitter::compact()
+  {
+    // swap the last live particle into every dead slot, order doesn't matter for additive
+    // blending and alpha blended particles were never sorted to begin with
+    size_t i = 0;
+    while (i < count_)
+    {
+      if (age_[i] < lifetime_[i])
+      {
+        ++i;
+        continue;
+      }
+
+      size_t last = --count_;
+      position_x_[i] = position_x_[last];
+      position_y_[i] = position_y_[last];
+      position_z_[i] = position_z_[last];
+      velocity_x_[i] = velocity_x_[last];
+      velocity_y_[i] = velocity_y_[last];
+      velocity_z_[i] = velocity_z_[last];
+      age_[i] = age_[last];
+      lifetime_[i] = lifetime_[last];
+    }
+  }
+
+
+  void ParticleEmitter::spawn(float delta_time)
+  {
+    if (!emitting_) return;
+
+    emission_accumulator_ += settings_.emission_rate * delta_time;
+    size_t count = (size_t)emission_accumulator_;
+    emission_accumulator_ -= (float)count;
+
+    spawnParticles(count);
+  }
+
+
+  void ParticleEmitter::spawnParticles(size_t count)
+  {
+    size_t last = std::min(count_ + count, settings_.capacity);
+    const glm::vec3 &extent = settings_.spawn_extent;
+
+    for (size_t i = count_; i < last; ++i)
+    {
+      position_x_[i] = position_.x + random(-extent.x, extent.x);
+      position_y_[i] = position_.y + random(-extent.y, extent.y);
+      position_z_[i] = position_.z + random(-extent.z, extent.z);
+      velocity_x_[i] = random(settings_.velocity_min.x, settings_.velocity_max.x);
+      velocity_y_[i] = random(settings_.velocity_min.y, settings_.velocity_max.y);
+      velocity_z_[i] = random(settings_.velocity_min.z, settings_.velocity_max.z);
+      age_[i] = 0.0f;
+      lifetime_[i] = random(settings_.lifetime_min, settings_.lifetime_max);
+    }
+
+    count_ = last;
+  }
+
+
+  void ParticleEmitter::writeInstances(size_t begin, size_t end, float *out) const
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      float *instance = out + i * INSTANCE_FLOATS;
+      instance[0] = position_x_[i];
+      instance[1] = position_y_[i];
+      instance[2] = position_z_[i];
+      instance[3] = age_[i] / lifetime_[i];
+    }
+  }
+
+
+  float ParticleEmitter::random(float min, float max)
+  {
+    // xorshift, plenty for effects and each emitter keeps its own state so jobs never share one
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 17;
+    random_state_ ^= random_state_ << 5;
+    return min + (max - min) * ((random_state_ >> 8) * (1.0f / 16777216.0f));
+  }
+
+
+  void ParticleSystem::buildJobs()
+  {
+    VV_MEMORY_SCOPE(MEMORY_SCENE);
+
+    jobs_.clear();
+    for (auto emitter : emitters_)
+    {
+      for (size_t begin = 0; begin < emitter->count_; begin += JOB_SIZE)
+      {
+        SimulationJob job;
+        job.emitter = emitter;
+        job.begin = begin;
+        job.end = std::min(begin + JOB_SIZE, emitter->count_);
+        jobs_.push_back(job);
+      }
+    }
+  }
+
+
+  void ParticleSystem::upload()
+  {
+    double start_time = Time::current();
+
+    size_t total = 0;
+    for (auto emitter : emitters_)
+    {
+      emitter->stream_offset_ = total;
+      total += emitter->count_;
+    }
+
+    stats_.particles = total;
+    if (total == 0) return;
+
+    GLStateCache *cache = GLStateCache::instance();
+    cache->bindBuffer(GL_ARRAY_BUFFER, stream_buffer_);
+
+    // the buffer only grows, invalidating on map hands us fresh storage every frame
+    // instead of waiting for the gpu to finish drawing from the old one
+    if (total > stream_capacity_)
+    {
+      stream_capacity_ = std::max(total, stream_capacity_ * 2);
+      glBufferData(GL_ARRAY_BUFFER, stream_capacity_ * INSTANCE_FLOATS * sizeof(float), nullptr, GL_STREAM_DRAW);
+      cache->countApiCalls();
+    }
+
+    float *stream = (float *)glMapBufferRange(GL_ARRAY_BUFFER, 0, total * INSTANCE_FLOATS * sizeof(float),
+                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    cache->countApiCalls(2);
+    if (!stream)
+    {
+      std::cerr << "ERROR: Failed to map the particle stream buffer.\n";
+      stats_.particles = 0; // nothing was written, skip drawing this frame
+      return;
+    }
+
+    buildJobs();
+    ThreadPool::instance()->parallelFor(jobs_.size(), 1, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+      {
+        const SimulationJob &job = jobs_[i];
+        job.emitter->writeInstances(job.begin, job.end, stream + job.emitter->stream_offset_ * INSTANCE_FLOATS);
+      }
+    });
+
+    if (!glUnmapBuffer(GL_ARRAY_BUFFER))
+      stats_.particles = 0; // storage got corrupted, skip drawing this frame
+
+    stats_.upload_time = Time::current() - start_time;
+  }
+} // namespace vv
\ No newline at end of file
@@ -1,7 +1,9 @@
 
 #include <iostream>
 
+#include "vv/GLStateCache.h"
 #include "vv/RenderContex.h"
+#include "vv/Settings.h"
 
 namespace vv
 {
@@ -24,14 +26,26 @@ namespace vv
       return false;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-    glfwWindowHint(GLFW_SAMPLES, 4);
 
-    window_ = glfwCreateWindow(width, height, "Virtual Vista", nullptr, nullptr);
+    // scaled frames are blitted onto the window, which only works if it isn't multisampled,
+    // dynamic resolution does its msaa offscreen instead
+    float min_scale, max_scale;
+    double target_frame_time;
+    bool dynamic_resolution = Settings::instance()->getDynamicResolution(min_scale, max_scale, target_frame_time);
+    glfwWindowHint(GLFW_SAMPLES, dynamic_resolution ? 0 : Settings::instance()->getMultisamples());
+
+    // the gpu driven path needs 4.3, anything that can't give us that still gets 3.3
+    static const int CONTEXT_VERSIONS[][2] = { { 4, 3 }, { 3, 3 } };
+    window_ = nullptr;
+    for (int i = Settings::instance()->getGpuCulling() ? 0 : 1; i < 2 && !window_; ++i)
+    {
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, CONTEXT_VERSIONS[i][0]);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, CONTEXT_VERSIONS[i][1]);
+      window_ = glfwCreateWindow(width, height, "Virtual Vista", nullptr, nullptr);
+    }
 
     glfwMakeContextCurrent(window_);
     glfwSetInputMode(window_, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -50,6 +64,10 @@ namespace vv
       return false;
     }
 
+    // fresh context, nothing the state cache could have seen is valid anymore
+    GLStateCache::instance()->invalidate();
+    GLStateCache::instance()->setViewport(x, y, width, height);
+
     return true;
   }
 
@@ -0,0 +1,234 @@
+
+#include <cstring>
+
+#include "vv/MemoryTracker.h"
+#include "vv/RenderQueue.h"
+#include "vv/Time.h"
+
+namespace vv
+{
+  /////////////////////////////////////////////////////////////////////// public
+  CommandBuffer::CommandBuffer()
+  {
+  }
+
+
+  void CommandBuffer::bindMaterial(SortKey key, uint32_t shader, uint32_t material)
+  {
+    RenderCommand &command = push(key, COMMAND_BIND_MATERIAL);
+    command.bind_material.shader = shader;
+    command.bind_material.material = material;
+  }
+
+
+  void CommandBuffer::setUniform(SortKey key, uint32_t uniform, int value)
+  {
+    RenderCommand &command = push(key, COMMAND_SET_UNIFORM);
+    command.set_uniform.uniform = uniform;
+    command.set_uniform.type = UNIFORM_INT;
+    std::memcpy(command.set_uniform.data, &value, sizeof(value));
+  }
+
+
+  void CommandBuffer::setUniform(SortKey key, uint32_t uniform, float value)
+  {
+    RenderCommand &command = push(key, COMMAND_SET_UNIFORM);
+    command.set_uniform.uniform = uniform;
+    command.set_uniform.type = UNIFORM_FLOAT;
+    command.set_uniform.data[0] = value;
+  }
+
+
+  void CommandBuffer::setUniform(SortKey key, uint32_t uniform, const glm::vec3 &value)
+  {
+    RenderCommand &command = push(key, COMMAND_SET_UNIFORM);
+    command.set_uniform.uniform = uniform;
+    command.set_uniform.type = UNIFORM_VEC3;
+    for (int i = 0; i < 3; ++i)
+      command.set_uniform.data[i] = value[i];
+  }
+
+
+  void CommandBuffer::setUniform(SortKey key, uint32_t uniform, const glm::vec4 &value)
+  {
+    RenderCommand &command = push(key, COMMAND_SET_UNIFORM);
+    command.set_uniform.uniform = uniform;
+    command.set_uniform.type = UNIFORM_VEC4;
+    for (int i = 0; i < 4; ++i)
+      command.set_uniform.data[i] = value[i];
+  }
+
+
+  void CommandBuffer::setUniform(SortKey key, uint32_t uniform, const glm::mat4 &value)
+  {
+    RenderCommand &command = push(key, COMMAND_SET_UNIFORM);
+    command.set_uniform.uniform = uniform;
+    command.set_uniform.type = UNIFORM_MAT4;
+    for (int column = 0; column < 4; ++column)
+      for (int row = 0; row < 4; ++row)
+        command.set_uniform.data[column * 4 + row] = value[column][row];
+  }
+
+
+  void CommandBuffer::draw(SortKey key, uint32_t mesh, uint32_t instance_count,
+                           uint32_t first_index, uint32_t index_count)
+  {
+    RenderCommand &command = push(key, COMMAND_DRAW);
+    command.draw.mesh = mesh;
+    command.draw.first_index = first_index;
+    command.draw.index_count = index_count;
+    command.draw.instance_count = instance_count;
+  }
+
+
+  void CommandBuffer::clear()
+  {
+    commands_.clear();
+  }
+
+
+  size_t CommandBuffer::size() const
+  {
+    return commands_.size();
+  }
+
+
+  const RenderCommand& CommandBuffer::operator[](size_t i) const
+  {
+    return commands_[i];
+  }
+
+
+  RenderQueue::RenderQueue(size_t buffer_count) :
+    buffers_(buffer_count > 0 ? buffer_count : 1)
+  {
+    stats_ = RenderQueueStats();
+  }
+
+
+  RenderQueue::~RenderQueue()
+  {
+  }
+
+
+  size_t RenderQueue::getBufferCount() const
+  {
+    return buffers_.size();
+  }
+
+
+  CommandBuffer& RenderQueue::getBuffer(size_t i)
+  {
+    return buffers_[i];
+  }
+
+
+  void RenderQueue::sort()
+  {
+    VV_MEMORY_SCOPE(MEMORY_RENDERING);
+    double start_time = Time::current();
+
+    keys_.clear();
+    order_.clear();
+    stats_.draws = 0;
+
+    for (size_t b = 0; b < buffers_.size(); ++b)
+    {
+      const CommandBuffer &buffer = buffers_[b];
+      for (size_t c = 0; c < buffer.size(); ++c)
+      {
+        keys_.push_back(buffer[c].key);
+        order_.push_back(((uint32_t)b << INDEX_BUFFER_SHIFT) | (uint32_t)c);
+
+        if (buffer[c].type == COMMAND_DRAW)
+          stats_.draws++;
+      }
+    }
+
+    radixSort();
+
+    stats_.commands = keys_.size();
+    stats_.sort_time = Time::current() - start_time;
+  }
+
+
+  void RenderQueue::submit(RenderBackend &backend)
+  {
+    double start_time = Time::current();
+
+    backend.beginSubmit();
+    for (auto index : order_)
+      backend.execute(buffers_[index >> INDEX_BUFFER_SHIFT][index & INDEX_COMMAND_MASK]);
+    backend.endSubmit();
+
+    stats_.submit_time = Time::current() - start_time;
+  }
+
+
+  void RenderQueue::reset()
+  {
+    for (auto &buffer : buffers_)
+      buffer.clear();
+
+    keys_.clear();
+    order_.clear();
+  }
+
+
+  const RenderQueueStats& RenderQueue::getStats() const
+  {
+    return stats_;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  RenderCommand& CommandBuffer::push(SortKey key, RenderCommandType type)
+  {
+    VV_MEMORY_SCOPE(MEMORY_RENDERING);
+    commands_.push_back(RenderCommand());
+    RenderCommand &command = commands_.back();
+    std::memset(&command, 0, sizeof(RenderCommand));
+    command.key = key;
+    command.type = type;
+    return command;
+  }
+
+
+  void RenderQueue::radixSort()
+  {
+    const size_t count = keys_.size();
+    if (count < 2) return;
+
+    scratch_keys_.resize(count);
+    scratch_order_.resize(count);
+
+    // lsd radix over 8 bit digits, every pass is stable
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+      size_t histogram[256] = { 0 };
+      for (size_t i = 0; i < count; ++i)
+        histogram[(keys_[i] >> shift) & 0xff]++;
+
+      // keys that share this digit would just be copied over unchanged
+      if (histogram[(keys_[0] >> shift) & 0xff] == count) continue;
+
+      size_t offset = 0;
+      for (int digit = 0; digit < 256; ++digit)
+      {
+        size_t digit_count = histogram[digit];
+        histogram[digit] = offset;
+        offset += digit_count;
+      }
+
+      for (size_t i = 0; i < count; ++i)
+      {
+        size_t destination = histogram[(keys_[i] >> shift) & 0xff]++;
+        scratch_keys_[destination] = keys_[i];
+        scratch_order_[destination] = order_[i];
+      }
+
+      keys_.swap(scratch_keys_);
+      order_.swap(scratch_order_);
+    }
+  }
+} // namespace vv
\ No newline at end of file
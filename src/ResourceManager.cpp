@@ -1,4 +1,5 @@
 
+#include "vv/MemoryTracker.h"
 #include "vv/ResourceManager.h"
 #include "vv/VirtualVista.h"
 
@@ -19,6 +20,7 @@ namespace vv
   Handle ResourceManager::addShader(std::string path, std::string name)
   {
     if (path.empty() || name.empty()) return "";
+    VV_MEMORY_SCOPE(MEMORY_RESOURCES);
 
     // if shader already exists, return it's handle
     if (shader_buffer_[path + name])
@@ -58,18 +60,175 @@ namespace vv
     }
   }
 
+
+  ShaderVariantCache* ResourceManager::addShaderVariants(std::string path, std::string name)
+  {
+    if (path.empty() || name.empty()) return nullptr;
+    VV_MEMORY_SCOPE(MEMORY_RESOURCES);
+
+    ShaderVariantCache *&variants = shader_variant_buffer_[path + name];
+    if (variants)
+      return variants;
+
+    variants = new ShaderVariantCache(path, name);
+    if (!variants->init())
+    {
+      SAFE_DELETE(variants);
+      shader_variant_buffer_.erase(path + name);
+      return nullptr;
+    }
+
+    return variants;
+  }
+
   
   bool ResourceManager::loadMeshFromFile(std::string path, std::string name)
   {
+    if (path.empty() || name.empty()) return false;
+    VV_MEMORY_SCOPE(MEMORY_RESOURCES);
+
+    Mesh *&mesh = mesh_buffer_[path + name];
+    if (!mesh)
+    {
+      mesh = new Mesh(path, name);
+      if (!mesh->init() || !mesh->upload())
+      {
+        SAFE_DELETE(mesh);
+        mesh_buffer_.erase(path + name);
+        return false;
+      }
+    }
+
+    mesh->use_count_++;
     return true;
   }
 
 
   bool ResourceManager::loadTextureFromFile(std::string path, std::string name)
   {
+    if (path.empty() || name.empty()) return false;
+    VV_MEMORY_SCOPE(MEMORY_RESOURCES);
+
+    Texture *&texture = texture_buffer_[path + name];
+    if (!texture)
+    {
+      texture = new Texture(path, name);
+      if (!texture->init())
+      {
+        SAFE_DELETE(texture);
+        texture_buffer_.erase(path + name);
+        return false;
+      }
+    }
+
+    texture->use_count_++;
+    return true;
+  }
+
+
+  bool ResourceManager::addMesh(Mesh *mesh)
+  {
+    if (!mesh) return false;
+    VV_MEMORY_SCOPE(MEMORY_RESOURCES);
+
+    auto loaded = mesh_buffer_.find(mesh->handle_);
+    if (loaded != mesh_buffer_.end())
+    {
+      SAFE_DELETE(mesh);
+      loaded->second->use_count_++;
+      return true;
+    }
+
+    if (!mesh->upload())
+    {
+      SAFE_DELETE(mesh);
+      return false;
+    }
+
+    mesh->use_count_++;
+    mesh_buffer_[mesh->handle_] = mesh;
+    return true;
+  }
+
+
+  bool ResourceManager::addTexture(Texture *texture)
+  {
+    if (!texture) return false;
+    VV_MEMORY_SCOPE(MEMORY_RESOURCES);
+
+    auto loaded = texture_buffer_.find(texture->handle_);
+    if (loaded != texture_buffer_.end())
+    {
+      SAFE_DELETE(texture);
+      loaded->second->use_count_++;
+      return true;
+    }
+
+    texture->use_count_++;
+    texture_buffer_[texture->handle_] = texture;
+    return true;
+  }
+
+
+  bool ResourceManager::useMesh(const Handle &handle)
+  {
+    auto mesh = mesh_buffer_.find(handle);
+    if (mesh == mesh_buffer_.end()) return false;
+
+    mesh->second->use_count_++;
+    return true;
+  }
+
+
+  bool ResourceManager::useTexture(const Handle &handle)
+  {
+    auto texture = texture_buffer_.find(handle);
+    if (texture == texture_buffer_.end()) return false;
+
+    texture->second->use_count_++;
     return true;
   }
 
+
+  void ResourceManager::unloadMesh(const Handle &handle)
+  {
+    auto mesh = mesh_buffer_.find(handle);
+    if (mesh == mesh_buffer_.end()) return;
+
+    if (--mesh->second->use_count_ == 0)
+    {
+      SAFE_DELETE(mesh->second);
+      mesh_buffer_.erase(mesh);
+    }
+  }
+
+
+  void ResourceManager::unloadTexture(const Handle &handle)
+  {
+    auto texture = texture_buffer_.find(handle);
+    if (texture == texture_buffer_.end()) return;
+
+    if (--texture->second->use_count_ == 0)
+    {
+      SAFE_DELETE(texture->second);
+      texture_buffer_.erase(texture);
+    }
+  }
+
+
+  Mesh* ResourceManager::getMesh(const Handle &handle)
+  {
+    auto mesh = mesh_buffer_.find(handle);
+    return (mesh != mesh_buffer_.end()) ? mesh->second : nullptr;
+  }
+
+
+  Texture* ResourceManager::getTexture(const Handle &handle)
+  {
+    auto texture = texture_buffer_.find(handle);
+    return (texture != texture_buffer_.end()) ? texture->second : nullptr;
+  }
+
   
   void ResourceManager::clearResources()
   {
@@ -78,6 +237,21 @@ namespace vv
       SAFE_DELETE(s.second);
 
     shader_buffer_.clear();
+
+    for (auto v : shader_variant_buffer_)
+      SAFE_DELETE(v.second);
+
+    shader_variant_buffer_.clear();
+
+    for (auto m : mesh_buffer_)
+      SAFE_DELETE(m.second);
+
+    mesh_buffer_.clear();
+
+    for (auto t : texture_buffer_)
+      SAFE_DELETE(t.second);
+
+    texture_buffer_.clear();
   }
   ////////////////////////////////////////////////////////////////////// private
 } // namespace vv
\ No newline at end of file
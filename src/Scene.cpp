@@ -1,21 +1,293 @@
 
+#include <algorithm>
+
+#include "vv/Frustum.h"
 #include "vv/Scene.h"
+#include "vv/ThreadPool.h"
+#include "vv/Time.h"
+#include "vv/VirtualVista.h"
 
 namespace vv
 {
   /////////////////////////////////////////////////////////////////////// public
-  Scene::Scene() :
-    currently_used_(false)
+  Scene::Scene(ResourceManager *resource_manager) :
+    currently_used_(false),
+    resource_manager_(resource_manager),
+    streamer_(nullptr),
+    texture_streamer_(nullptr),
+    occlusion_culler_(nullptr)
   {
+    animation_system_ = new AnimationSystem;
+    particle_system_ = new ParticleSystem;
+    spatial_tree_ = new AABBTree;
   }
 
 
   Scene::~Scene()
   {
+    SAFE_DELETE(streamer_);
+    SAFE_DELETE(texture_streamer_);
+    SAFE_DELETE(animation_system_);
+    SAFE_DELETE(particle_system_);
+    SAFE_DELETE(occlusion_culler_);
+    SAFE_DELETE(spatial_tree_);
+  }
+
+
+  bool Scene::enableStreaming(std::string cell_directory, const StreamingSettings &settings)
+  {
+    SAFE_DELETE(streamer_);
+
+    streamer_ = new WorldStreamer(resource_manager_, cell_directory, settings);
+    if (!streamer_->init())
+    {
+      SAFE_DELETE(streamer_);
+      return false;
+    }
+
+    return true;
+  }
+
+
+  WorldStreamer* Scene::getStreamer()
+  {
+    return streamer_;
+  }
+
+
+  bool Scene::enableTextureStreaming(const TextureStreamingSettings &settings)
+  {
+    SAFE_DELETE(texture_streamer_);
+
+    texture_streamer_ = new TextureStreamer(settings);
+    if (!texture_streamer_->init())
+    {
+      SAFE_DELETE(texture_streamer_);
+      return false;
+    }
+
+    return true;
   }
 
 
+  TextureStreamer* Scene::getTextureStreamer()
+  {
+    return texture_streamer_;
+  }
+
+
+  AnimationSystem* Scene::getAnimationSystem()
+  {
+    return animation_system_;
+  }
+
+
+  ParticleSystem* Scene::getParticleSystem()
+  {
+    return particle_system_;
+  }
+
+
+  bool Scene::enableOcclusionCulling(int width, int height)
+  {
+    SAFE_DELETE(occlusion_culler_);
+
+    occlusion_culler_ = new OcclusionCuller;
+    if (!occlusion_culler_->init(width, height))
+    {
+      SAFE_DELETE(occlusion_culler_);
+      return false;
+    }
+
+    return true;
+  }
+
+
+  OcclusionCuller* Scene::getOcclusionCuller()
+  {
+    return occlusion_culler_;
+  }
+
+
+  void Scene::addOccluder(Entity *entity, const glm::vec3 *positions, const unsigned int *indices,
+                          size_t index_count)
+  {
+    if (!entity || !positions || !indices || index_count < 3) return;
+
+    SceneOccluder occluder = { entity, positions, indices, index_count };
+    occluders_.push_back(occluder);
+  }
+
+
+  void Scene::update(glm::vec3 camera_position, const glm::mat4 &view_projection)
+  {
+    if (streamer_)
+      streamer_->update(camera_position);
+
+    // acts on the feedback reported while the previous frame was recorded
+    if (texture_streamer_)
+      texture_streamer_->update();
+
+    refitSpatialTree();
+    cullEntities(view_projection);
+
+    // palettes are sampled on the workers, the upload stays on the context thread
+    float delta_time = (float)(Time::delta() / MILLISECOND);
+    animation_system_->update(delta_time);
+    animation_system_->upload();
+    particle_system_->update(delta_time);
+  }
+
+
+  void Scene::addEntity(Entity *entity)
+  {
+    if (!entity || !entities_.insert(entity).second) return;
+
+    proxies_[entity] = spatial_tree_->createProxy(spatialBounds(entity), entity);
+    entity->getTransform()->clearDirty();
+  }
+
+
+  void Scene::removeEntity(Entity *entity)
+  {
+    if (!entities_.erase(entity)) return;
+
+    auto proxy = proxies_.find(entity);
+    spatial_tree_->destroyProxy(proxy->second);
+    proxies_.erase(proxy);
+
+    for (size_t i = 0; i < occluders_.size();)
+    {
+      if (occluders_[i].entity == entity)
+        occluders_.erase(occluders_.begin() + i);
+      else
+        ++i;
+    }
+  }
+
+
+  const std::set<Entity *>& Scene::getEntities() const
+  {
+    return entities_;
+  }
+
+
+  Entity* Scene::pick(const Ray &ray, float *distance) const
+  {
+    RayHit hit;
+    if (!spatial_tree_->raycast(ray, hit)) return nullptr;
+
+    if (distance) *distance = hit.distance;
+    return (Entity *)hit.user_data;
+  }
+
+
+  void Scene::queryOverlap(const AABB &bounds, std::vector<Entity *> &entities) const
+  {
+    std::vector<int> proxies;
+    spatial_tree_->overlap(bounds, proxies);
+
+    for (auto proxy : proxies)
+      entities.push_back((Entity *)spatial_tree_->getUserData(proxy));
+  }
+
+
+  const AABBTree* Scene::getSpatialTree() const
+  {
+    return spatial_tree_;
+  }
+
+
+  void Scene::recordCommands(RenderQueue &queue, glm::vec3 camera_position, const glm::mat4 &projection,
+                             int viewport_height)
+  {
+    renderable_.clear();
+    for (auto entity : entities_)
+      if (entity->isRenderable())
+        renderable_.push_back(entity);
+
+    // read by the next update(), only what is actually recorded keeps its finer mips
+    if (texture_streamer_)
+      texture_streamer_->beginFeedback(camera_position, projection, viewport_height);
+
+    // one contiguous slice per buffer keeps the recording order deterministic
+    const size_t buffer_count = queue.getBufferCount();
+    const size_t slice = (renderable_.size() + buffer_count - 1) / buffer_count;
+
+    ThreadPool::instance()->parallelFor(buffer_count, 1, [&](size_t begin, size_t end)
+    {
+      for (size_t b = begin; b < end; ++b)
+      {
+        CommandBuffer &buffer = queue.getBuffer(b);
+        size_t last = std::min(renderable_.size(), (b + 1) * slice);
+        for (size_t i = b * slice; i < last; ++i)
+        {
+          renderable_[i]->record(buffer, camera_position);
+
+          if (!texture_streamer_) continue;
+          for (auto &use : renderable_[i]->getStreamedTextures())
+            texture_streamer_->addUse(use.texture, renderable_[i], use.uv_density);
+        }
+      }
+    });
+  }
+
 
   ////////////////////////////////////////////////////////////////////// private
+  AABB Scene::spatialBounds(Entity *entity)
+  {
+    // entities without geometry still take part in queries as a point
+    if (entity->getBounds().isValid())
+      return entity->getWorldBounds();
 
+    glm::vec3 position = entity->getTransform()->getPosition();
+    return AABB(position, position);
+  }
+
+
+  void Scene::refitSpatialTree()
+  {
+    // most moves stay inside the fat box and never touch the tree
+    for (auto &proxy : proxies_)
+    {
+      Transform *transform = proxy.first->getTransform();
+      if (!transform->isDirty()) continue;
+
+      const AABB &previous = spatial_tree_->getBounds(proxy.second);
+      AABB bounds = spatialBounds(proxy.first);
+      spatial_tree_->moveProxy(proxy.second, bounds, bounds.min - previous.min);
+      transform->clearDirty();
+    }
+  }
+
+
+  void Scene::cullEntities(const glm::mat4 &view_projection)
+  {
+    // occlusion starts over every frame, so an occluder is never hidden by last frame's result
+    Frustum frustum(view_projection);
+    for (auto entity : entities_)
+    {
+      entity->setVisiblity(entity->getBounds().isValid() && frustum.intersects(entity->getWorldBounds()));
+      entity->setOccluded(false);
+    }
+
+    size_t active_occluders = 0;
+    if (occlusion_culler_)
+    {
+      occlusion_culler_->beginFrame(view_projection);
+      for (auto &occluder : occluders_)
+      {
+        if (!occluder.entity->isRenderable()) continue;
+        occlusion_culler_->addOccluder(occluder.positions, occluder.indices, occluder.index_count,
+                                       occluder.entity->getTransform()->getMatrix());
+        active_occluders++;
+      }
+    }
+
+    // nothing on screen could hide anything
+    if (active_occluders == 0) return;
+
+    occlusion_culler_->rasterizeOccluders();
+    occlusion_culler_->cull(entities_);
+  }
 } // namespace vv
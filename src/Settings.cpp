@@ -0,0 +1,197 @@
+
+#include "vv/Settings.h"
+
+namespace vv
+{
+  Settings* Settings::instance_ = nullptr;
+
+  /////////////////////////////////////////////////////////////////////// public
+  Settings* Settings::instance()
+  {
+    if (!instance_)
+      instance_ = new Settings;
+
+    return instance_;
+  }
+
+
+  void Settings::setDefault()
+  {
+    default_ = true;
+
+    window_resize_ = false;
+    camera_type_ = PERSPECTIVE;
+
+    start_x_ = 0;
+    start_y_ = 0;
+    window_width_ = 640;
+    window_height_ = 480;
+
+    field_of_view_ = 45.0f;
+    aspect_ratio_ = (float)window_width_ / (float)window_height_;
+    near_clip_ = 0.1f;
+    far_clip_ = 100.0f;
+
+    shader_location_ = std::string(PROJECT_SOURCE_DIR) + "/src/shaders/";
+    assets_location_ = std::string(PROJECT_SOURCE_DIR) + "/assets/";
+
+    movement_speed_ = 1.0;
+    rotation_speed_ = 1.0;
+
+    max_lights_in_scene_ = 16;
+    multisamples_ = 4;
+
+    dynamic_resolution_ = false;
+    min_resolution_scale_ = 0.5f;
+    max_resolution_scale_ = 1.0f;
+    target_frame_time_ = 1000.0 / 60.0;
+
+    fast_obj_import_ = true;
+    gpu_culling_ = false;
+  }
+
+
+  void Settings::setViewport(const int start_x,
+                             const int start_y,
+                             const int width,
+                             const int height)
+  {
+    default_ = false;
+    start_x_ = start_x;
+    start_y_ = start_y;
+    window_width_ = width;
+    window_height_ = height;
+    aspect_ratio_ = (float)width / (float)height;
+  }
+
+
+  void Settings::setFieldOfView(const float fov)
+  {
+    default_ = false;
+    field_of_view_ = fov;
+  }
+
+
+  void Settings::setMultisamples(const int samples)
+  {
+    default_ = false;
+    multisamples_ = (samples > 1) ? samples : 0;
+  }
+
+
+  void Settings::setClipDistance(const float near, const float far)
+  {
+    default_ = false;
+    near_clip_ = near;
+    far_clip_ = far;
+  }
+
+
+  void Settings::setDynamicResolution(const bool enabled,
+                                      const float min_scale,
+                                      const float max_scale,
+                                      const double target_frame_time)
+  {
+    default_ = false;
+    dynamic_resolution_ = enabled;
+    min_resolution_scale_ = (min_scale < max_scale) ? min_scale : max_scale;
+    max_resolution_scale_ = (min_scale < max_scale) ? max_scale : min_scale;
+    target_frame_time_ = target_frame_time;
+  }
+
+
+  void Settings::setFastObjImport(const bool enabled)
+  {
+    default_ = false;
+    fast_obj_import_ = enabled;
+  }
+
+
+  void Settings::setGpuCulling(const bool enabled)
+  {
+    default_ = false;
+    gpu_culling_ = enabled;
+  }
+
+
+  std::string Settings::getShaderLocation() const
+  {
+    return shader_location_;
+  }
+
+
+  std::string Settings::getAssetsLocation() const
+  {
+    return assets_location_;
+  }
+
+
+  float Settings::getCameraType() const
+  {
+    return camera_type_;
+  }
+
+
+  void Settings::getViewport(int &x, int &y, int &width, int &height) const
+  {
+    x = start_x_;
+    y = start_y_;
+    width = window_width_;
+    height = window_height_;
+  }
+
+
+  void Settings::getPerspective(float &fov, float &aspect, float &near, float &far) const
+  {
+    fov = field_of_view_;
+    aspect = aspect_ratio_;
+    near = near_clip_;
+    far = far_clip_;
+  }
+
+
+  double Settings::getMovementSpeed() const
+  {
+    return movement_speed_;
+  }
+
+
+  double Settings::getRotationSpeed() const
+  {
+    return rotation_speed_;
+  }
+
+
+  int Settings::getMultisamples() const
+  {
+    return multisamples_;
+  }
+
+
+  bool Settings::getDynamicResolution(float &min_scale, float &max_scale, double &target_frame_time) const
+  {
+    min_scale = min_resolution_scale_;
+    max_scale = max_resolution_scale_;
+    target_frame_time = target_frame_time_;
+    return dynamic_resolution_;
+  }
+
+
+  bool Settings::getFastObjImport() const
+  {
+    return fast_obj_import_;
+  }
+
+
+  bool Settings::getGpuCulling() const
+  {
+    return gpu_culling_;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  Settings::Settings()
+  {
+    setDefault();
+  }
+} // namespace vv
\ No newline at end of file
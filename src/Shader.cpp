@@ -3,30 +3,38 @@
 #include <fstream>
 #include <sstream>
 
+#include "vv/GLStateCache.h"
 #include "vv/Shader.h"
 
 namespace vv
 {
   /////////////////////////////////////////////////////////////////////// public
   Shader::Shader(std::string path, std::string name) :
-    Resource(path, name)
+    Resource(path, name),
+    program_id_(0)
   {
   }
 
 
   Shader::~Shader()
   {
+    GLStateCache::instance()->onDeleteProgram(program_id_);
     glDeleteProgram(program_id_);
   }
 
 
   bool Shader::init()
   {
-    program_id_ = glCreateProgram();
-
     std::string vert_source = loadShaderFromFile(file_path_ + file_name_ + ".vert");
     std::string frag_source = loadShaderFromFile(file_path_ + file_name_ + ".frag");
 
+    return initFromSource(vert_source, frag_source);
+  }
+
+
+  bool Shader::initFromSource(const std::string &vert_source, const std::string &frag_source)
+  {
+    program_id_ = glCreateProgram();
     return createProgram(vert_source, frag_source);
   }
 
@@ -51,11 +59,10 @@ namespace vv
 
   void Shader::useProgram()
   {
-    glUseProgram(program_id_);
+    GLStateCache::instance()->useProgram(program_id_);
   }
 
 
-  ////////////////////////////////////////////////////////////////////// private
   std::string Shader::loadShaderFromFile(const std::string filename)
   {
     std::ifstream file(filename);
@@ -78,6 +85,7 @@ namespace vv
   }
 
 
+  ////////////////////////////////////////////////////////////////////// private
   bool Shader::createProgram(std::string vert_source, std::string frag_source)
   {
     GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
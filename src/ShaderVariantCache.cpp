@@ -0,0 +1,243 @@
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include "vv/ShaderVariantCache.h"
+#include "vv/VirtualVista.h"
+
+namespace vv
+{
+  struct ShaderFeature
+  {
+    const char *name;   /* as written in the features declaration */
+    ShaderKey flag;
+    const char *define; /* as seen by the glsl preprocessor */
+  };
+
+  static const ShaderFeature SHADER_FEATURES[] =
+  {
+    { "NORMAL_MAPPING", SHADER_FEATURE_NORMAL_MAPPING, "VV_NORMAL_MAPPING" },
+    { "ALPHA_TEST",     SHADER_FEATURE_ALPHA_TEST,     "VV_ALPHA_TEST" },
+    { "INSTANCING",     SHADER_FEATURE_INSTANCING,     "VV_INSTANCING" },
+    { "TEXTURE_ARRAY",  SHADER_FEATURE_TEXTURE_ARRAY,  "VV_TEXTURE_ARRAY" },
+    { "SKINNING",       SHADER_FEATURE_SKINNING,       "VV_SKINNING" },
+    { "INDIRECT",       SHADER_FEATURE_INDIRECT,       "VV_INDIRECT" }
+  };
+
+  static const int LIGHT_BUCKETS[] = { 1, 2, 4, 8, 16, 32 };
+  static const int LIGHT_BUCKET_COUNT = sizeof(LIGHT_BUCKETS) / sizeof(LIGHT_BUCKETS[0]);
+
+  /////////////////////////////////////////////////////////////////////// public
+  ShaderVariantCache::ShaderVariantCache(std::string path, std::string name) :
+    path_(path),
+    name_(name),
+    declares_light_count_(false),
+    declared_features_(0)
+  {
+  }
+
+
+  ShaderVariantCache::~ShaderVariantCache()
+  {
+    for (auto v : variants_)
+      SAFE_DELETE(v.second);
+  }
+
+
+  bool ShaderVariantCache::init()
+  {
+    vert_source_ = Shader::loadShaderFromFile(path_ + name_ + ".vert");
+    frag_source_ = Shader::loadShaderFromFile(path_ + name_ + ".frag");
+
+    if (vert_source_.empty() || frag_source_.empty())
+    {
+      std::cerr << "ERROR: shader sources for variants of " << path_ + name_ << " are empty.\n";
+      return false;
+    }
+
+    parseDeclarations(vert_source_);
+    parseDeclarations(frag_source_);
+    return true;
+  }
+
+
+  Shader* ShaderVariantCache::getVariant(ShaderKey key)
+  {
+    key = sanitize(key);
+
+    auto cached = variants_.find(key);
+    if (cached != variants_.end())
+      return cached->second;
+
+    if (failed_variants_.count(key))
+      return nullptr;
+
+    std::string defines = buildDefines(key);
+    Shader *shader = new Shader(path_, name_);
+    if (!shader->initFromSource(injectDefines(vert_source_, defines), injectDefines(frag_source_, defines)))
+    {
+      std::cerr << "ERROR: failed to build variant " << key << " of shader " << path_ + name_ << "\n";
+      SAFE_DELETE(shader);
+      failed_variants_.insert(key);
+      return nullptr;
+    }
+
+    variants_[key] = shader;
+    return shader;
+  }
+
+
+  size_t ShaderVariantCache::prebuild(const std::vector<ShaderKey> &keys)
+  {
+    size_t built = 0;
+    for (auto key : keys)
+      if (getVariant(key))
+        built++;
+
+    return built;
+  }
+
+
+  std::vector<ShaderKey> ShaderVariantCache::getAllKeys() const
+  {
+    std::vector<ShaderKey> feature_sets(1, 0);
+    for (auto &feature : SHADER_FEATURES)
+    {
+      if (!(declared_features_ & feature.flag)) continue;
+
+      size_t count = feature_sets.size();
+      for (size_t i = 0; i < count; ++i)
+        feature_sets.push_back(feature_sets[i] | feature.flag);
+    }
+
+    std::vector<ShaderKey> keys;
+    for (auto features : feature_sets)
+    {
+      if (!declares_light_count_)
+      {
+        keys.push_back(features);
+        continue;
+      }
+
+      for (int i = 0; i < LIGHT_BUCKET_COUNT; ++i)
+        keys.push_back(makeKey(LIGHT_BUCKETS[i], features));
+    }
+
+    return keys;
+  }
+
+
+  ShaderKey ShaderVariantCache::sanitize(ShaderKey key) const
+  {
+    ShaderKey mask = declared_features_;
+    if (declares_light_count_)
+      mask |= SHADER_LIGHT_BUCKET_MASK;
+
+    return key & mask;
+  }
+
+
+  ShaderKey ShaderVariantCache::getDeclaredFeatures() const
+  {
+    return declared_features_;
+  }
+
+
+  size_t ShaderVariantCache::getVariantCount() const
+  {
+    return variants_.size();
+  }
+
+
+  ShaderKey ShaderVariantCache::makeKey(int light_count, ShaderKey features)
+  {
+    // round up to the next bucket, anything past the last bucket is clamped to it
+    int bucket = 0;
+    while ((bucket < LIGHT_BUCKET_COUNT - 1) && (LIGHT_BUCKETS[bucket] < light_count))
+      bucket++;
+
+    return (features & ~SHADER_LIGHT_BUCKET_MASK) | (ShaderKey)(bucket + 1);
+  }
+
+
+  int ShaderVariantCache::getLightCount(ShaderKey key)
+  {
+    int bucket = (int)(key & SHADER_LIGHT_BUCKET_MASK);
+    if (bucket == 0 || bucket > LIGHT_BUCKET_COUNT) return 0;
+
+    return LIGHT_BUCKETS[bucket - 1];
+  }
+
+
+  std::string ShaderVariantCache::buildDefines(ShaderKey key)
+  {
+    std::stringstream defines;
+
+    int light_count = getLightCount(key);
+    if (light_count > 0)
+      defines << "#define NUM_LIGHTS " << light_count << "\n";
+
+    for (auto &feature : SHADER_FEATURES)
+      if (key & feature.flag)
+        defines << "#define " << feature.define << "\n";
+
+    return defines.str();
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void ShaderVariantCache::parseDeclarations(const std::string &source)
+  {
+    const std::string marker = "//! features:";
+
+    std::istringstream lines(source);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+      size_t start = line.find(marker);
+      if (start == std::string::npos) continue;
+
+      std::istringstream names(line.substr(start + marker.size()));
+      std::string name;
+      while (names >> name)
+      {
+        if (name == "LIGHT_COUNT")
+        {
+          declares_light_count_ = true;
+          continue;
+        }
+
+        auto feature = std::find_if(std::begin(SHADER_FEATURES), std::end(SHADER_FEATURES),
+          [&name](const ShaderFeature &f) { return name == f.name; });
+
+        if (feature == std::end(SHADER_FEATURES))
+          std::cerr << "WARNING: unknown shader feature " << name << " declared in " << path_ + name_ << "\n";
+        else
+          declared_features_ |= feature->flag;
+      }
+    }
+  }
+
+
+  std::string ShaderVariantCache::injectDefines(const std::string &source, const std::string &defines)
+  {
+    if (defines.empty()) return source;
+
+    // #version has to stay the very first statement, so defines go right after it
+    size_t version = source.find("#version");
+    if (version == std::string::npos)
+      return defines + "#line 1\n" + source;
+
+    size_t line_end = source.find('\n', version);
+    if (line_end == std::string::npos)
+      return source + "\n" + defines;
+
+    int next_line = (int)std::count(source.begin(), source.begin() + line_end, '\n') + 2;
+
+    std::stringstream injected;
+    injected << source.substr(0, line_end + 1) << defines << "#line " << next_line << "\n"
+             << source.substr(line_end + 1);
+    return injected.str();
+  }
+} // namespace vv
\ No newline at end of file
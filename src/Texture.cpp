@@ -0,0 +1,436 @@
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <SOIL.h>
+
+#include "vv/GLStateCache.h"
+#include "vv/Texture.h"
+
+namespace vv
+{
+  static const char MIP_CHAIN_MAGIC[4] = { 'V', 'V', 'T', 'X' };
+  static const uint16_t MIP_CHAIN_VERSION = 1;
+
+  /* magic, version, channels, width, height, level count */
+  static const size_t MIP_CHAIN_HEADER_SIZE = 4 + 2 + 2 + 4 + 4 + 4;
+
+  static bool hasExtension(const std::string &file, const char *extension)
+  {
+    size_t length = std::strlen(extension);
+    if (file.size() < length) return false;
+
+    for (size_t i = 0; i < length; ++i)
+      if (std::tolower((unsigned char)file[file.size() - length + i]) != extension[i])
+        return false;
+
+    return true;
+  }
+
+
+  /* Levels are stored coarsest first, so the tail is one read from the start of the data */
+  static void layoutMipChain(int width, int height, int channels, std::vector<MipLevel> &mips)
+  {
+    mips.clear();
+    while (true)
+    {
+      MipLevel level = { width, height, 0, (size_t)width * height * channels };
+      mips.push_back(level);
+      if (width == 1 && height == 1) break;
+
+      width = std::max(1, width / 2);
+      height = std::max(1, height / 2);
+    }
+
+    size_t offset = MIP_CHAIN_HEADER_SIZE;
+    for (size_t i = mips.size(); i-- > 0;)
+    {
+      mips[i].offset = offset;
+      offset += mips[i].size;
+    }
+  }
+
+
+  /* 2x2 box filter, the odd row or column of a non power of two level folds into its neighbour */
+  static void downsample(const std::vector<unsigned char> &source, const MipLevel &source_level,
+                         std::vector<unsigned char> &target, const MipLevel &target_level, int channels)
+  {
+    target.resize(target_level.size);
+    for (int y = 0; y < target_level.height; ++y)
+    {
+      int y0 = std::min(y * 2, source_level.height - 1);
+      int y1 = std::min(y * 2 + 1, source_level.height - 1);
+      for (int x = 0; x < target_level.width; ++x)
+      {
+        int x0 = std::min(x * 2, source_level.width - 1);
+        int x1 = std::min(x * 2 + 1, source_level.width - 1);
+        for (int c = 0; c < channels; ++c)
+        {
+          unsigned int sum = source[((size_t)y0 * source_level.width + x0) * channels + c] +
+                             source[((size_t)y0 * source_level.width + x1) * channels + c] +
+                             source[((size_t)y1 * source_level.width + x0) * channels + c] +
+                             source[((size_t)y1 * source_level.width + x1) * channels + c];
+          target[((size_t)y * target_level.width + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+        }
+      }
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////// public
+  Texture::Texture(std::string path, std::string name) :
+    Resource(path, name),
+    texture_id_(0),
+    width_(0),
+    height_(0),
+    channels_(0),
+    wrap_mode_(GL_REPEAT),
+    tail_level_(0),
+    resident_level_(0)
+  {
+  }
+
+
+  Texture::~Texture()
+  {
+    if (texture_id_)
+    {
+      GLStateCache::instance()->onDeleteTexture(texture_id_);
+      glDeleteTextures(1, &texture_id_);
+    }
+  }
+
+
+  bool Texture::init()
+  {
+    if (hasExtension(file_name_, ".vvtex"))
+      return readMipChain();
+
+    unsigned char *image = SOIL_load_image((file_path_ + file_name_).c_str(), &width_, &height_, &channels_, SOIL_LOAD_AUTO);
+    if (!image)
+    {
+      std::cerr << "ERROR: failed to load texture: " << file_path_ + file_name_ << "\n"
+                << SOIL_last_result() << "\n";
+      return false;
+    }
+
+    pixels_.assign(image, image + width_ * height_ * channels_);
+    SOIL_free_image_data(image);
+    return true;
+  }
+
+
+  void Texture::setWrapMode(GLint wrap)
+  {
+    wrap_mode_ = wrap;
+  }
+
+
+  GLint Texture::getWrapMode() const
+  {
+    return wrap_mode_;
+  }
+
+
+  bool Texture::upload()
+  {
+    if (texture_id_) return true;
+    if (pixels_.empty()) return false;
+    if (isStreamed()) return uploadMipChain();
+
+    GLenum format = getFormat();
+    glGenTextures(1, &texture_id_);
+    GLStateCache::instance()->bindTexture(0, GL_TEXTURE_2D, texture_id_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width_, height_, 0, format, GL_UNSIGNED_BYTE, pixels_.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_mode_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_mode_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return true;
+  }
+
+
+  void Texture::releasePixels()
+  {
+    std::vector<unsigned char>().swap(pixels_);
+  }
+
+
+  bool Texture::saveMipChain(std::string file) const
+  {
+    if (pixels_.empty() || isStreamed())
+    {
+      std::cerr << "ERROR: " << file_path_ + file_name_ << " has no decoded image to build a mip chain from.\n";
+      return false;
+    }
+
+    std::ofstream out(file, std::ios::binary);
+    if (!out.is_open())
+    {
+      std::cerr << "ERROR: could not write mip chain: " << file << "\n";
+      return false;
+    }
+
+    std::vector<MipLevel> mips;
+    layoutMipChain(width_, height_, channels_, mips);
+
+    uint16_t version = MIP_CHAIN_VERSION, channels = (uint16_t)channels_;
+    uint32_t width = width_, height = height_, level_count = (uint32_t)mips.size();
+    out.write(MIP_CHAIN_MAGIC, sizeof(MIP_CHAIN_MAGIC));
+    out.write((const char *)&version, sizeof(version));
+    out.write((const char *)&channels, sizeof(channels));
+    out.write((const char *)&width, sizeof(width));
+    out.write((const char *)&height, sizeof(height));
+    out.write((const char *)&level_count, sizeof(level_count));
+
+    // each level is built from the one above it, then written at its own offset
+    std::vector<unsigned char> level = pixels_, next;
+    for (size_t i = 0; i < mips.size(); ++i)
+    {
+      if (i > 0)
+      {
+        downsample(level, mips[i - 1], next, mips[i], channels_);
+        level.swap(next);
+      }
+
+      out.seekp(mips[i].offset);
+      out.write((const char *)level.data(), mips[i].size);
+    }
+
+    if (!out)
+    {
+      std::cerr << "ERROR: could not write mip chain: " << file << "\n";
+      return false;
+    }
+
+    return true;
+  }
+
+
+  bool Texture::uploadMipLevel(int level, const std::vector<unsigned char> &pixels)
+  {
+    // level is -1 once everything is resident or when the texture isn't streamed at all
+    if (level < 0 || level >= (int)mips_.size()) return false;
+    if (!texture_id_ || level != resident_level_ - 1 || pixels.size() != mips_[level].size)
+      return false;
+
+    GLenum format = getFormat();
+    GLStateCache::instance()->bindTexture(0, GL_TEXTURE_2D, texture_id_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, level, format, mips_[level].width, mips_[level].height, 0,
+                 format, GL_UNSIGNED_BYTE, pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+    resident_level_ = level;
+    return true;
+  }
+
+
+  void Texture::dropMipLevels(int level)
+  {
+    level = std::min(level, tail_level_);
+    if (!texture_id_ || level <= resident_level_) return;
+
+    GLenum format = getFormat();
+    GLStateCache::instance()->bindTexture(0, GL_TEXTURE_2D, texture_id_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+    // levels below the base take no part in completeness, an empty image gives back their storage
+    for (int i = resident_level_; i < level; ++i)
+      glTexImage2D(GL_TEXTURE_2D, i, format, 0, 0, 0, format, GL_UNSIGNED_BYTE, nullptr);
+
+    resident_level_ = level;
+  }
+
+
+  bool Texture::isStreamed() const
+  {
+    return !mips_.empty();
+  }
+
+
+  int Texture::getMipCount() const
+  {
+    return (int)mips_.size();
+  }
+
+
+  int Texture::getTailLevel() const
+  {
+    return tail_level_;
+  }
+
+
+  int Texture::getResidentLevel() const
+  {
+    return resident_level_;
+  }
+
+
+  const MipLevel& Texture::getMipLevel(int level) const
+  {
+    return mips_[level];
+  }
+
+
+  size_t Texture::getResidentSize() const
+  {
+    size_t size = 0;
+    for (size_t i = resident_level_; i < mips_.size(); ++i)
+      size += mips_[i].size;
+
+    return size;
+  }
+
+
+  std::string Texture::getFileName() const
+  {
+    return file_path_ + file_name_;
+  }
+
+
+  Handle Texture::getHandle() const
+  {
+    return handle_;
+  }
+
+
+  GLuint Texture::getTextureId() const
+  {
+    return texture_id_;
+  }
+
+
+  int Texture::getWidth() const
+  {
+    return width_;
+  }
+
+
+  int Texture::getHeight() const
+  {
+    return height_;
+  }
+
+
+  int Texture::getChannels() const
+  {
+    return channels_;
+  }
+
+
+  GLenum Texture::getFormat() const
+  {
+    return formatFromChannels(channels_);
+  }
+
+
+  const std::vector<unsigned char>& Texture::getPixels() const
+  {
+    return pixels_;
+  }
+
+
+  GLenum Texture::formatFromChannels(int channels)
+  {
+    switch (channels)
+    {
+      case 1: return GL_RED;
+      case 2: return GL_RG;
+      case 3: return GL_RGB;
+      default: return GL_RGBA;
+    }
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  bool Texture::readMipChain()
+  {
+    std::ifstream file(file_path_ + file_name_, std::ios::binary);
+    if (!file.is_open())
+    {
+      std::cerr << "ERROR: failed to load texture: " << file_path_ + file_name_ << "\n";
+      return false;
+    }
+
+    char magic[4];
+    uint16_t version = 0, channels = 0;
+    uint32_t width = 0, height = 0, level_count = 0;
+    file.read(magic, sizeof(magic));
+    file.read((char *)&version, sizeof(version));
+    file.read((char *)&channels, sizeof(channels));
+    file.read((char *)&width, sizeof(width));
+    file.read((char *)&height, sizeof(height));
+    file.read((char *)&level_count, sizeof(level_count));
+
+    if (!file || std::memcmp(magic, MIP_CHAIN_MAGIC, sizeof(magic)) != 0 || version != MIP_CHAIN_VERSION ||
+        channels < 1 || channels > 4 || width == 0 || height == 0)
+    {
+      std::cerr << "ERROR: " << file_path_ + file_name_ << " is not a mip chain.\n";
+      return false;
+    }
+
+    layoutMipChain(width, height, channels, mips_);
+    if (mips_.size() != level_count)
+    {
+      std::cerr << "ERROR: " << file_path_ + file_name_ << " has " << level_count << " mip levels, expected "
+                << mips_.size() << ".\n";
+      mips_.clear();
+      return false;
+    }
+
+    width_ = width;
+    height_ = height;
+    channels_ = channels;
+
+    tail_level_ = 0;
+    while (std::max(mips_[tail_level_].width, mips_[tail_level_].height) > TAIL_SIZE)
+      tail_level_++;
+    resident_level_ = tail_level_;
+
+    // the tail runs from the start of the data up to the end of its finest level
+    size_t tail_size = mips_[tail_level_].offset + mips_[tail_level_].size - MIP_CHAIN_HEADER_SIZE;
+    pixels_.resize(tail_size);
+    file.read((char *)pixels_.data(), tail_size);
+    if ((size_t)file.gcount() != tail_size)
+    {
+      std::cerr << "ERROR: mip chain is truncated: " << file_path_ + file_name_ << "\n";
+      mips_.clear();
+      pixels_.clear();
+      return false;
+    }
+
+    return true;
+  }
+
+
+  bool Texture::uploadMipChain()
+  {
+    GLenum format = getFormat();
+    glGenTextures(1, &texture_id_);
+    GLStateCache::instance()->bindTexture(0, GL_TEXTURE_2D, texture_id_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // finer levels stay undefined until streamed in, the base level keeps the texture complete
+    for (size_t i = tail_level_; i < mips_.size(); ++i)
+      glTexImage2D(GL_TEXTURE_2D, (GLint)i, format, mips_[i].width, mips_[i].height, 0, format, GL_UNSIGNED_BYTE,
+                   &pixels_[mips_[i].offset - MIP_CHAIN_HEADER_SIZE]);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, tail_level_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)mips_.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_mode_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_mode_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    resident_level_ = tail_level_;
+    releasePixels();
+    return true;
+  }
+} // namespace vv
\ No newline at end of file
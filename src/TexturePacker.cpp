@@ -0,0 +1,310 @@
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+#include "vv/GLStateCache.h"
+#include "vv/TexturePacker.h"
+
+namespace vv
+{
+  struct RoleBinding
+  {
+    TextureRole role;
+    GLint unit;
+    const char *sampler;
+    const char *layer;
+    const char *uv_rect;
+  };
+
+  /* Roles lighting.frag samples, everything else only travels with the material */
+  static const RoleBinding ROLE_BINDINGS[] =
+  {
+    { TEXTURE_DIFFUSE,  0, "diffuse_array",  "diffuse_layer",  "diffuse_uv_rect" },
+    { TEXTURE_NORMAL,   1, "normal_array",   "normal_layer",   "normal_uv_rect" },
+    { TEXTURE_SPECULAR, 2, "specular_array", "specular_layer", "specular_uv_rect" }
+  };
+
+  /////////////////////////////////////////////////////////////////////// public
+  TexturePacker::TexturePacker(ResourceManager *resource_manager, int atlas_size,
+                               int max_atlas_texture_size, int atlas_padding) :
+    resource_manager_(resource_manager),
+    atlas_size_(atlas_size),
+    max_atlas_texture_size_(std::min(max_atlas_texture_size, atlas_size - atlas_padding)),
+    atlas_padding_(atlas_padding),
+    built_(false)
+  {
+    stats_ = PackingStats();
+  }
+
+
+  TexturePacker::~TexturePacker()
+  {
+    for (auto array_id : arrays_)
+      GLStateCache::instance()->onDeleteTexture(array_id);
+
+    if (!arrays_.empty())
+      glDeleteTextures((GLsizei)arrays_.size(), arrays_.data());
+  }
+
+
+  void TexturePacker::addTexture(Handle texture)
+  {
+    if (texture.empty() || std::find(textures_.begin(), textures_.end(), texture) != textures_.end())
+      return;
+
+    textures_.push_back(texture);
+  }
+
+
+  void TexturePacker::setMaterialTexture(std::string material, TextureRole role, Handle texture)
+  {
+    if (texture.empty()) return;
+
+    addTexture(texture);
+    material_textures_[material].push_back(std::make_pair(role, texture));
+  }
+
+
+  bool TexturePacker::build()
+  {
+    if (built_) return true;
+
+    std::vector<Texture *> textures;
+    std::map<std::tuple<int, int, int, GLint>, std::vector<Texture *> > groups;
+    for (auto &handle : textures_)
+    {
+      Texture *texture = resource_manager_->getTexture(handle);
+      if (!texture)
+      {
+        std::cerr << "WARNING: texture " << handle << " was unloaded before packing.\n";
+        continue;
+      }
+
+      if (texture->getPixels().empty())
+      {
+        std::cerr << "WARNING: texture " << texture->getHandle() << " has no pixel data left to pack.\n";
+        continue;
+      }
+
+      // streamed textures change their resident levels at run time, they stay standalone
+      if (texture->isStreamed())
+      {
+        std::cerr << "WARNING: texture " << texture->getHandle() << " is streamed and can't be packed.\n";
+        continue;
+      }
+
+      textures.push_back(texture);
+      groups[std::make_tuple(texture->getWidth(), texture->getHeight(), texture->getChannels(),
+                             texture->getWrapMode())].push_back(texture);
+    }
+
+    std::map<int, std::vector<Texture *> > atlas_candidates;
+    for (auto &group : groups)
+    {
+      Texture *first = group.second.front();
+      // atlas pages clamp at the page edge, not the texture's, so tiling textures stay out
+      bool fits_atlas = (first->getWidth() <= max_atlas_texture_size_) &&
+                        (first->getHeight() <= max_atlas_texture_size_) &&
+                        (first->getWrapMode() == GL_CLAMP_TO_EDGE);
+
+      if (group.second.size() == 1 && fits_atlas)
+        atlas_candidates[first->getChannels()].push_back(first);
+      else
+        buildArray(group.second);
+    }
+
+    for (auto &candidates : atlas_candidates)
+      buildAtlas(candidates.second);
+
+    for (auto &material : material_textures_)
+    {
+      PackedMaterial packed;
+      for (int i = 0; i < TEXTURE_ROLE_COUNT; ++i)
+      {
+        packed.slots[i].array_id = 0;
+        packed.slots[i].layer = 0;
+        packed.slots[i].uv_rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+      }
+
+      for (auto &role : material.second)
+      {
+        const TextureSlot *slot = getSlot(role.second);
+        if (slot)
+          packed.slots[role.first] = *slot;
+      }
+
+      materials_[material.first] = packed;
+    }
+
+    for (auto texture : textures)
+      if (slots_.count(texture->getHandle()))
+        texture->releasePixels();
+
+    built_ = true;
+    return true;
+  }
+
+
+  const TextureSlot* TexturePacker::getSlot(Handle texture) const
+  {
+    auto slot = slots_.find(texture);
+    return (slot != slots_.end()) ? &slot->second : nullptr;
+  }
+
+
+  const PackedMaterial* TexturePacker::getMaterial(std::string material) const
+  {
+    auto packed = materials_.find(material);
+    return (packed != materials_.end()) ? &packed->second : nullptr;
+  }
+
+
+  const PackingStats& TexturePacker::getStats() const
+  {
+    return stats_;
+  }
+
+
+  void TexturePacker::bindMaterial(const PackedMaterial &material, Shader *shader) const
+  {
+    GLuint program = shader->getProgramId();
+
+    for (auto &binding : ROLE_BINDINGS)
+    {
+      const TextureSlot &slot = material.slots[binding.role];
+      if (!slot.array_id) continue;
+
+      // variants without the role compile its uniforms out, so missing ones are expected
+      GLint sampler = glGetUniformLocation(program, binding.sampler);
+      if (sampler == -1) continue;
+
+      GLStateCache::instance()->bindTexture(binding.unit, GL_TEXTURE_2D_ARRAY, slot.array_id);
+      glUniform1i(sampler, binding.unit);
+      glUniform1f(glGetUniformLocation(program, binding.layer), (GLfloat)slot.layer);
+      glUniform4f(glGetUniformLocation(program, binding.uv_rect),
+                  slot.uv_rect.x, slot.uv_rect.y, slot.uv_rect.z, slot.uv_rect.w);
+      GLStateCache::instance()->countApiCalls(6);
+    }
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void TexturePacker::buildArray(const std::vector<Texture *> &textures)
+  {
+    GLint max_layers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+    for (size_t start = 0; start < textures.size(); start += max_layers)
+    {
+      size_t end = std::min(textures.size(), start + (size_t)max_layers);
+
+      std::vector<PendingSlot> pending;
+      for (size_t i = start; i < end; ++i)
+      {
+        PendingSlot p = { textures[i], (int)(i - start), 0, 0 };
+        pending.push_back(p);
+      }
+
+      Texture *first = textures[start];
+      GLuint array_id = uploadArray(first->getWidth(), first->getHeight(), first->getChannels(),
+                                    (int)pending.size(), pending, first->getWrapMode(), false);
+
+      for (auto &p : pending)
+      {
+        TextureSlot slot = { array_id, p.layer, glm::vec4(1.0f, 1.0f, 0.0f, 0.0f) };
+        slots_[p.texture->getHandle()] = slot;
+      }
+    }
+  }
+
+
+  void TexturePacker::buildAtlas(std::vector<Texture *> textures)
+  {
+    // shelf packing, tallest first keeps the shelves tight
+    std::sort(textures.begin(), textures.end(), [](const Texture *a, const Texture *b)
+    {
+      return a->getHeight() > b->getHeight();
+    });
+
+    std::vector<PendingSlot> pending;
+    int page = 0, x = 0, y = 0, shelf_height = 0;
+    for (auto texture : textures)
+    {
+      int width = texture->getWidth() + atlas_padding_;
+      int height = texture->getHeight() + atlas_padding_;
+
+      if (x + width > atlas_size_)
+      {
+        y += shelf_height;
+        x = 0;
+        shelf_height = 0;
+      }
+
+      if (y + height > atlas_size_)
+      {
+        page++;
+        x = 0;
+        y = 0;
+        shelf_height = 0;
+      }
+
+      PendingSlot p = { texture, page, x, y };
+      pending.push_back(p);
+
+      x += width;
+      shelf_height = std::max(shelf_height, height);
+    }
+
+    int channels = textures.front()->getChannels();
+    GLuint array_id = uploadArray(atlas_size_, atlas_size_, channels, page + 1, pending, GL_CLAMP_TO_EDGE, true);
+    stats_.atlas_pages += page + 1;
+
+    const float inv_size = 1.0f / atlas_size_;
+    for (auto &p : pending)
+    {
+      TextureSlot slot = { array_id, p.layer,
+                           glm::vec4(p.texture->getWidth() * inv_size, p.texture->getHeight() * inv_size,
+                                     p.x * inv_size, p.y * inv_size) };
+      slots_[p.texture->getHandle()] = slot;
+    }
+  }
+
+
+  GLuint TexturePacker::uploadArray(int width, int height, int channels, int layers,
+                                    const std::vector<PendingSlot> &pending, GLint wrap, bool atlas)
+  {
+    GLenum format = Texture::formatFromChannels(channels);
+
+    GLuint array_id = 0;
+    glGenTextures(1, &array_id);
+    GLStateCache::instance()->bindTexture(0, GL_TEXTURE_2D_ARRAY, array_id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // atlas padding has to be defined or it bleeds garbage into the lower mips
+    std::vector<unsigned char> cleared;
+    if (atlas)
+      cleared.resize((size_t)width * height * channels * layers, 0);
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, width, height, layers, 0, format, GL_UNSIGNED_BYTE,
+                 cleared.empty() ? NULL : cleared.data());
+
+    for (auto &p : pending)
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, p.x, p.y, p.layer,
+                      p.texture->getWidth(), p.texture->getHeight(), 1,
+                      format, GL_UNSIGNED_BYTE, p.texture->getPixels().data());
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+    arrays_.push_back(array_id);
+    stats_.texture_arrays++;
+    stats_.array_layers += layers;
+    stats_.textures_packed += pending.size();
+    return array_id;
+  }
+} // namespace vv
\ No newline at end of file
@@ -0,0 +1,458 @@
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "vv/MemoryTracker.h"
+#include "vv/TextureStreamer.h"
+
+namespace vv
+{
+  /* Keeps a camera inside an object's bounds from asking for an infinitely fine level */
+  static const float MIN_DISTANCE = 0.001f;
+
+  static float axisLength(const glm::mat4 &matrix, int axis)
+  {
+    const glm::vec4 &column = matrix[axis];
+    return std::sqrt(column.x * column.x + column.y * column.y + column.z * column.z);
+  }
+
+  /////////////////////////////////////////////////////////////////////// public
+  TextureStreamer::TextureStreamer(const TextureStreamingSettings &settings) :
+    settings_(settings),
+    camera_position_(0.0f),
+    pixels_per_unit_(0.0f),
+    reads_in_flight_(0),
+    pending_bytes_(0),
+    running_(false)
+  {
+    stats_ = TextureStreamingStats();
+  }
+
+
+  TextureStreamer::~TextureStreamer()
+  {
+    shutdown();
+  }
+
+
+  bool TextureStreamer::init()
+  {
+    if (running_) return true;
+
+    if (settings_.memory_budget == 0)
+    {
+      std::cerr << "ERROR: texture streamer requires a memory budget.\n";
+      return false;
+    }
+
+    if (settings_.max_reads_in_flight < 1) settings_.max_reads_in_flight = 1;
+    if (settings_.drop_hysteresis < 0) settings_.drop_hysteresis = 0;
+
+    // the swapped io lists never hold more than the reads in flight
+    read_requests_.reserve(settings_.max_reads_in_flight);
+    read_results_.reserve(settings_.max_reads_in_flight);
+    collected_.reserve(settings_.max_reads_in_flight);
+
+    running_ = true;
+    io_thread_ = std::thread(&TextureStreamer::ioLoop, this);
+    return true;
+  }
+
+
+  void TextureStreamer::shutdown()
+  {
+    if (!running_) return;
+
+    {
+      std::lock_guard<std::mutex> lock(io_mutex_);
+      running_ = false;
+    }
+    io_condition_.notify_all();
+    io_thread_.join();
+
+    for (auto read : read_requests_)
+      delete read;
+    for (auto read : read_results_)
+      delete read;
+    for (auto read : ready_)
+      delete read;
+    for (auto read : free_reads_)
+      delete read;
+    read_requests_.clear();
+    read_results_.clear();
+    ready_.clear();
+    free_reads_.clear();
+    collected_.clear();
+
+    // whatever is resident stays, the textures are still usable without the streamer
+    for (auto t : textures_)
+      delete t.second;
+    textures_.clear();
+    reads_in_flight_ = 0;
+    pending_bytes_ = 0;
+  }
+
+
+  void TextureStreamer::addTexture(Texture *texture)
+  {
+    if (!texture || textures_.count(texture)) return;
+
+    if (!texture->isStreamed() || !texture->getTextureId())
+    {
+      std::cerr << "WARNING: texture " << texture->getHandle() << " is not an uploaded mip chain, "
+                << "it can't be streamed.\n";
+      return;
+    }
+
+    VV_MEMORY_SCOPE(MEMORY_STREAMING);
+    StreamedTexture *entry = new StreamedTexture;
+    entry->texture = texture;
+    entry->file = texture->getFileName();
+    entry->chain_sizes.resize(texture->getMipCount() + 1, 0);
+    for (int level = texture->getMipCount() - 1; level >= 0; --level)
+      entry->chain_sizes[level] = entry->chain_sizes[level + 1] + texture->getMipLevel(level).size;
+
+    entry->feedback_level = texture->getTailLevel();
+    entry->wanted_level = texture->getTailLevel();
+    entry->target_level = texture->getTailLevel();
+    entry->read = nullptr;
+
+    textures_[texture] = entry;
+  }
+
+
+  void TextureStreamer::removeTexture(Texture *texture)
+  {
+    auto entry = textures_.find(texture);
+    if (entry == textures_.end()) return;
+
+    // a read still with the io thread is dropped by collectReads(), it no longer matches any entry
+    for (auto it = ready_.begin(); it != ready_.end();)
+    {
+      if ((*it)->texture == texture)
+      {
+        pending_bytes_ -= (*it)->size;
+        releaseRead(*it);
+        it = ready_.erase(it);
+      }
+      else
+        ++it;
+    }
+
+    delete entry->second;
+    textures_.erase(entry);
+  }
+
+
+  void TextureStreamer::beginFeedback(const glm::vec3 &camera_position, const glm::mat4 &projection,
+                                      int viewport_height)
+  {
+    camera_position_ = camera_position;
+    pixels_per_unit_ = projection[1][1] * 0.5f * (float)viewport_height;
+
+    // nothing reported this frame means nothing finer than the tail is needed
+    for (auto t : textures_)
+      t.second->feedback_level.store(t.first->getTailLevel(), std::memory_order_relaxed);
+  }
+
+
+  void TextureStreamer::addUse(Texture *texture, const AABB &world_bounds, float uv_density)
+  {
+    auto t = textures_.find(texture);
+    if (t == textures_.end() || !world_bounds.isValid() || uv_density <= 0.0f) return;
+
+    // the closest point of the bounds sets the finest level the entity can show
+    glm::vec3 offset;
+    for (int i = 0; i < 3; ++i)
+      offset[i] = std::max(std::max(world_bounds.min[i] - camera_position_[i], 0.0f),
+                           camera_position_[i] - world_bounds.max[i]);
+    float distance = std::max(std::sqrt(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z),
+                              MIN_DISTANCE);
+
+    // texels per pixel decide the level the sampler would pick, trilinear also needs the one below
+    float texels_per_unit = uv_density * (float)std::max(texture->getWidth(), texture->getHeight());
+    float pixels_per_unit = pixels_per_unit_ / distance;
+    float level = std::log2(texels_per_unit / pixels_per_unit) + settings_.mip_bias;
+
+    int needed = std::min(texture->getTailLevel(), std::max(0, (int)std::floor(level)));
+
+    std::atomic<int> &feedback = t->second->feedback_level;
+    int previous = feedback.load(std::memory_order_relaxed);
+    while (needed < previous && !feedback.compare_exchange_weak(previous, needed, std::memory_order_relaxed))
+    {
+    }
+  }
+
+
+  void TextureStreamer::addUse(Texture *texture, Entity *entity, float uv_density)
+  {
+    if (!entity || !entity->getBounds().isValid()) return;
+
+    // a scaled up entity spreads the same texels over more world units, the smallest axis
+    // scale keeps the finest level any direction needs
+    glm::mat4 model = entity->getTransform()->getMatrix();
+    float scale = std::min(std::min(axisLength(model, 0), axisLength(model, 1)), axisLength(model, 2));
+    if (scale <= 0.0f) return;
+
+    addUse(texture, entity->getWorldBounds(), uv_density / scale);
+  }
+
+
+  void TextureStreamer::update()
+  {
+    if (!running_) return;
+    VV_MEMORY_SCOPE(MEMORY_STREAMING);
+
+    stats_.bytes_this_frame = 0;
+
+    collectReads();
+    chooseTargets();
+    dropLevels();
+    uploadReads();
+    requestReads();
+
+    stats_.textures = textures_.size();
+    stats_.resident_bytes = 0;
+    for (auto t : textures_)
+      stats_.resident_bytes += t.second->chain_sizes[t.first->getResidentLevel()];
+    stats_.reads_in_flight = reads_in_flight_;
+  }
+
+
+  int TextureStreamer::getWantedLevel(Texture *texture) const
+  {
+    auto t = textures_.find(texture);
+    return (t != textures_.end()) ? t->second->wanted_level : -1;
+  }
+
+
+  const TextureStreamingStats& TextureStreamer::getStats() const
+  {
+    return stats_;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  void TextureStreamer::collectReads()
+  {
+    // swapping hands the io thread last frame's storage, neither list ever shrinks
+    collected_.clear();
+    {
+      std::lock_guard<std::mutex> lock(io_mutex_);
+      collected_.swap(read_results_);
+    }
+
+    for (auto read : collected_)
+    {
+      reads_in_flight_--;
+
+      auto t = textures_.find(read->texture);
+      bool current = (t != textures_.end()) && (t->second->read == read);
+      if (current && read->success)
+      {
+        ready_.push_back(read);
+        continue;
+      }
+
+      if (current)
+      {
+        std::cerr << "WARNING: could not read mip level " << read->level << " of " << read->file << "\n";
+        t->second->read = nullptr;
+      }
+
+      pending_bytes_ -= read->size;
+      releaseRead(read);
+    }
+  }
+
+
+  void TextureStreamer::chooseTargets()
+  {
+    int max_bias = 0;
+    for (auto t : textures_)
+    {
+      StreamedTexture *entry = t.second;
+      entry->wanted_level = entry->feedback_level.load(std::memory_order_relaxed);
+      max_bias = std::max(max_bias, entry->texture->getTailLevel() - entry->wanted_level);
+    }
+
+    // coarsening everything by the same amount keeps relative sharpness where the budget is short
+    int bias = 0;
+    for (; bias <= max_bias; ++bias)
+    {
+      size_t total = 0;
+      for (auto t : textures_)
+        total += t.second->chain_sizes[std::min(t.second->wanted_level + bias, t.first->getTailLevel())];
+
+      if (bias == 0) stats_.wanted_bytes = total;
+      if (total <= settings_.memory_budget) break;
+    }
+    bias = std::min(bias, max_bias);
+    stats_.budget_bias = bias;
+
+    for (auto t : textures_)
+      t.second->target_level = std::min(t.second->wanted_level + bias, t.first->getTailLevel());
+  }
+
+
+  void TextureStreamer::dropLevels()
+  {
+    size_t resident = 0;
+    for (auto t : textures_)
+      resident += t.second->chain_sizes[t.first->getResidentLevel()];
+
+    for (auto t : textures_)
+    {
+      StreamedTexture *entry = t.second;
+      Texture *texture = t.first;
+      int excess = entry->target_level - texture->getResidentLevel();
+      if (excess <= 0) continue;
+
+      // hysteresis stops a texture at a level boundary from reloading the same mip every other frame
+      if (excess <= settings_.drop_hysteresis && resident <= settings_.memory_budget) continue;
+
+      resident -= entry->chain_sizes[texture->getResidentLevel()] - entry->chain_sizes[entry->target_level];
+      stats_.levels_dropped += excess;
+      texture->dropMipLevels(entry->target_level);
+    }
+  }
+
+
+  void TextureStreamer::uploadReads()
+  {
+    size_t uploaded = 0;
+    for (; uploaded < ready_.size(); ++uploaded)
+    {
+      MipRead *read = ready_[uploaded];
+      StreamedTexture *entry = textures_[read->texture];
+
+      bool wanted = (read->level == read->texture->getResidentLevel() - 1) && (entry->target_level <= read->level);
+      if (wanted)
+      {
+        // the first upload of a frame ignores the budget, a base level larger than the whole
+        // budget would otherwise never be uploaded and the texture would stay blurry
+        if ((stats_.bytes_this_frame > 0) &&
+            (stats_.bytes_this_frame + read->size > settings_.max_upload_bytes_per_frame))
+          break;
+
+        if (read->texture->uploadMipLevel(read->level, read->pixels))
+        {
+          stats_.levels_loaded++;
+          stats_.bytes_this_frame += read->size;
+        }
+      }
+
+      entry->read = nullptr;
+      pending_bytes_ -= read->size;
+      releaseRead(read);
+    }
+
+    ready_.erase(ready_.begin(), ready_.begin() + uploaded);
+  }
+
+
+  void TextureStreamer::requestReads()
+  {
+    size_t resident = 0;
+    candidates_.clear();
+    for (auto t : textures_)
+    {
+      resident += t.second->chain_sizes[t.first->getResidentLevel()];
+      if (!t.second->read && t.second->target_level < t.first->getResidentLevel())
+        candidates_.push_back(t.second);
+    }
+
+    if (candidates_.empty()) return;
+
+    // textures furthest from what they need first
+    std::sort(candidates_.begin(), candidates_.end(), [](const StreamedTexture *a, const StreamedTexture *b)
+    {
+      return (a->texture->getResidentLevel() - a->target_level) > (b->texture->getResidentLevel() - b->target_level);
+    });
+
+    int issued = 0;
+    {
+      std::lock_guard<std::mutex> lock(io_mutex_);
+      for (auto entry : candidates_)
+      {
+        if (reads_in_flight_ >= settings_.max_reads_in_flight) break;
+
+        int level = entry->texture->getResidentLevel() - 1;
+        const MipLevel &mip = entry->texture->getMipLevel(level);
+        if (resident + pending_bytes_ + mip.size > settings_.memory_budget) continue;
+
+        MipRead *read = acquireRead();
+        read->texture = entry->texture;
+        read->level = level;
+        read->file = entry->file;
+        read->offset = mip.offset;
+        read->size = mip.size;
+        read->success = false;
+
+        entry->read = read;
+        read_requests_.push_back(read);
+        reads_in_flight_++;
+        pending_bytes_ += mip.size;
+        issued++;
+      }
+    }
+
+    if (issued > 0) io_condition_.notify_one();
+  }
+
+
+  TextureStreamer::MipRead* TextureStreamer::acquireRead()
+  {
+    if (free_reads_.empty())
+      return new MipRead;
+
+    MipRead *read = free_reads_.back();
+    free_reads_.pop_back();
+    return read;
+  }
+
+
+  void TextureStreamer::releaseRead(MipRead *read)
+  {
+    // the pixel and name storage stays with the read for the next request
+    free_reads_.push_back(read);
+  }
+
+
+  void TextureStreamer::ioLoop()
+  {
+    VV_MEMORY_SCOPE(MEMORY_STREAMING);
+
+    while (true)
+    {
+      MipRead *read = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(io_mutex_);
+        io_condition_.wait(lock, [this] { return !running_ || !read_requests_.empty(); });
+        if (!running_) return;
+
+        read = read_requests_.front();
+        read_requests_.erase(read_requests_.begin());
+      }
+
+      read->success = readMip(read);
+
+      std::lock_guard<std::mutex> lock(io_mutex_);
+      read_results_.push_back(read);
+    }
+  }
+
+
+  bool TextureStreamer::readMip(MipRead *read)
+  {
+    std::ifstream file(read->file, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    read->pixels.resize(read->size);
+    file.seekg(read->offset);
+    file.read((char *)read->pixels.data(), read->size);
+    return (size_t)file.gcount() == read->size;
+  }
+} // namespace vv
\ No newline at end of file
@@ -0,0 +1,186 @@
+
+#include <algorithm>
+
+#include "vv/ThreadPool.h"
+
+namespace vv
+{
+  static const size_t MAX_FOR_TASKS = 64; /* nesting beyond this runs inline */
+
+  /////////////////////////////////////////////////////////////////////// public
+  ThreadPool* ThreadPool::instance()
+  {
+    // the main thread always helps out, so leave one core for it
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return &pool;
+  }
+
+
+  size_t ThreadPool::getWorkerCount() const
+  {
+    return workers_.size();
+  }
+
+
+  size_t ThreadPool::getQueuedJobs() const
+  {
+    return queued_jobs_.load(std::memory_order_relaxed);
+  }
+
+
+  size_t ThreadPool::getQueuedChunks() const
+  {
+    return queued_chunks_.load(std::memory_order_relaxed);
+  }
+
+
+  void ThreadPool::submit(std::function<void()> job)
+  {
+    if (workers_.empty())
+    {
+      job();
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back(job);
+      queued_jobs_.store(jobs_.size(), std::memory_order_relaxed);
+    }
+    condition_.notify_one();
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  ThreadPool::ThreadPool(size_t worker_count) :
+    running_(true),
+    queued_jobs_(0),
+    queued_chunks_(0)
+  {
+    tasks_.reserve(MAX_FOR_TASKS);
+    for (size_t i = 0; i < worker_count; ++i)
+      workers_.push_back(std::thread(&ThreadPool::workerLoop, this));
+  }
+
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    condition_.notify_all();
+
+    for (auto &worker : workers_)
+      worker.join();
+  }
+
+
+  void ThreadPool::workerLoop()
+  {
+    while (true)
+    {
+      std::function<void()> job;
+      ForTask *task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this] { return !running_ || !jobs_.empty() || findOpenTask(); });
+        if (!running_ && jobs_.empty()) return;
+
+        // a parallelFor caller is blocked on its chunks, queued jobs are not
+        task = findOpenTask();
+        if (task)
+        {
+          task->helpers++;
+        }
+        else
+        {
+          job = jobs_.front();
+          jobs_.pop_front();
+          queued_jobs_.store(jobs_.size(), std::memory_order_relaxed);
+        }
+      }
+
+      if (!task)
+      {
+        job();
+        continue;
+      }
+
+      runChunks(*task);
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--task->helpers == 0)
+        task_done_.notify_all();
+    }
+  }
+
+
+  void ThreadPool::runParallelFor(size_t count, size_t grain, RangeFunction function, const void *context)
+  {
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+
+    // at most a few chunks per thread, enough to balance uneven work without flooding the workers
+    size_t thread_count = workers_.size() + 1;
+    size_t chunk_size = std::max(grain, (count + thread_count * 4 - 1) / (thread_count * 4));
+    size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+    if (chunk_count == 1 || workers_.empty())
+    {
+      function(context, 0, count);
+      return;
+    }
+
+    ForTask task;
+    task.function = function;
+    task.context = context;
+    task.count = count;
+    task.chunk_size = chunk_size;
+    task.chunk_count = chunk_count;
+    task.next_chunk = 0;
+    task.helpers = 0;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // growing the list would allocate, and this deep a nesting has no idle workers anyway
+      if (tasks_.size() == tasks_.capacity())
+      {
+        function(context, 0, count);
+        return;
+      }
+      tasks_.push_back(&task);
+      queued_chunks_.fetch_add(chunk_count, std::memory_order_relaxed);
+    }
+    condition_.notify_all();
+
+    runChunks(task);
+
+    // once unlisted no worker can join, so only the ones already inside have to finish
+    std::unique_lock<std::mutex> lock(mutex_);
+    tasks_.erase(std::find(tasks_.begin(), tasks_.end(), &task));
+    task_done_.wait(lock, [&task] { return task.helpers == 0; });
+  }
+
+
+  ThreadPool::ForTask* ThreadPool::findOpenTask() const
+  {
+    for (auto task : tasks_)
+      if (task->next_chunk.load(std::memory_order_relaxed) < task->chunk_count)
+        return task;
+
+    return nullptr;
+  }
+
+
+  void ThreadPool::runChunks(ForTask &task)
+  {
+    size_t chunk;
+    while ((chunk = task.next_chunk.fetch_add(1)) < task.chunk_count)
+    {
+      queued_chunks_.fetch_sub(1, std::memory_order_relaxed);
+      size_t begin = chunk * task.chunk_size;
+      task.function(task.context, begin, std::min(task.count, begin + task.chunk_size));
+    }
+  }
+} // namespace vv
\ No newline at end of file
@@ -4,19 +4,22 @@
 namespace vv
 {
   /////////////////////////////////////////////////////////////////////// public
-  Transform::Transform()
+  Transform::Transform() :
+    dirty_(true)
   {
     homogeneous_transform_mat_ = glm::mat4(1.0f);
   }
 
 
-  Transform::Transform(Transform const &trans)
+  Transform::Transform(Transform const &trans) :
+    dirty_(true)
   {
     homogeneous_transform_mat_ = trans.homogeneous_transform_mat_;
   }
 
 
-  Transform::Transform(glm::mat4 trans)
+  Transform::Transform(glm::mat4 trans) :
+    dirty_(true)
   {
     homogeneous_transform_mat_ = trans;
   }
@@ -25,18 +28,21 @@ namespace vv
   void Transform::translate(glm::vec3 translation)
   {
     homogeneous_transform_mat_ = glm::translate(homogeneous_transform_mat_, translation);
+    dirty_ = true;
   }
 
 
   void Transform::rotate(float angle, glm::vec3 axis)
   {
     homogeneous_transform_mat_ = glm::rotate(homogeneous_transform_mat_, angle, axis);
+    dirty_ = true;
   }
 
 
   void Transform::scale(glm::vec3 scaling)
   {
     homogeneous_transform_mat_ = glm::scale(homogeneous_transform_mat_, scaling);
+    dirty_ = true;
   }
 
 
@@ -63,4 +69,22 @@ namespace vv
     return rot;
   }
 
+
+  bool Transform::isDirty() const
+  {
+    return dirty_;
+  }
+
+
+  void Transform::markDirty()
+  {
+    dirty_ = true;
+  }
+
+
+  void Transform::clearDirty()
+  {
+    dirty_ = false;
+  }
+
 } // namespace vv
\ No newline at end of file
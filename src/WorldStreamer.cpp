@@ -0,0 +1,602 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "vv/MemoryTracker.h"
+#include "vv/VirtualVista.h"
+#include "vv/WorldStreamer.h"
+
+namespace vv
+{
+  /////////////////////////////////////////////////////////////////////// public
+  WorldStreamer::WorldStreamer(ResourceManager *resource_manager, std::string directory,
+                               const StreamingSettings &settings) :
+    resource_manager_(resource_manager),
+    directory_(directory),
+    settings_(settings),
+    camera_cell_x_(0),
+    camera_cell_z_(0),
+    reads_in_flight_(0),
+    window_size_(0),
+    running_(false)
+  {
+    stats_ = StreamingStats();
+  }
+
+
+  WorldStreamer::~WorldStreamer()
+  {
+    shutdown();
+  }
+
+
+  bool WorldStreamer::init()
+  {
+    if (running_) return true;
+
+    if (!resource_manager_ || settings_.cell_size <= 0.0f)
+    {
+      std::cerr << "ERROR: world streamer requires a resource manager and a positive cell size.\n";
+      return false;
+    }
+
+    if (settings_.hysteresis_rings < 0) settings_.hysteresis_rings = 0;
+    if (settings_.max_loads_per_frame < 1) settings_.max_loads_per_frame = 1;
+    if (settings_.max_reads_in_flight < 1) settings_.max_reads_in_flight = 1;
+
+    // sized for the most cells that can be tracked or in flight, so update() never grows a list
+    // or runs out of pooled cells
+    window_size_ = 2 * (settings_.load_radius + settings_.prefetch_rings + settings_.hysteresis_rings) + 1;
+    size_t window_cells = (size_t)window_size_ * window_size_;
+    cells_.assign(window_cells, nullptr);
+    free_cells_.reserve(window_cells + settings_.max_reads_in_flight);
+    while (free_cells_.size() < free_cells_.capacity())
+      free_cells_.push_back(new WorldCell);
+    pending_.reserve(window_cells);
+    candidates_.reserve(window_cells);
+    collected_.reserve(settings_.max_reads_in_flight);
+    read_requests_.reserve(settings_.max_reads_in_flight);
+    read_results_.reserve(settings_.max_reads_in_flight);
+
+    running_ = true;
+    io_thread_ = std::thread(&WorldStreamer::ioLoop, this);
+    return true;
+  }
+
+
+  void WorldStreamer::update(glm::vec3 camera_position)
+  {
+    if (!running_) return;
+    VV_MEMORY_SCOPE(MEMORY_STREAMING);
+
+    camera_cell_x_ = (int)std::floor(camera_position.x / settings_.cell_size);
+    camera_cell_z_ = (int)std::floor(camera_position.z / settings_.cell_size);
+
+    stats_.loads_this_frame = 0;
+    stats_.bytes_this_frame = 0;
+
+    // decodes for the load radius go first, prefetch reads only get the slots left over
+    collectReads();
+    evictCells();
+    issueLoads();
+    requestCells();
+
+    stats_.cells_resident = 0;
+    stats_.cells_prefetched = 0;
+    for (auto cell : cells_)
+    {
+      if (!cell) continue;
+      if (cell->state == CELL_RESIDENT) stats_.cells_resident++;
+      else if (cell->state == CELL_PREFETCHED) stats_.cells_prefetched++;
+    }
+    stats_.cells_in_flight = reads_in_flight_;
+  }
+
+
+  void WorldStreamer::shutdown()
+  {
+    if (!running_) return;
+
+    {
+      std::lock_guard<std::mutex> lock(io_mutex_);
+      running_ = false;
+    }
+    io_condition_.notify_all();
+    io_thread_.join();
+
+    // cancelled cells are no longer tracked by cells_ but may still sit in either queue
+    for (auto cell : read_requests_)
+      if (cell->cancelled) releaseCell(cell);
+    for (auto cell : read_results_)
+      if (cell->cancelled) releaseCell(cell);
+    read_requests_.clear();
+    read_results_.clear();
+
+    for (auto &cell : cells_)
+    {
+      if (cell) releaseCell(cell);
+      cell = nullptr;
+    }
+
+    for (auto cell : free_cells_)
+      delete cell;
+    free_cells_.clear();
+    reads_in_flight_ = 0;
+  }
+
+
+  const StreamingStats& WorldStreamer::getStats() const
+  {
+    return stats_;
+  }
+
+
+  std::string WorldStreamer::getCellFileName(int x, int z) const
+  {
+    std::stringstream file_name;
+    file_name << directory_ << "cell_" << x << "_" << z << ".vvc";
+    return file_name.str();
+  }
+
+
+  bool WorldStreamer::saveCell(const WorldCell &cell) const
+  {
+    std::ofstream file(getCellFileName(cell.x, cell.z));
+    if (!file.is_open())
+    {
+      std::cerr << "ERROR: could not write world cell: " << getCellFileName(cell.x, cell.z) << "\n";
+      return false;
+    }
+
+    file << "# VirtualVista world cell\n";
+    file << "cell " << cell.x << " " << cell.z << "\n";
+    for (auto &entry : cell.entries)
+    {
+      if (entry.type == CELL_ENTRY_MESH)
+        file << "mesh " << entry.path << " " << entry.name << "\n";
+      else
+        file << "texture " << entry.path << " " << entry.name << "\n";
+    }
+
+    return true;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////// private
+  size_t WorldStreamer::slot(int x, int z) const
+  {
+    // wrapped twice so negative cells land inside the window as well
+    int wrapped_x = ((x % window_size_) + window_size_) % window_size_;
+    int wrapped_z = ((z % window_size_) + window_size_) % window_size_;
+    return (size_t)wrapped_z * window_size_ + wrapped_x;
+  }
+
+
+  int WorldStreamer::ringDistance(const WorldCell *cell) const
+  {
+    return std::max(std::abs(cell->x - camera_cell_x_), std::abs(cell->z - camera_cell_z_));
+  }
+
+
+  void WorldStreamer::requestCells()
+  {
+    const int outer_ring = settings_.load_radius + settings_.prefetch_rings;
+
+    candidates_.clear();
+    for (int z = camera_cell_z_ - outer_ring; z <= camera_cell_z_ + outer_ring; ++z)
+    {
+      for (int x = camera_cell_x_ - outer_ring; x <= camera_cell_x_ + outer_ring; ++x)
+      {
+        // everything outside the window was evicted already, so a taken slot holds this cell
+        if (cells_[slot(x, z)]) continue;
+
+        CellCandidate c = { x, z, std::max(std::abs(x - camera_cell_x_), std::abs(z - camera_cell_z_)) };
+        candidates_.push_back(c);
+      }
+    }
+
+    if (candidates_.empty()) return;
+
+    // nearest rings first so the camera cell never waits behind the prefetch ring
+    std::sort(candidates_.begin(), candidates_.end(), [](const CellCandidate &a, const CellCandidate &b)
+    {
+      return a.ring < b.ring;
+    });
+
+    int issued = 0;
+    {
+      std::lock_guard<std::mutex> lock(io_mutex_);
+      for (auto &c : candidates_)
+      {
+        if ((issued >= settings_.max_reads_per_frame) ||
+            (reads_in_flight_ >= settings_.max_reads_in_flight))
+          break;
+
+        WorldCell *cell = acquireCell(c.x, c.z);
+        cell->state = CELL_READING;
+
+        cells_[slot(c.x, c.z)] = cell;
+        read_requests_.push_back(cell);
+        reads_in_flight_++;
+        issued++;
+      }
+    }
+
+    if (issued > 0) io_condition_.notify_one();
+  }
+
+
+  void WorldStreamer::collectReads()
+  {
+    // the io thread goes on filling the list collected last frame, both keep their reserve
+    collected_.clear();
+    {
+      std::lock_guard<std::mutex> lock(io_mutex_);
+      collected_.swap(read_results_);
+    }
+
+    for (auto cell : collected_)
+    {
+      reads_in_flight_--;
+      if (cell->cancelled)
+      {
+        releaseCell(cell);
+        continue;
+      }
+
+      if (cell->state == CELL_DECODING)
+      {
+        cell->state = CELL_UPLOADING;
+        continue;
+      }
+
+      // a malformed cell stays tracked so it isn't read again every frame, but loads nothing
+      if (cell->failed)
+      {
+        cell->entries.clear();
+        cell->state = CELL_FAILED;
+        stats_.cells_failed++;
+        continue;
+      }
+      cell->state = CELL_PREFETCHED;
+    }
+  }
+
+
+  void WorldStreamer::issueLoads()
+  {
+    pending_.clear();
+    for (auto cell : cells_)
+    {
+      if (!cell) continue;
+      if ((cell->state == CELL_PREFETCHED && ringDistance(cell) <= settings_.load_radius) ||
+          (cell->state == CELL_UPLOADING))
+        pending_.push_back(cell);
+    }
+
+    std::sort(pending_.begin(), pending_.end(), [this](const WorldCell *a, const WorldCell *b)
+    {
+      return ringDistance(a) < ringDistance(b);
+    });
+
+    int queued = 0;
+    bool budget_left = true;
+    for (auto cell : pending_)
+    {
+      // decoding is the expensive part, the io thread does it and only the upload happens here
+      if (cell->state == CELL_PREFETCHED)
+      {
+        if (reads_in_flight_ >= settings_.max_reads_in_flight) continue;
+
+        for (auto &entry : cell->entries)
+          entry.shared = (entry.type == CELL_ENTRY_MESH) ?
+            (resource_manager_->getMesh(entry.handle) != nullptr) :
+            (resource_manager_->getTexture(entry.handle) != nullptr);
+
+        cell->state = CELL_DECODING;
+        {
+          std::lock_guard<std::mutex> lock(io_mutex_);
+          read_requests_.push_back(cell);
+        }
+        reads_in_flight_++;
+        queued++;
+        continue;
+      }
+
+      if (!budget_left) continue;
+
+      while (cell->upload_cursor < cell->entries.size())
+      {
+        CellEntry &entry = cell->entries[cell->upload_cursor];
+
+        // one entry always fits so a mesh larger than the budget cannot stall streaming forever
+        if ((stats_.loads_this_frame >= (size_t)settings_.max_loads_per_frame) ||
+            ((stats_.bytes_this_frame > 0) &&
+             (stats_.bytes_this_frame + entry.decoded_size > settings_.max_bytes_per_frame)))
+        {
+          budget_left = false;
+          break;
+        }
+
+        if (!uploadEntry(cell, entry))
+        {
+          // a shared resource was unloaded after the decode was queued, decode the cell again
+          unloadCell(cell);
+          cell->state = CELL_PREFETCHED;
+          break;
+        }
+
+        cell->upload_cursor++;
+        stats_.loads_this_frame++;
+      }
+
+      if ((cell->state == CELL_UPLOADING) && (cell->upload_cursor == cell->entries.size()))
+      {
+        cell->state = CELL_RESIDENT;
+        stats_.cells_loaded++;
+      }
+    }
+
+    if (queued > 0) io_condition_.notify_one();
+  }
+
+
+  bool WorldStreamer::uploadEntry(const WorldCell *cell, CellEntry &entry)
+  {
+    bool mesh = (entry.type == CELL_ENTRY_MESH);
+    if (entry.decoded)
+    {
+      // the resource manager owns the decoded copy from here, even when it turns out to be a duplicate
+      Resource *decoded = entry.decoded;
+      entry.decoded = nullptr;
+      entry.loaded = mesh ? resource_manager_->addMesh(static_cast<Mesh *>(decoded)) :
+                            resource_manager_->addTexture(static_cast<Texture *>(decoded));
+      stats_.bytes_this_frame += entry.decoded_size;
+    }
+    else if (entry.shared)
+    {
+      entry.loaded = mesh ? resource_manager_->useMesh(entry.handle) :
+                            resource_manager_->useTexture(entry.handle);
+      if (!entry.loaded) return false;
+    }
+
+    if (!entry.loaded)
+      std::cerr << "WARNING: world cell (" << cell->x << ", " << cell->z
+                << ") failed to load: " << entry.handle << "\n";
+
+    return true;
+  }
+
+
+  void WorldStreamer::evictCells()
+  {
+    const int prefetch_limit = settings_.load_radius + settings_.prefetch_rings + settings_.hysteresis_rings;
+    const int resident_limit = settings_.load_radius + settings_.hysteresis_rings;
+
+    for (auto &cell : cells_)
+    {
+      if (!cell) continue;
+      int ring = ringDistance(cell);
+
+      if (ring > prefetch_limit)
+      {
+        if ((cell->state == CELL_READING) || (cell->state == CELL_DECODING))
+        {
+          // the io thread still owns it, collectReads() releases it once handed back
+          std::lock_guard<std::mutex> lock(io_mutex_);
+          cell->cancelled = true;
+        }
+        else
+        {
+          // a cell already dropped back to prefetched was counted when it was demoted
+          if ((cell->state == CELL_UPLOADING) || (cell->state == CELL_RESIDENT))
+            stats_.cells_evicted++;
+
+          releaseCell(cell);
+        }
+
+        cell = nullptr;
+        continue;
+      }
+
+      // drop back to prefetched, keeping the parsed data around in case the camera turns back
+      if ((ring > resident_limit) &&
+          ((cell->state == CELL_UPLOADING) || (cell->state == CELL_RESIDENT)))
+      {
+        unloadCell(cell);
+        cell->state = CELL_PREFETCHED;
+        stats_.cells_evicted++;
+      }
+    }
+  }
+
+
+  void WorldStreamer::unloadCell(WorldCell *cell)
+  {
+    for (auto &entry : cell->entries)
+    {
+      if (entry.loaded)
+      {
+        if (entry.type == CELL_ENTRY_MESH)
+          resource_manager_->unloadMesh(entry.handle);
+        else
+          resource_manager_->unloadTexture(entry.handle);
+        entry.loaded = false;
+      }
+
+      // decoded but never uploaded
+      SAFE_DELETE(entry.decoded);
+    }
+    cell->upload_cursor = 0;
+  }
+
+
+  WorldCell* WorldStreamer::acquireCell(int x, int z)
+  {
+    WorldCell *cell;
+    if (free_cells_.empty())
+    {
+      cell = new WorldCell;
+    }
+    else
+    {
+      cell = free_cells_.back();
+      free_cells_.pop_back();
+    }
+
+    cell->x = x;
+    cell->z = z;
+    cell->state = CELL_UNLOADED;
+    cell->cancelled = false;
+    cell->failed = false;
+    cell->upload_cursor = 0;
+    return cell;
+  }
+
+
+  void WorldStreamer::releaseCell(WorldCell *cell)
+  {
+    unloadCell(cell);
+
+    // clearing keeps the capacity, so the next cell file parsed into it rarely grows the vector
+    cell->entries.clear();
+    free_cells_.push_back(cell);
+  }
+
+
+  void WorldStreamer::ioLoop()
+  {
+    VV_MEMORY_SCOPE(MEMORY_STREAMING);
+
+    while (true)
+    {
+      WorldCell *cell = nullptr;
+      bool cancelled = false;
+      {
+        std::unique_lock<std::mutex> lock(io_mutex_);
+        io_condition_.wait(lock, [this] { return !running_ || !read_requests_.empty(); });
+        if (!running_) return;
+
+        cell = read_requests_.front();
+        read_requests_.erase(read_requests_.begin());
+        cancelled = cell->cancelled;
+      }
+
+      // the state only changes once the cell is handed back
+      bool failed = false;
+      if (!cancelled && cell->state == CELL_DECODING)
+        decodeCell(cell);
+      else if (!cancelled)
+        failed = !readCell(cell);
+
+      std::lock_guard<std::mutex> lock(io_mutex_);
+      cell->failed = failed;
+      read_results_.push_back(cell);
+    }
+  }
+
+
+  bool WorldStreamer::readCell(WorldCell *cell) const
+  {
+    // cells that were never written are simply empty
+    std::ifstream file(getCellFileName(cell->x, cell->z));
+    if (!file.is_open()) return true;
+
+    std::stringstream cell_stream;
+    cell_stream << file.rdbuf();
+    std::istringstream lines(cell_stream.str());
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(lines, line))
+    {
+      line_number++;
+      if (line.empty() || line[0] == '#') continue;
+
+      std::istringstream tokens(line);
+      std::string type;
+      tokens >> type;
+
+      CellEntry entry;
+      if (type == "mesh")
+      {
+        entry.type = CELL_ENTRY_MESH;
+        tokens >> entry.path >> entry.name;
+      }
+      else if (type == "texture")
+      {
+        entry.type = CELL_ENTRY_TEXTURE;
+        tokens >> entry.path >> entry.name;
+      }
+      else if (type == "cell")
+      {
+        continue;
+      }
+      else
+      {
+        std::cerr << "ERROR: unknown entry in world cell " << getCellFileName(cell->x, cell->z)
+                  << " on line " << line_number << "\n";
+        return false;
+      }
+
+      if (tokens.fail())
+      {
+        std::cerr << "ERROR: malformed entry in world cell " << getCellFileName(cell->x, cell->z)
+                  << " on line " << line_number << "\n";
+        return false;
+      }
+
+      entry.handle = entry.path + entry.name;
+      entry.decoded = nullptr;
+      entry.decoded_size = 0;
+      entry.shared = false;
+      entry.loaded = false;
+      cell->entries.push_back(entry);
+    }
+
+    return true;
+  }
+
+
+  void WorldStreamer::decodeCell(WorldCell *cell)
+  {
+    // the decoded assets end up owned by the resource manager
+    VV_MEMORY_SCOPE(MEMORY_RESOURCES);
+
+    for (auto &entry : cell->entries)
+    {
+      if (entry.shared) continue;
+
+      // a failed decode leaves nothing behind, the upload reports it
+      if (entry.type == CELL_ENTRY_MESH)
+      {
+        Mesh *mesh = new Mesh(entry.path, entry.name);
+        if (!mesh->init())
+        {
+          SAFE_DELETE(mesh);
+          continue;
+        }
+
+        entry.decoded_size = mesh->getVertexCount() * sizeof(MeshVertex) + mesh->getIndexCount() * sizeof(GLuint);
+        if (mesh->isSkinned())
+          entry.decoded_size += mesh->getVertexCount() * sizeof(SkinVertex);
+        entry.decoded = mesh;
+      }
+      else
+      {
+        Texture *texture = new Texture(entry.path, entry.name);
+        if (!texture->init())
+        {
+          SAFE_DELETE(texture);
+          continue;
+        }
+
+        entry.decoded_size = texture->getPixels().size();
+        entry.decoded = texture;
+      }
+    }
+  }
+} // namespace vv
\ No newline at end of file
@@ -8,8 +8,12 @@ using namespace vv;
 int main(int argc, char **argv)
 {
   Application application(argc, argv);
+  if (application.hasMipChainJobs())
+    return application.buildMipChains() ? EXIT_SUCCESS : EXIT_FAILURE;
+
   if (!application.init()) return EXIT_FAILURE;
   application.run();
+  application.shutdown();
 
   return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 330 core
+//! features: LIGHT_COUNT NORMAL_MAPPING ALPHA_TEST TEXTURE_ARRAY
 
 struct Light
 {
@@ -6,12 +7,42 @@ struct Light
   vec3 color;
 };
 
-const int NUM_LIGHTS = 16;
+/* Injected per variant, the default only applies when compiled on its own */
+#ifndef NUM_LIGHTS
+#define NUM_LIGHTS 16
+#endif
 
 uniform Light lights[NUM_LIGHTS];
-uniform sampler2D texture_diffuse1;
 uniform vec3 view_position;
 
+/* Packed materials address a layer of a texture array, atlas pages also remap the uvs */
+#ifdef VV_TEXTURE_ARRAY
+uniform sampler2DArray diffuse_array;
+uniform float diffuse_layer;
+uniform vec4 diffuse_uv_rect;
+#define SAMPLE_DIFFUSE(uv) texture(diffuse_array, vec3((uv) * diffuse_uv_rect.xy + diffuse_uv_rect.zw, diffuse_layer))
+#else
+uniform sampler2D texture_diffuse1;
+#define SAMPLE_DIFFUSE(uv) texture(texture_diffuse1, (uv))
+#endif
+
+#ifdef VV_NORMAL_MAPPING
+#ifdef VV_TEXTURE_ARRAY
+uniform sampler2DArray normal_array;
+uniform float normal_layer;
+uniform vec4 normal_uv_rect;
+#define SAMPLE_NORMAL(uv) texture(normal_array, vec3((uv) * normal_uv_rect.xy + normal_uv_rect.zw, normal_layer))
+#else
+uniform sampler2D texture_normal1;
+#define SAMPLE_NORMAL(uv) texture(texture_normal1, (uv))
+#endif
+in mat3 TBN;
+#endif
+
+#ifdef VV_ALPHA_TEST
+uniform float alpha_cutoff;
+#endif
+
 in vec2 Tex_Coord;
 in vec3 Normal;
 in vec3 Frag_Position;
@@ -24,7 +55,19 @@ void main()
   float specular_intensity = 0.5f;
   float shininess = 32;
 
+  vec4 diffuse_color = SAMPLE_DIFFUSE(Tex_Coord);
+
+#ifdef VV_ALPHA_TEST
+  if (diffuse_color.a < alpha_cutoff)
+    discard;
+#endif
+
+#ifdef VV_NORMAL_MAPPING
+  vec3 unit_normal = normalize(TBN * (SAMPLE_NORMAL(Tex_Coord).rgb * 2.0f - 1.0f));
+#else
   vec3 unit_normal = normalize(Normal);
+#endif
+
   vec3 view_direction = normalize(view_position - Frag_Position);
   vec3 final_light_color = vec3(ambient_strength);
 
@@ -39,5 +82,5 @@ void main()
     final_light_color += vec3((diffuse_strength + specular_strength) * lights[i].color);
   }
 
-  color = vec4(final_light_color, 1.0f) * texture(texture_diffuse1, Tex_Coord);
+  color = vec4(final_light_color, 1.0f) * diffuse_color;
 }
\ No newline at end of file
@@ -1,10 +1,44 @@
 #version 330 core
+//! features: NORMAL_MAPPING INSTANCING SKINNING INDIRECT
 
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 tex_coord;
 
+#ifdef VV_NORMAL_MAPPING
+layout (location = 3) in vec3 tangent;
+#endif
+
+#if defined(VV_INDIRECT)
+layout (location = 10) in uint instance_id; /* survivor of the gpu cull, see IndirectRenderer */
+uniform samplerBuffer instance_transforms;  /* every matrix is four texels, one per column */
+mat4 indirect_model;
+#define MODEL_MATRIX indirect_model
+#elif defined(VV_INSTANCING)
+layout (location = 4) in mat4 instance_model; /* occupies locations 4 to 7 */
+#define MODEL_MATRIX instance_model
+#else
 uniform mat4 model;
+#define MODEL_MATRIX model
+#endif
+
+#ifdef VV_SKINNING
+layout (location = 8) in uvec4 bone_ids;
+layout (location = 9) in vec4 bone_weights;
+
+uniform samplerBuffer bone_palette; /* every matrix is four texels, one per column */
+uniform int palette_offset;         /* first bone of this instance within the palette */
+
+mat4 fetchBone(uint bone)
+{
+    int texel = (palette_offset + int(bone)) * 4;
+    return mat4(texelFetch(bone_palette, texel),
+                texelFetch(bone_palette, texel + 1),
+                texelFetch(bone_palette, texel + 2),
+                texelFetch(bone_palette, texel + 3));
+}
+#endif
+
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -12,10 +46,53 @@ out vec2 Tex_Coord;
 out vec3 Normal;
 out vec3 Frag_Position;
 
+#ifdef VV_NORMAL_MAPPING
+out mat3 TBN;
+#endif
+
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0f);
-    Normal = mat3(transpose(inverse(model))) * normal;
-    Frag_Position = vec3(model * vec4(position, 1.0f));
+#ifdef VV_INDIRECT
+    int instance_texel = int(instance_id) * 4;
+    indirect_model = mat4(texelFetch(instance_transforms, instance_texel),
+                          texelFetch(instance_transforms, instance_texel + 1),
+                          texelFetch(instance_transforms, instance_texel + 2),
+                          texelFetch(instance_transforms, instance_texel + 3));
+#endif
+
+    vec4 local_position = vec4(position, 1.0f);
+    vec3 local_normal = normal;
+#ifdef VV_NORMAL_MAPPING
+    vec3 local_tangent = tangent;
+#endif
+
+#ifdef VV_SKINNING
+    // weights sum to one or are all zero, the rigid part keeps unweighted vertices unskinned
+    float rigid = 1.0f - dot(bone_weights, vec4(1.0f));
+    mat4 skin = fetchBone(bone_ids.x) * bone_weights.x +
+                fetchBone(bone_ids.y) * bone_weights.y +
+                fetchBone(bone_ids.z) * bone_weights.z +
+                fetchBone(bone_ids.w) * bone_weights.w +
+                mat4(1.0f) * rigid;
+
+    local_position = skin * local_position;
+    local_normal = mat3(skin) * local_normal;
+#ifdef VV_NORMAL_MAPPING
+    local_tangent = mat3(skin) * local_tangent;
+#endif
+#endif
+
+    mat3 normal_matrix = mat3(transpose(inverse(MODEL_MATRIX)));
+
+    gl_Position = projection * view * MODEL_MATRIX * local_position;
+    Normal = normal_matrix * local_normal;
+    Frag_Position = vec3(MODEL_MATRIX * local_position);
     Tex_Coord = tex_coord;
+
+#ifdef VV_NORMAL_MAPPING
+    vec3 N = normalize(Normal);
+    vec3 T = normalize(normal_matrix * local_tangent);
+    T = normalize(T - dot(T, N) * N);
+    TBN = mat3(T, cross(N, T), N);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 330 core
+
+in vec2 Corner;
+in vec4 Color;
+
+out vec4 color;
+
+void main()
+{
+    float falloff = 1.0f - smoothstep(0.5f, 1.0f, length(Corner));
+    if (falloff <= 0.0f)
+        discard;
+
+    color = vec4(Color.rgb, Color.a * falloff);
+}
\ No newline at end of file
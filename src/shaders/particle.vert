@@ -0,0 +1,28 @@
+#version 330 core
+
+layout (location = 0) in vec4 instance; /* xyz position, w age over lifetime */
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec2 size_range; /* size at birth, size at death */
+uniform vec4 color_start;
+uniform vec4 color_end;
+
+out vec2 Corner;
+out vec4 Color;
+
+void main()
+{
+    // triangle strip corners from the vertex id, no vertex buffer needed
+    Corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0f - 1.0f;
+
+    float age = clamp(instance.w, 0.0f, 1.0f);
+    float size = mix(size_range.x, size_range.y, age);
+    Color = mix(color_start, color_end, age);
+
+    vec3 camera_right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 camera_up = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 position = instance.xyz + (camera_right * Corner.x + camera_up * Corner.y) * size;
+
+    gl_Position = projection * view * vec4(position, 1.0f);
+}
\ No newline at end of file